@@ -0,0 +1,153 @@
+#include "Bounds.hpp"
+
+#include <cmath>
+#include <limits>
+
+AABB::AABB()
+	: Min( std::numeric_limits<float>::max() ), Max( std::numeric_limits<float>::lowest() )
+{
+}
+
+AABB::AABB( glm::vec3 min, glm::vec3 max )
+	: Min( min ), Max( max )
+{
+}
+
+bool AABB::IsEmpty() const
+{
+	return Min.x > Max.x || Min.y > Max.y || Min.z > Max.z;
+}
+
+glm::vec3 AABB::Center() const
+{
+	return ( Min + Max ) * 0.5f;
+}
+
+glm::vec3 AABB::Size() const
+{
+	return Max - Min;
+}
+
+void AABB::Expand( glm::vec3 point )
+{
+	Min = glm::min( Min, point );
+	Max = glm::max( Max, point );
+}
+
+void AABB::Expand( const AABB& other )
+{
+	if ( other.IsEmpty() )
+		return;
+
+	Min = glm::min( Min, other.Min );
+	Max = glm::max( Max, other.Max );
+}
+
+AABB AABB::Intersect( const AABB& other ) const
+{
+	return AABB( glm::max( Min, other.Min ), glm::min( Max, other.Max ) );
+}
+
+bool AABB::Overlaps( const AABB& other ) const
+{
+	return !Intersect( other ).IsEmpty();
+}
+
+AABB AABB::Transformed( const glm::mat4& matrix ) const
+{
+	if ( IsEmpty() )
+		return AABB();
+
+	// Arvo's method (affine matrices only): every output axis is the sum of the smallest/biggest contribution of each input axis,
+	// which is cheaper than transforming all 8 corners
+	glm::vec3 translation = glm::vec3( matrix[ 3 ] );
+	AABB result( translation, translation );
+
+	for ( int column = 0; column < 3; column++ ) {
+		for ( int row = 0; row < 3; row++ ) {
+			float a = matrix[ column ][ row ] * Min[ column ];
+			float b = matrix[ column ][ row ] * Max[ column ];
+			result.Min[ row ] += std::fmin( a, b );
+			result.Max[ row ] += std::fmax( a, b );
+		}
+	}
+
+	return result;
+}
+
+Frustum::Frustum()
+{
+	for ( int i = 0; i < 6; i++ )
+		Planes[ i ] = glm::vec4( 0.f );
+}
+
+Frustum::Frustum( const glm::mat4& viewProjection )
+{
+	// Gribb/Hartmann: every plane is the last row of the matrix plus or minus one of the other rows
+	glm::vec4 rowX( viewProjection[ 0 ][ 0 ], viewProjection[ 1 ][ 0 ], viewProjection[ 2 ][ 0 ], viewProjection[ 3 ][ 0 ] );
+	glm::vec4 rowY( viewProjection[ 0 ][ 1 ], viewProjection[ 1 ][ 1 ], viewProjection[ 2 ][ 1 ], viewProjection[ 3 ][ 1 ] );
+	glm::vec4 rowZ( viewProjection[ 0 ][ 2 ], viewProjection[ 1 ][ 2 ], viewProjection[ 2 ][ 2 ], viewProjection[ 3 ][ 2 ] );
+	glm::vec4 rowW( viewProjection[ 0 ][ 3 ], viewProjection[ 1 ][ 3 ], viewProjection[ 2 ][ 3 ], viewProjection[ 3 ][ 3 ] );
+
+	Planes[ 0 ] = rowW + rowX;
+	Planes[ 1 ] = rowW - rowX;
+	Planes[ 2 ] = rowW + rowY;
+	Planes[ 3 ] = rowW - rowY;
+	Planes[ 4 ] = rowW + rowZ;
+	Planes[ 5 ] = rowW - rowZ;
+
+	for ( int i = 0; i < 6; i++ )
+		Planes[ i ] /= glm::length( glm::vec3( Planes[ i ] ) );
+}
+
+bool Frustum::Intersects( const AABB& box ) const
+{
+	for ( int i = 0; i < 6; i++ ) {
+		// the corner furthest along the plane normal, if even that one is behind the plane the box is outside
+		glm::vec3 normal = glm::vec3( Planes[ i ] );
+		glm::vec3 positive( normal.x >= 0.f ? box.Max.x : box.Min.x,
+			normal.y >= 0.f ? box.Max.y : box.Min.y,
+			normal.z >= 0.f ? box.Max.z : box.Min.z );
+
+		if ( glm::dot( normal, positive ) + Planes[ i ].w < 0.f )
+			return false;
+	}
+
+	return true;
+}
+
+FrustumTest Frustum::Classify( const AABB& box ) const
+{
+	glm::vec3 center = box.Center();
+	glm::vec3 extent = box.Size() * .5f;
+
+	FrustumTest result = FRUSTUM_INSIDE;
+	for ( int i = 0; i < 6; i++ ) {
+		glm::vec3 normal = glm::vec3( Planes[ i ] );
+		// signed distance of the center and the projected radius of the box onto the normal
+		float distance = glm::dot( normal, center ) + Planes[ i ].w;
+		float radius = glm::dot( glm::abs( normal ), extent );
+
+		if ( distance + radius < 0.f )
+			return FRUSTUM_OUTSIDE;
+		if ( distance - radius < 0.f )
+			result = FRUSTUM_INTERSECTS;
+	}
+
+	return result;
+}
+
+CullVolume::CullVolume()
+	: PlaneMask( 0 ), Sphere( 0.f, 0.f, 0.f, -1.f )
+{
+}
+
+CullVolume::CullVolume( const Frustum& frustum, unsigned int planeMask )
+	: Planes( frustum ), PlaneMask( planeMask ), Sphere( 0.f, 0.f, 0.f, -1.f )
+{
+}
+
+CullVolume::CullVolume( glm::vec3 center, float radius )
+	: PlaneMask( 0 ), Sphere( center, radius )
+{
+}
\ No newline at end of file
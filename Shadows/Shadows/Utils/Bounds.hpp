@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Axis aligned bounding box. A default constructed box is empty (Min > Max) so it can be grown with Expand()
+struct AABB
+{
+	glm::vec3 Min;
+	glm::vec3 Max;
+
+	AABB();
+	AABB( glm::vec3 min, glm::vec3 max );
+
+	bool IsEmpty() const;
+	glm::vec3 Center() const;
+	glm::vec3 Size() const;
+
+	void Expand( glm::vec3 point );
+	void Expand( const AABB& other );
+
+	// returns the overlapping region of both boxes, empty if they don't overlap
+	AABB Intersect( const AABB& other ) const;
+	bool Overlaps( const AABB& other ) const;
+
+	// returns the box enclosing this box after it has been transformed by the matrix
+	AABB Transformed( const glm::mat4& matrix ) const;
+};
+
+// Result of a frustum test, FRUSTUM_INSIDE lets hierarchical culling skip the tests of everything below a node
+enum FrustumTest
+{
+	FRUSTUM_OUTSIDE,
+	FRUSTUM_INTERSECTS,
+	FRUSTUM_INSIDE,
+};
+
+// Six planes of a view volume, extracted from a (projection * view) matrix. The normals point inwards
+struct Frustum
+{
+	// left, right, bottom, top, near, far. xyz = normal, w = distance
+	glm::vec4 Planes[ 6 ];
+
+	Frustum();
+	explicit Frustum( const glm::mat4& viewProjection );
+
+	// conservative: may report boxes near the corners as intersecting even if they are just outside
+	bool Intersects( const AABB& box ) const;
+	FrustumTest Classify( const AABB& box ) const;
+};
+
+// bits of CullVolume::PlaneMask
+const unsigned int FRUSTUM_ALL_PLANES = 0x3F;
+const unsigned int FRUSTUM_NEAR_PLANE = 1 << 4;
+
+// A view volume in the form the GPU culling pass tests it: any subset of the frustum planes and/or a sphere
+struct CullVolume
+{
+	Frustum Planes;
+	// bit i enables Planes.Planes[ i ]
+	unsigned int PlaneMask;
+	// xyz = center, w = radius. Disabled when the radius is negative
+	glm::vec4 Sphere;
+
+	CullVolume();
+	explicit CullVolume( const Frustum& frustum, unsigned int planeMask = FRUSTUM_ALL_PLANES );
+	CullVolume( glm::vec3 center, float radius );
+};
\ No newline at end of file
@@ -25,6 +25,16 @@ glm::mat4 Camera::GetViewMatrix() const
 	return glm::lookAt( Position, Position + Front, Up );
 }
 
+glm::mat4 Camera::GetProjectionMatrix( float aspect, float nearPlane, float farPlane ) const
+{
+	return glm::perspective( glm::radians( Zoom ), aspect, nearPlane, farPlane );
+}
+
+Frustum Camera::GetFrustum( float aspect, float nearPlane, float farPlane ) const
+{
+	return Frustum( GetProjectionMatrix( aspect, nearPlane, farPlane ) * GetViewMatrix() );
+}
+
 void Camera::ProcessKeyboard( CameraMovement direction, float deltaTime )
 {
 	if ( direction == MOVE_FAST )
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Bounds.hpp"
+
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -56,6 +58,12 @@ public:
 	// returns the view matrix calculated using Euler Angles and the LookAt Matrix
 	glm::mat4 GetViewMatrix() const;
 
+	// returns the perspective projection matrix using Zoom as the vertical field of view
+	glm::mat4 GetProjectionMatrix( float aspect, float nearPlane, float farPlane ) const;
+
+	// returns the planes of the view frustum in world space, for culling
+	Frustum GetFrustum( float aspect, float nearPlane, float farPlane ) const;
+
 	// processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
 	void ProcessKeyboard( CameraMovement direction, float deltaTime );
 
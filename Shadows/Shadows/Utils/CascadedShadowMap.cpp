@@ -0,0 +1,253 @@
+#include "CascadedShadowMap.hpp"
+#include "RenderState.hpp"
+
+#include <GL/glew.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+// hashed once, set every frame
+const UniformKey UNIFORM_SHADOW_MAP( "u_ShadowMap" );
+
+// The cascades move in steps of 1 / CACHE_SNAP_DIVISIONS of their size instead of single texels, so the static cache
+// isn't redrawn every time the camera moves
+static const unsigned int CACHE_SNAP_DIVISIONS = 16;
+
+const char* GetShadowFilterDefines( ShadowFilter filter )
+{
+	switch ( filter ) {
+	case FILTER_PCF_1:
+		return "#define SHADOW_FILTER_GRID 1";
+	case FILTER_PCF_4:
+		return "#define SHADOW_FILTER_GRID 2";
+	case FILTER_PCF_9:
+		return "#define SHADOW_FILTER_GRID 3";
+	case FILTER_PCF_16:
+		return "#define SHADOW_FILTER_GRID 4";
+	case FILTER_POISSON:
+		return "#define SHADOW_FILTER_POISSON";
+	case FILTER_ROTATED_POISSON:
+		return "#define SHADOW_FILTER_POISSON\n#define SHADOW_FILTER_ROTATED";
+	case FILTER_VSM:
+		return "#define SHADOW_TECHNIQUE_VSM";
+	case FILTER_EVSM:
+		return "#define SHADOW_TECHNIQUE_EVSM";
+	}
+
+	return "";
+}
+
+bool IsMomentShadowFilter( ShadowFilter filter )
+{
+	return filter == FILTER_VSM || filter == FILTER_EVSM;
+}
+
+CascadedShadowMap::CascadedShadowMap( unsigned int resolution, unsigned int cascadeCount, CascadeSplitScheme splitScheme, float splitLambda )
+	: FBO( 0 ), DepthMapArray( 0 ), StaticFBO( 0 ), StaticDepthMapArray( 0 ), Resolution( resolution ),
+	CascadeCount( std::min( std::max( cascadeCount, 1u ), MAX_CASCADES ) ),
+	SplitScheme( splitScheme ), SplitLambda( splitLambda )
+{
+	CascadeSplits.resize( CascadeCount );
+	LightSpaceMatrices.resize( CascadeCount, glm::mat4( 1.f ) );
+	staticLightSpaceMatrices.resize( CascadeCount, glm::mat4( 1.f ) );
+	staticCacheValid.resize( CascadeCount, false );
+
+	createDepthArray( FBO, DepthMapArray );
+	createDepthArray( StaticFBO, StaticDepthMapArray );
+}
+
+CascadedShadowMap::~CascadedShadowMap()
+{
+	glDeleteFramebuffers( 1, &FBO );
+	glDeleteTextures( 1, &DepthMapArray );
+	glDeleteFramebuffers( 1, &StaticFBO );
+	glDeleteTextures( 1, &StaticDepthMapArray );
+	RenderState::Invalidate();
+}
+
+void CascadedShadowMap::createDepthArray( unsigned int& fbo, unsigned int& depthMapArray )
+{
+	glGenTextures( 1, &depthMapArray );
+	RenderState::BindTexture( 0, GL_TEXTURE_2D_ARRAY, depthMapArray );
+	glTexImage3D( GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, Resolution, Resolution, CascadeCount,
+		0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr );
+	// hardware PCF: sampled through sampler2DArrayShadow, the comparison result gets bilinearly filtered
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER );
+	float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glTexParameterfv( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor );
+
+	glGenFramebuffers( 1, &fbo );
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, fbo );
+	glFramebufferTextureLayer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthMapArray, 0, 0 );
+	glDrawBuffer( GL_NONE );
+	glReadBuffer( GL_NONE );
+	if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE ) {
+		std::cout << "ERROR::FRAMEBUFFER:: Cascaded shadow map framebuffer is not complete!\n";
+	}
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, 0 );
+}
+
+void CascadedShadowMap::Update( const Camera& camera, float aspect, float nearPlane, float farPlane, glm::vec3 lightDir,
+	const std::vector<AABB>& casterBounds, const std::vector<AABB>& receiverBounds )
+{
+	calculateSplits( nearPlane, farPlane );
+
+	// the light view is anchored at the origin instead of following the camera, so the texel grid stays fixed in world space
+	glm::vec3 up = std::abs( lightDir.y ) > 0.99f ? glm::vec3( 0.f, 0.f, 1.f ) : glm::vec3( 0.f, 1.f, 0.f );
+	glm::mat4 lightView = glm::lookAt( -lightDir, glm::vec3( 0.f ), up );
+
+	// the scene bounds are the same for every cascade, move them to light space once
+	std::vector<AABB> lightCasters;
+	lightCasters.reserve( casterBounds.size() );
+	for ( unsigned int i = 0; i < casterBounds.size(); i++ ) {
+		lightCasters.push_back( casterBounds[ i ].Transformed( lightView ) );
+	}
+
+	std::vector<AABB> lightReceivers;
+	lightReceivers.reserve( receiverBounds.size() );
+	for ( unsigned int i = 0; i < receiverBounds.size(); i++ ) {
+		lightReceivers.push_back( receiverBounds[ i ].Transformed( lightView ) );
+	}
+
+	float sliceNear = nearPlane;
+	for ( unsigned int i = 0; i < CascadeCount; i++ ) {
+		AABB sliceBounds = calculateSliceBounds( camera, aspect, sliceNear, CascadeSplits[ i ], lightView );
+		LightSpaceMatrices[ i ] = fitLightProjection( sliceBounds, lightCasters, lightReceivers ) * lightView;
+		sliceNear = CascadeSplits[ i ];
+	}
+}
+
+void CascadedShadowMap::InvalidateStaticCache()
+{
+	for ( unsigned int i = 0; i < CascadeCount; i++ ) {
+		staticCacheValid[ i ] = false;
+	}
+}
+
+bool CascadedShadowMap::BindStaticForWriting( unsigned int cascade )
+{
+	// the cascade moved (camera or light changed) or a static caster changed
+	if ( staticCacheValid[ cascade ] && staticLightSpaceMatrices[ cascade ] == LightSpaceMatrices[ cascade ] )
+		return false;
+
+	staticCacheValid[ cascade ] = true;
+	staticLightSpaceMatrices[ cascade ] = LightSpaceMatrices[ cascade ];
+
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, StaticFBO );
+	glFramebufferTextureLayer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, StaticDepthMapArray, 0, cascade );
+	RenderState::Viewport( 0, 0, Resolution, Resolution );
+	glClear( GL_DEPTH_BUFFER_BIT );
+
+	return true;
+}
+
+void CascadedShadowMap::BindForWriting( unsigned int cascade ) const
+{
+	RenderState::BindFramebuffer( GL_READ_FRAMEBUFFER, StaticFBO );
+	glFramebufferTextureLayer( GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, StaticDepthMapArray, 0, cascade );
+	RenderState::BindFramebuffer( GL_DRAW_FRAMEBUFFER, FBO );
+	glFramebufferTextureLayer( GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, DepthMapArray, 0, cascade );
+
+	// a depth blit replaces the clear, the cascade starts out with the shadows of all static casters
+	glBlitFramebuffer( 0, 0, Resolution, Resolution, 0, 0, Resolution, Resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST );
+
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, FBO );
+	RenderState::Viewport( 0, 0, Resolution, Resolution );
+}
+
+void CascadedShadowMap::BindForReading( Shader& shader, unsigned int textureUnit ) const
+{
+	RenderState::BindTexture( textureUnit, GL_TEXTURE_2D_ARRAY, DepthMapArray );
+
+	shader.setSampler( UNIFORM_SHADOW_MAP, textureUnit );
+}
+
+void CascadedShadowMap::calculateSplits( float nearPlane, float farPlane )
+{
+	for ( unsigned int i = 0; i < CascadeCount; i++ ) {
+		float fraction = ( i + 1 ) / ( float ) CascadeCount;
+
+		float uniformSplit = nearPlane + ( farPlane - nearPlane ) * fraction;
+		float logSplit = nearPlane * std::pow( farPlane / nearPlane, fraction );
+
+		switch ( SplitScheme ) {
+		case SPLIT_UNIFORM:
+			CascadeSplits[ i ] = uniformSplit;
+			break;
+		case SPLIT_LOGARITHMIC:
+			CascadeSplits[ i ] = logSplit;
+			break;
+		case SPLIT_PRACTICAL:
+			CascadeSplits[ i ] = SplitLambda * logSplit + ( 1.f - SplitLambda ) * uniformSplit;
+			break;
+		}
+	}
+}
+
+AABB CascadedShadowMap::calculateSliceBounds( const Camera& camera, float aspect, float nearPlane, float farPlane, const glm::mat4& lightView ) const
+{
+	// light space bounds of the world space corners of the camera frustum slice
+	glm::mat4 sliceProjection = glm::perspective( glm::radians( camera.Zoom ), aspect, nearPlane, farPlane );
+	glm::mat4 inverseViewProj = glm::inverse( sliceProjection * camera.GetViewMatrix() );
+
+	AABB bounds;
+	for ( unsigned int i = 0; i < 8; i++ ) {
+		glm::vec4 corner = inverseViewProj * glm::vec4( i & 1 ? 1.f : -1.f, i & 2 ? 1.f : -1.f, i & 4 ? 1.f : -1.f, 1.f );
+		bounds.Expand( glm::vec3( lightView * ( corner / corner.w ) ) );
+	}
+
+	return bounds;
+}
+
+glm::mat4 CascadedShadowMap::fitLightProjection( const AABB& sliceBounds, const std::vector<AABB>& casterBounds, const std::vector<AABB>& receiverBounds ) const
+{
+	// only the visible part of the receivers needs shadow texels
+	AABB fitted;
+	for ( unsigned int i = 0; i < receiverBounds.size(); i++ ) {
+		fitted.Expand( receiverBounds[ i ].Intersect( sliceBounds ) );
+	}
+
+	// nothing to receive a shadow in this slice, keep a valid projection anyway
+	if ( fitted.IsEmpty() )
+		fitted = sliceBounds;
+
+	// casters above the fitted area can throw a shadow into it even if they are outside of the slice,
+	// so only the near plane is extended (xy stays the same)
+	float nearestZ = fitted.Max.z;
+	for ( unsigned int i = 0; i < casterBounds.size(); i++ ) {
+		const AABB& caster = casterBounds[ i ];
+		bool overlapsXY = caster.Min.x <= fitted.Max.x && caster.Max.x >= fitted.Min.x &&
+			caster.Min.y <= fitted.Max.y && caster.Max.y >= fitted.Min.y;
+		if ( overlapsXY && !caster.IsEmpty() )
+			nearestZ = std::max( nearestZ, caster.Max.z );
+	}
+
+	// Snapping: the world size of one texel only changes in quarter octave steps and the bounds are moved in whole steps
+	// of snapTexels texels, so the same world position always lands on the same texel and the projection, which the static
+	// cache depends on, only changes when the camera moved far enough. The margin of snapTexels on every side keeps
+	// the fitted bounds covered wherever the snapped bounds start
+	float snapTexels = ( float )std::max( Resolution / CACHE_SNAP_DIVISIONS, 1u );
+	glm::vec3 size = fitted.Size();
+	float texelSize = std::max( size.x, size.y ) / ( Resolution - 2.f * snapTexels );
+	texelSize = std::exp2( std::ceil( std::log2( std::max( texelSize, 1e-6f ) ) * 4.f ) / 4.f );
+
+	float step = texelSize * snapTexels;
+	float extent = texelSize * Resolution;
+	glm::vec2 center = glm::vec2( fitted.Center() );
+	glm::vec2 minXY = glm::floor( ( center - extent * 0.5f ) / step ) * step;
+	glm::vec2 maxXY = minXY + extent;
+
+	// the depth range is widened to whole steps as well, small changes of the fitted bounds don't change it.
+	// The light looks down -z, so the closest point has the biggest z
+	float nearZ = std::ceil( nearestZ / step ) * step;
+	float farZ = std::floor( fitted.Min.z / step ) * step;
+	return glm::ortho( minXY.x, maxXY.x, minXY.y, maxXY.y, -nearZ, -farZ );
+}
\ No newline at end of file
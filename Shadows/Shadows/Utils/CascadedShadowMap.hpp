@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Camera.hpp"
+#include "Shader.hpp"
+#include "Bounds.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Defines how the camera view distance is divided between the cascades
+enum CascadeSplitScheme
+{
+	SPLIT_UNIFORM,		// equal length slices, wastes resolution close to the camera
+	SPLIT_LOGARITHMIC,	// matches perspective aliasing, but the first slices become tiny
+	SPLIT_PRACTICAL,	// blend between the two, controlled by SplitLambda
+};
+
+// Has to match the array sizes declared in the shadow shaders
+const unsigned int MAX_CASCADES = 8;
+
+// Kernel of the shadow lookup. Every tap is a hardware depth comparison with bilinear filtering, so it already
+// blends a 2x2 texel footprint. Selected when the shadow shaders are built, see GetShadowFilterDefines()
+enum ShadowFilter
+{
+	FILTER_PCF_1,				// single tap, 2x2 texel footprint
+	FILTER_PCF_4,				// 2x2 grid, 3x3 texel footprint
+	FILTER_PCF_9,				// 3x3 grid, 4x4 texel footprint
+	FILTER_PCF_16,				// 4x4 grid, 5x5 texel footprint
+	FILTER_POISSON,				// 16 taps spread over a disk, wider and softer for the same cost as FILTER_PCF_16
+	FILTER_ROTATED_POISSON,		// the Poisson disk randomly rotated per fragment, trades banding for noise
+	FILTER_VSM,					// variance shadow map, pre-filtered moments (see ShadowMoments)
+	FILTER_EVSM,				// exponential variance shadow map, less light bleeding than FILTER_VSM for twice the memory
+};
+
+// returns the "#define ..." lines that select the filter in the shadow shaders, meant for the defines parameter of Shader
+const char* GetShadowFilterDefines( ShadowFilter filter );
+// the moment based filters need a ShadowMoments next to the cascaded shadow map
+bool IsMomentShadowFilter( ShadowFilter filter );
+
+// Shadow map for a directional light, split along the camera view frustum into several cascades
+// which are all stored as layers of one GL_TEXTURE_2D_ARRAY with the same resolution.
+// Static casters are rendered into a separate cache array that is only redrawn when it gets invalidated,
+// every frame the cache is copied into the final array and only the dynamic casters are drawn on top
+class CascadedShadowMap
+{
+public:
+	// render data
+	unsigned int FBO;
+	unsigned int DepthMapArray;
+	unsigned int StaticFBO;
+	unsigned int StaticDepthMapArray;
+
+	// cascade options
+	unsigned int Resolution;
+	unsigned int CascadeCount;
+	CascadeSplitScheme SplitScheme;
+	float SplitLambda;
+
+	// view space distance at which each cascade ends, recalculated by Update()
+	std::vector<float> CascadeSplits;
+	// light projection * light view for each cascade, recalculated by Update()
+	std::vector<glm::mat4> LightSpaceMatrices;
+
+	CascadedShadowMap( unsigned int resolution, unsigned int cascadeCount,
+		CascadeSplitScheme splitScheme = SPLIT_PRACTICAL, float splitLambda = 0.75f );
+	~CascadedShadowMap();
+
+	// recalculates the split distances and the light space matrix of every cascade for the current camera.
+	// Each cascade is fitted to the part of its frustum slice that contains receivers, extended towards the light
+	// to include the casters above them, and snapped so the shadows don't shimmer when the camera moves. The snapping steps
+	// are coarser than a texel, so the static cache stays valid until the camera moved by a fraction of the cascade
+	void Update( const Camera& camera, float aspect, float nearPlane, float farPlane, glm::vec3 lightDir,
+		const std::vector<AABB>& casterBounds, const std::vector<AABB>& receiverBounds );
+
+	// forces all cascades to redraw the static casters, e.g. when a static object moved
+	void InvalidateStaticCache();
+
+	// returns false if the static cache of the cascade is still valid. Otherwise binds the cleared cache layer
+	// for writing, sets the viewport and returns true, the caller then has to render all static casters
+	bool BindStaticForWriting( unsigned int cascade );
+
+	// copies the static cache into the cascade and binds it for writing with the viewport set to the cascade resolution,
+	// so only the dynamic casters have to be rendered
+	void BindForWriting( unsigned int cascade ) const;
+
+	// binds the depth array to the texture unit, the shader has to be in use. The matrices and splits of the cascades
+	// reach the shaders through the LightConstants block (see FrameUniforms::SetCascades())
+	void BindForReading( Shader& shader, unsigned int textureUnit ) const;
+
+private:
+	// the light space matrices the static cache was rendered with, a cascade is stale once they differ
+	std::vector<glm::mat4> staticLightSpaceMatrices;
+	std::vector<bool> staticCacheValid;
+
+	void createDepthArray( unsigned int& fbo, unsigned int& depthMapArray );
+	void calculateSplits( float nearPlane, float farPlane );
+	AABB calculateSliceBounds( const Camera& camera, float aspect, float nearPlane, float farPlane, const glm::mat4& lightView ) const;
+	glm::mat4 fitLightProjection( const AABB& sliceBounds, const std::vector<AABB>& casterBounds, const std::vector<AABB>& receiverBounds ) const;
+};
\ No newline at end of file
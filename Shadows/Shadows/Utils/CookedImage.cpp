@@ -0,0 +1,184 @@
+#include "CookedImage.hpp"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static_assert( sizeof( CookedImageHeader ) == 32, "unexpected padding in CookedImageHeader" );
+static_assert( sizeof( CookedImageLevel ) == 24, "unexpected padding in CookedImageLevel" );
+
+const uint32_t CookedImage::MAGIC;
+const uint32_t CookedImage::VERSION;
+
+static const uint64_t LEVEL_ALIGNMENT = 16;
+
+static uint64_t alignLevel( uint64_t offset )
+{
+	return ( offset + LEVEL_ALIGNMENT - 1 ) & ~( LEVEL_ALIGNMENT - 1 );
+}
+
+// averages 2x2 texels like glGenerateMipmap, odd sizes repeat the last row or column
+static void downsample( const std::vector<unsigned char>& source, unsigned int width, unsigned int height, unsigned int components,
+	std::vector<unsigned char>& target, unsigned int targetWidth, unsigned int targetHeight )
+{
+	target.resize( ( size_t )targetWidth * targetHeight * components );
+	for ( unsigned int y = 0; y < targetHeight; y++ ) {
+		unsigned int y0 = std::min( y * 2, height - 1 );
+		unsigned int y1 = std::min( y * 2 + 1, height - 1 );
+		for ( unsigned int x = 0; x < targetWidth; x++ ) {
+			unsigned int x0 = std::min( x * 2, width - 1 );
+			unsigned int x1 = std::min( x * 2 + 1, width - 1 );
+			for ( unsigned int c = 0; c < components; c++ ) {
+				unsigned int sum = source[ ( ( size_t )y0 * width + x0 ) * components + c ] + source[ ( ( size_t )y0 * width + x1 ) * components + c ] +
+					source[ ( ( size_t )y1 * width + x0 ) * components + c ] + source[ ( ( size_t )y1 * width + x1 ) * components + c ];
+				target[ ( ( size_t )y * targetWidth + x ) * components + c ] = ( unsigned char )( ( sum + 2 ) / 4 );
+			}
+		}
+	}
+}
+
+CookedImage::CookedImage()
+	: Header( nullptr ), Levels( nullptr )
+{
+}
+
+bool CookedImage::Open( const char* path, uint64_t sourceHash )
+{
+	Close();
+
+	if ( !file.Open( path ) )
+		return false;
+
+	if ( file.Size < sizeof( CookedImageHeader ) ) {
+		Close();
+		return false;
+	}
+
+	Header = ( const CookedImageHeader* )file.Data;
+	if ( Header->Magic != MAGIC || Header->Version != VERSION || Header->SourceHash != sourceHash || !validate() ) {
+		Close();
+		return false;
+	}
+
+	Levels = ( const CookedImageLevel* )( file.Data + sizeof( CookedImageHeader ) );
+
+	return true;
+}
+
+void CookedImage::Close()
+{
+	file.Close();
+
+	Header = nullptr;
+	Levels = nullptr;
+}
+
+const unsigned char* CookedImage::GetLevelData( unsigned int level ) const
+{
+	return file.Data + Levels[ level ].Offset;
+}
+
+bool CookedImage::validate() const
+{
+	if ( Header->Components < 1 || Header->Components > 4 || Header->LevelCount == 0 || Header->LevelCount > 32 ||
+		sizeof( CookedImageHeader ) + ( uint64_t )Header->LevelCount * sizeof( CookedImageLevel ) > file.Size )
+		return false;
+
+	const CookedImageLevel* levels = ( const CookedImageLevel* )( file.Data + sizeof( CookedImageHeader ) );
+	for ( uint32_t i = 0; i < Header->LevelCount; i++ ) {
+		const CookedImageLevel& level = levels[ i ];
+		if ( level.Size != ( uint64_t )level.Width * level.Height * Header->Components ||
+			level.Offset > file.Size || level.Size > file.Size - level.Offset )
+			return false;
+	}
+
+	return true;
+}
+
+bool CookedImage::Cook( const char* sourcePath, const char* path, uint64_t sourceHash )
+{
+	int width, height, components;
+	unsigned char* data = stbi_load( sourcePath, &width, &height, &components, 0 );
+	if ( !data ) {
+		std::cout << "ERROR::COOKED_IMAGE::SOURCE_NOT_LOADED: " << sourcePath << std::endl;
+		return false;
+	}
+
+	// the whole chain down to 1x1
+	std::vector<std::vector<unsigned char>> levelData( 1 );
+	levelData[ 0 ].assign( data, data + ( size_t )width * height * components );
+	stbi_image_free( data );
+
+	CookedImageHeader header = {};
+	header.Magic = MAGIC;
+	header.Version = VERSION;
+	header.SourceHash = sourceHash;
+	header.Width = ( uint32_t )width;
+	header.Height = ( uint32_t )height;
+	header.Components = ( uint32_t )components;
+
+	std::vector<CookedImageLevel> levels;
+	unsigned int levelWidth = header.Width;
+	unsigned int levelHeight = header.Height;
+	while ( true ) {
+		CookedImageLevel level;
+		level.Width = levelWidth;
+		level.Height = levelHeight;
+		level.Size = levelData.back().size();
+		levels.push_back( level );
+
+		if ( levelWidth == 1 && levelHeight == 1 )
+			break;
+
+		unsigned int nextWidth = std::max( levelWidth / 2, 1u );
+		unsigned int nextHeight = std::max( levelHeight / 2, 1u );
+		levelData.push_back( std::vector<unsigned char>() );
+		downsample( levelData[ levelData.size() - 2 ], levelWidth, levelHeight, header.Components, levelData.back(), nextWidth, nextHeight );
+		levelWidth = nextWidth;
+		levelHeight = nextHeight;
+	}
+	header.LevelCount = ( uint32_t )levels.size();
+
+	uint64_t offset = alignLevel( sizeof( CookedImageHeader ) + levels.size() * sizeof( CookedImageLevel ) );
+	for ( unsigned int i = 0; i < levels.size(); i++ ) {
+		levels[ i ].Offset = offset;
+		offset = alignLevel( offset + levels[ i ].Size );
+	}
+
+	std::string temporaryPath = std::string( path ) + ".tmp";
+	std::ofstream stream( temporaryPath, std::ios::binary | std::ios::trunc );
+	if ( !stream ) {
+		std::cout << "ERROR::COOKED_IMAGE::FILE_NOT_WRITTEN: " << path << std::endl;
+		return false;
+	}
+
+	static const char zeros[ LEVEL_ALIGNMENT ] = {};
+	stream.write( ( const char* )&header, sizeof( header ) );
+	stream.write( ( const char* )levels.data(), ( std::streamsize )( levels.size() * sizeof( CookedImageLevel ) ) );
+	for ( unsigned int i = 0; i < levels.size(); i++ ) {
+		stream.write( zeros, ( std::streamsize )( levels[ i ].Offset - ( uint64_t )stream.tellp() ) );
+		stream.write( ( const char* )levelData[ i ].data(), ( std::streamsize )levelData[ i ].size() );
+	}
+	stream.close();
+
+	if ( !stream ) {
+		std::cout << "ERROR::COOKED_IMAGE::FILE_NOT_WRITTEN: " << path << std::endl;
+		std::remove( temporaryPath.c_str() );
+		return false;
+	}
+
+	// rename() doesn't replace an existing file on every platform
+	std::remove( path );
+	if ( std::rename( temporaryPath.c_str(), path ) != 0 ) {
+		std::cout << "ERROR::COOKED_IMAGE::FILE_NOT_WRITTEN: " << path << std::endl;
+		std::remove( temporaryPath.c_str() );
+		return false;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "MappedFile.hpp"
+
+#include <cstdint>
+
+// Layout of a cooked image file, the levels follow the header and the level table 16 byte aligned
+struct CookedImageHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	// of the image file the levels were decoded from
+	uint64_t SourceHash;
+
+	uint32_t Width;
+	uint32_t Height;
+	// 8 bit channels per pixel, 1 to 4
+	uint32_t Components;
+	uint32_t LevelCount;
+};
+
+struct CookedImageLevel
+{
+	uint64_t Offset;
+	uint64_t Size;
+	uint32_t Width;
+	uint32_t Height;
+};
+
+// Decoded image with its full mip chain, so loading a texture is a mapping and one upload per level instead of
+// decoding the PNG/JPG and generating the mipmaps on every start. Cooked offline next to the source image
+class CookedImage
+{
+public:
+	static const uint32_t MAGIC = 0x4D494353;	// "SCIM"
+	static const uint32_t VERSION = 1;
+
+	// point into the mapping, valid while the image is open
+	const CookedImageHeader* Header;
+	const CookedImageLevel* Levels;
+
+	CookedImage();
+
+	// false if the file is missing, broken, of another version or cooked from a different image
+	bool Open( const char* path, uint64_t sourceHash );
+	void Close();
+
+	// tightly packed rows of the level
+	const unsigned char* GetLevelData( unsigned int level ) const;
+
+	// decodes the source with the current stb_image settings, which have to match the engine's (flipped vertically),
+	// and writes it with box filtered mipmaps
+	static bool Cook( const char* sourcePath, const char* path, uint64_t sourceHash );
+
+private:
+	MappedFile file;
+
+	bool validate() const;
+};
\ No newline at end of file
@@ -0,0 +1,344 @@
+#include "CookedModel.hpp"
+#include "MeshOptimizer.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// the blobs are read in place, so the file layout has to match the structs exactly
+static_assert( sizeof( Vertex ) == 32, "Vertex has to be tightly packed" );
+static_assert( sizeof( CompactVertex ) == 16, "CompactVertex has to be tightly packed" );
+static_assert( sizeof( CompactPosition ) == 8, "CompactPosition has to be tightly packed" );
+static_assert( sizeof( CookedModelHeader ) == 176, "unexpected padding in CookedModelHeader" );
+static_assert( sizeof( CookedMesh ) == 48, "unexpected padding in CookedMesh" );
+static_assert( sizeof( CookedTexture ) == 16, "unexpected padding in CookedTexture" );
+static_assert( sizeof( CookedSource ) == 8, "unexpected padding in CookedSource" );
+
+const uint32_t CookedModel::MAGIC;
+const uint32_t CookedModel::VERSION;
+
+static const uint64_t SECTION_ALIGNMENT = 16;
+
+static uint64_t alignSection( uint64_t offset )
+{
+	return ( offset + SECTION_ALIGNMENT - 1 ) & ~( SECTION_ALIGNMENT - 1 );
+}
+
+static bool sectionFits( uint64_t offset, uint64_t size, uint64_t fileSize )
+{
+	return offset % SECTION_ALIGNMENT == 0 && offset <= fileSize && size <= fileSize - offset;
+}
+
+static void writePadding( std::ofstream& stream, uint64_t offset )
+{
+	static const char zeros[ SECTION_ALIGNMENT ] = {};
+	uint64_t position = ( uint64_t )stream.tellp();
+	stream.write( zeros, ( std::streamsize )( offset - position ) );
+}
+
+CookedModel::CookedModel()
+	: Header( nullptr ), Meshes( nullptr ), Textures( nullptr ), Vertices( nullptr ), Indices( nullptr ),
+	CompactVertices( nullptr ), ShortIndices( nullptr ), Positions( nullptr ), PositionIndices( nullptr ), Sources( nullptr ), strings( nullptr )
+{
+}
+
+bool CookedModel::Open( const char* path )
+{
+	Close();
+
+	if ( !file.Open( path ) )
+		return false;
+
+	if ( file.Size < sizeof( CookedModelHeader ) ) {
+		Close();
+		return false;
+	}
+
+	Header = ( const CookedModelHeader* )file.Data;
+	if ( Header->Magic != MAGIC || Header->Version != VERSION || !validate() ) {
+		Close();
+		return false;
+	}
+
+	Meshes = ( const CookedMesh* )( file.Data + Header->MeshOffset );
+	Textures = ( const CookedTexture* )( file.Data + Header->TextureOffset );
+	Vertices = ( const Vertex* )( file.Data + Header->VertexOffset );
+	Indices = ( const unsigned int* )( file.Data + Header->IndexOffset );
+	CompactVertices = ( const CompactVertex* )( file.Data + Header->CompactVertexOffset );
+	ShortIndices = ( const uint16_t* )( file.Data + Header->ShortIndexOffset );
+	Positions = ( const CompactPosition* )( file.Data + Header->PositionOffset );
+	PositionIndices = ( const uint16_t* )( file.Data + Header->PositionIndexOffset );
+	Sources = ( const CookedSource* )( file.Data + Header->SourceOffset );
+	strings = ( const char* )( file.Data + Header->StringOffset );
+
+	// the sources are only read for the hash, not imported
+	std::string modelPath( path );
+	size_t slash = modelPath.find_last_of( '/' );
+	std::string directory = slash == std::string::npos ? "" : modelPath.substr( 0, slash + 1 );
+
+	std::vector<std::string> sourcePaths;
+	for ( uint32_t i = 0; i < Header->SourceCount; i++ )
+		sourcePaths.push_back( GetSourcePath( Sources[ i ] ) );
+
+	uint64_t sourceHash;
+	HashSourceFiles( directory, sourcePaths, sourceHash );
+	if ( sourceHash != Header->SourceHash ) {
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void CookedModel::Close()
+{
+	file.Close();
+
+	Header = nullptr;
+	Meshes = nullptr;
+	Textures = nullptr;
+	Vertices = nullptr;
+	Indices = nullptr;
+	CompactVertices = nullptr;
+	ShortIndices = nullptr;
+	Positions = nullptr;
+	PositionIndices = nullptr;
+	Sources = nullptr;
+	strings = nullptr;
+}
+
+std::string CookedModel::GetTexturePath( const CookedTexture& texture ) const
+{
+	return std::string( strings + texture.PathOffset, texture.PathLength );
+}
+
+std::string CookedModel::GetTextureType( const CookedTexture& texture ) const
+{
+	return std::string( strings + texture.TypeOffset, texture.TypeLength );
+}
+
+std::string CookedModel::GetSourcePath( const CookedSource& source ) const
+{
+	return std::string( strings + source.PathOffset, source.PathLength );
+}
+
+AABB CookedModel::GetBounds() const
+{
+	return AABB( glm::vec3( Header->BoundsMin[ 0 ], Header->BoundsMin[ 1 ], Header->BoundsMin[ 2 ] ),
+		glm::vec3( Header->BoundsMax[ 0 ], Header->BoundsMax[ 1 ], Header->BoundsMax[ 2 ] ) );
+}
+
+AABB CookedModel::GetBounds( const CookedMesh& mesh ) const
+{
+	return AABB( glm::vec3( mesh.BoundsMin[ 0 ], mesh.BoundsMin[ 1 ], mesh.BoundsMin[ 2 ] ),
+		glm::vec3( mesh.BoundsMax[ 0 ], mesh.BoundsMax[ 1 ], mesh.BoundsMax[ 2 ] ) );
+}
+
+AABB CookedModel::GetPositionBounds() const
+{
+	return AABB( glm::vec3( Header->PositionBoundsMin[ 0 ], Header->PositionBoundsMin[ 1 ], Header->PositionBoundsMin[ 2 ] ),
+		glm::vec3( Header->PositionBoundsMax[ 0 ], Header->PositionBoundsMax[ 1 ], Header->PositionBoundsMax[ 2 ] ) );
+}
+
+bool CookedModel::validate() const
+{
+	// the tables are only bounds checked, the indices themselves are trusted, the file is ours
+	uint64_t size = file.Size;
+	if ( !sectionFits( Header->MeshOffset, ( uint64_t )Header->MeshCount * sizeof( CookedMesh ), size ) ||
+		!sectionFits( Header->TextureOffset, ( uint64_t )Header->TextureCount * sizeof( CookedTexture ), size ) ||
+		!sectionFits( Header->VertexOffset, ( uint64_t )Header->VertexCount * sizeof( Vertex ), size ) ||
+		!sectionFits( Header->IndexOffset, ( uint64_t )Header->IndexCount * sizeof( unsigned int ), size ) ||
+		!sectionFits( Header->CompactVertexOffset, ( uint64_t )Header->VertexCount * sizeof( CompactVertex ), size ) ||
+		!sectionFits( Header->ShortIndexOffset, ( uint64_t )Header->IndexCount * sizeof( uint16_t ), size ) ||
+		!sectionFits( Header->PositionOffset, ( uint64_t )Header->VertexCount * sizeof( CompactPosition ), size ) ||
+		!sectionFits( Header->PositionIndexOffset, ( uint64_t )Header->IndexCount * sizeof( uint16_t ), size ) ||
+		!sectionFits( Header->SourceOffset, ( uint64_t )Header->SourceCount * sizeof( CookedSource ), size ) ||
+		!sectionFits( Header->StringOffset, Header->StringSize, size ) )
+		return false;
+
+	const CookedMesh* meshes = ( const CookedMesh* )( file.Data + Header->MeshOffset );
+	for ( uint32_t i = 0; i < Header->MeshCount; i++ ) {
+		const CookedMesh& mesh = meshes[ i ];
+		if ( ( uint64_t )mesh.FirstVertex + mesh.VertexCount > Header->VertexCount ||
+			( uint64_t )mesh.FirstIndex + mesh.IndexCount > Header->IndexCount ||
+			( uint64_t )mesh.FirstTexture + mesh.TextureCount > Header->TextureCount )
+			return false;
+	}
+
+	const CookedTexture* textures = ( const CookedTexture* )( file.Data + Header->TextureOffset );
+	for ( uint32_t i = 0; i < Header->TextureCount; i++ ) {
+		const CookedTexture& texture = textures[ i ];
+		if ( ( uint64_t )texture.PathOffset + texture.PathLength > Header->StringSize ||
+			( uint64_t )texture.TypeOffset + texture.TypeLength > Header->StringSize )
+			return false;
+	}
+
+	const CookedSource* sources = ( const CookedSource* )( file.Data + Header->SourceOffset );
+	for ( uint32_t i = 0; i < Header->SourceCount; i++ ) {
+		if ( ( uint64_t )sources[ i ].PathOffset + sources[ i ].PathLength > Header->StringSize )
+			return false;
+	}
+
+	return true;
+}
+
+bool CookedModel::Write( const char* path, uint64_t sourceHash, const std::vector<std::string>& sourcePaths,
+	const std::vector<CookedMeshData>& meshes )
+{
+	CookedModelHeader header = {};
+	header.Magic = MAGIC;
+	header.Version = VERSION;
+	header.SourceHash = sourceHash;
+	header.MeshCount = ( uint32_t )meshes.size();
+	header.SourceCount = ( uint32_t )sourcePaths.size();
+
+	std::vector<CookedMesh> meshTable;
+	std::vector<CookedTexture> textureTable;
+	std::string stringData;
+	AABB bounds;
+
+	for ( unsigned int i = 0; i < meshes.size(); i++ ) {
+		const CookedMeshData& data = meshes[ i ];
+
+		CookedMesh mesh;
+		mesh.FirstVertex = header.VertexCount;
+		mesh.VertexCount = ( uint32_t )data.Vertices.size();
+		mesh.FirstIndex = header.IndexCount;
+		mesh.IndexCount = ( uint32_t )data.Indices.size();
+		mesh.FirstTexture = header.TextureCount;
+		mesh.TextureCount = ( uint32_t )data.TexturePaths.size();
+		for ( unsigned int j = 0; j < 3; j++ ) {
+			mesh.BoundsMin[ j ] = data.Bounds.Min[ j ];
+			mesh.BoundsMax[ j ] = data.Bounds.Max[ j ];
+		}
+		meshTable.push_back( mesh );
+
+		for ( unsigned int j = 0; j < data.TexturePaths.size(); j++ ) {
+			CookedTexture texture;
+			texture.PathOffset = ( uint32_t )stringData.size();
+			texture.PathLength = ( uint32_t )data.TexturePaths[ j ].size();
+			stringData += data.TexturePaths[ j ];
+			texture.TypeOffset = ( uint32_t )stringData.size();
+			texture.TypeLength = ( uint32_t )data.TextureTypes[ j ].size();
+			stringData += data.TextureTypes[ j ];
+			textureTable.push_back( texture );
+		}
+
+		header.VertexCount += mesh.VertexCount;
+		header.IndexCount += mesh.IndexCount;
+		header.TextureCount += mesh.TextureCount;
+		bounds.Expand( data.Bounds );
+	}
+
+	std::vector<CookedSource> sourceTable;
+	for ( unsigned int i = 0; i < sourcePaths.size(); i++ ) {
+		CookedSource source;
+		source.PathOffset = ( uint32_t )stringData.size();
+		source.PathLength = ( uint32_t )sourcePaths[ i ].size();
+		stringData += sourcePaths[ i ];
+		sourceTable.push_back( source );
+	}
+
+	// the compact layout relative to the bounds of the whole model, the way Model adds all meshes to the pool at once
+	std::vector<CompactVertex> compactVertices;
+	std::vector<uint16_t> shortIndices;
+	std::vector<CompactPosition> positions;
+	std::vector<unsigned int> positionIndices;
+	compactVertices.reserve( header.VertexCount );
+	shortIndices.reserve( header.IndexCount );
+	positions.reserve( header.VertexCount );
+	positionIndices.reserve( header.IndexCount );
+
+	for ( unsigned int i = 0; i < meshes.size(); i++ ) {
+		const CookedMeshData& data = meshes[ i ];
+		if ( data.Vertices.size() > MAX_COMPACT_VERTICES ) {
+			std::cout << "ERROR::COOKED_MODEL::MESH_TOO_LARGE: " << path << std::endl;
+			return false;
+		}
+
+		for ( unsigned int j = 0; j < data.Vertices.size(); j++ ) {
+			compactVertices.push_back( PackVertex( data.Vertices[ j ], bounds ) );
+
+			// the same bits as the interleaved vertex, like GeometryPool copies them
+			CompactPosition position;
+			std::memcpy( position.Position, compactVertices.back().Position, sizeof( position.Position ) );
+			position.Padding = 0;
+			positions.push_back( position );
+		}
+
+		for ( unsigned int j = 0; j < data.Indices.size(); j++ )
+			shortIndices.push_back( ( uint16_t )data.Indices[ j ] );
+
+		WeldPositions( data.Vertices.data(), ( unsigned int )data.Vertices.size(), data.Indices.data(), ( unsigned int )data.Indices.size(),
+			positionIndices );
+	}
+	std::vector<uint16_t> shortPositionIndices( positionIndices.begin(), positionIndices.end() );
+
+	for ( unsigned int j = 0; j < 3; j++ ) {
+		header.BoundsMin[ j ] = bounds.Min[ j ];
+		header.BoundsMax[ j ] = bounds.Max[ j ];
+		header.PositionBoundsMin[ j ] = bounds.Min[ j ];
+		header.PositionBoundsMax[ j ] = bounds.Max[ j ];
+	}
+
+	header.MeshOffset = alignSection( sizeof( CookedModelHeader ) );
+	header.TextureOffset = alignSection( header.MeshOffset + meshTable.size() * sizeof( CookedMesh ) );
+	header.VertexOffset = alignSection( header.TextureOffset + textureTable.size() * sizeof( CookedTexture ) );
+	header.IndexOffset = alignSection( header.VertexOffset + ( uint64_t )header.VertexCount * sizeof( Vertex ) );
+	header.CompactVertexOffset = alignSection( header.IndexOffset + ( uint64_t )header.IndexCount * sizeof( unsigned int ) );
+	header.ShortIndexOffset = alignSection( header.CompactVertexOffset + compactVertices.size() * sizeof( CompactVertex ) );
+	header.PositionOffset = alignSection( header.ShortIndexOffset + shortIndices.size() * sizeof( uint16_t ) );
+	header.PositionIndexOffset = alignSection( header.PositionOffset + positions.size() * sizeof( CompactPosition ) );
+	header.SourceOffset = alignSection( header.PositionIndexOffset + shortPositionIndices.size() * sizeof( uint16_t ) );
+	header.StringOffset = alignSection( header.SourceOffset + sourceTable.size() * sizeof( CookedSource ) );
+	header.StringSize = stringData.size();
+
+	std::string temporaryPath = std::string( path ) + ".tmp";
+	std::ofstream stream( temporaryPath, std::ios::binary | std::ios::trunc );
+	if ( !stream ) {
+		std::cout << "ERROR::COOKED_MODEL::FILE_NOT_WRITTEN: " << path << std::endl;
+		return false;
+	}
+
+	stream.write( ( const char* )&header, sizeof( header ) );
+	writePadding( stream, header.MeshOffset );
+	stream.write( ( const char* )meshTable.data(), ( std::streamsize )( meshTable.size() * sizeof( CookedMesh ) ) );
+	writePadding( stream, header.TextureOffset );
+	stream.write( ( const char* )textureTable.data(), ( std::streamsize )( textureTable.size() * sizeof( CookedTexture ) ) );
+	writePadding( stream, header.VertexOffset );
+	for ( unsigned int i = 0; i < meshes.size(); i++ )
+		stream.write( ( const char* )meshes[ i ].Vertices.data(), ( std::streamsize )( meshes[ i ].Vertices.size() * sizeof( Vertex ) ) );
+	writePadding( stream, header.IndexOffset );
+	for ( unsigned int i = 0; i < meshes.size(); i++ )
+		stream.write( ( const char* )meshes[ i ].Indices.data(), ( std::streamsize )( meshes[ i ].Indices.size() * sizeof( unsigned int ) ) );
+	writePadding( stream, header.CompactVertexOffset );
+	stream.write( ( const char* )compactVertices.data(), ( std::streamsize )( compactVertices.size() * sizeof( CompactVertex ) ) );
+	writePadding( stream, header.ShortIndexOffset );
+	stream.write( ( const char* )shortIndices.data(), ( std::streamsize )( shortIndices.size() * sizeof( uint16_t ) ) );
+	writePadding( stream, header.PositionOffset );
+	stream.write( ( const char* )positions.data(), ( std::streamsize )( positions.size() * sizeof( CompactPosition ) ) );
+	writePadding( stream, header.PositionIndexOffset );
+	stream.write( ( const char* )shortPositionIndices.data(), ( std::streamsize )( shortPositionIndices.size() * sizeof( uint16_t ) ) );
+	writePadding( stream, header.SourceOffset );
+	stream.write( ( const char* )sourceTable.data(), ( std::streamsize )( sourceTable.size() * sizeof( CookedSource ) ) );
+	writePadding( stream, header.StringOffset );
+	stream.write( stringData.data(), ( std::streamsize )stringData.size() );
+	stream.close();
+
+	if ( !stream ) {
+		std::cout << "ERROR::COOKED_MODEL::FILE_NOT_WRITTEN: " << path << std::endl;
+		std::remove( temporaryPath.c_str() );
+		return false;
+	}
+
+	// rename() doesn't replace an existing file on every platform
+	std::remove( path );
+	if ( std::rename( temporaryPath.c_str(), path ) != 0 ) {
+		std::cout << "ERROR::COOKED_MODEL::FILE_NOT_WRITTEN: " << path << std::endl;
+		std::remove( temporaryPath.c_str() );
+		return false;
+	}
+
+	return true;
+}
\ No newline at end of file
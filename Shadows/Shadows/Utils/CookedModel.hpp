@@ -0,0 +1,143 @@
+#pragma once
+
+#include "Vertex.hpp"
+#include "MappedFile.hpp"
+#include "Bounds.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Layout of a cooked model file. All sections start 16 byte aligned and are read in place from the mapping,
+// so every field has a fixed width. Little endian only, a mismatch shows up as a wrong magic.
+// The geometry is there twice: as Vertex with 32 bit indices and in the layout of VERTEX_FORMAT_COMPACT,
+// so a GeometryPool of either format uploads it as is
+struct CookedModelHeader
+{
+	uint32_t Magic;
+	// bumped whenever the layout or the import settings change, old files are cooked again then
+	uint32_t Version;
+	// of the source files the model was cooked from, see HashSourceFiles()
+	uint64_t SourceHash;
+
+	uint32_t MeshCount;
+	uint32_t TextureCount;
+	uint32_t VertexCount;
+	uint32_t IndexCount;
+	uint32_t SourceCount;
+	uint32_t Padding;
+
+	// from the start of the file
+	uint64_t MeshOffset;
+	uint64_t TextureOffset;
+	uint64_t VertexOffset;
+	uint64_t IndexOffset;
+	// CompactVertex, 16 bit indices, CompactPosition and the welded 16 bit indices of the position stream (see WeldPositions()),
+	// VertexCount and IndexCount of each
+	uint64_t CompactVertexOffset;
+	uint64_t ShortIndexOffset;
+	uint64_t PositionOffset;
+	uint64_t PositionIndexOffset;
+	uint64_t SourceOffset;
+	uint64_t StringOffset;
+	uint64_t StringSize;
+
+	float BoundsMin[ 3 ];
+	float BoundsMax[ 3 ];
+	// the compact positions are packed relative to these
+	float PositionBoundsMin[ 3 ];
+	float PositionBoundsMax[ 3 ];
+};
+
+// One mesh: its vertices and indices in the blobs, the indices start at 0 for every mesh
+struct CookedMesh
+{
+	uint32_t FirstVertex;
+	uint32_t VertexCount;
+	uint32_t FirstIndex;
+	uint32_t IndexCount;
+	uint32_t FirstTexture;
+	uint32_t TextureCount;
+
+	float BoundsMin[ 3 ];
+	float BoundsMax[ 3 ];
+};
+
+// Texture reference of a mesh, path relative to the model and sampler type ("texture_diffuse", ...) in the string section
+struct CookedTexture
+{
+	uint32_t PathOffset;
+	uint32_t PathLength;
+	uint32_t TypeOffset;
+	uint32_t TypeLength;
+};
+
+// File the model was imported from, path relative to the model in the string section
+struct CookedSource
+{
+	uint32_t PathOffset;
+	uint32_t PathLength;
+};
+
+// What gets cooked of a mesh, taken from the import
+struct CookedMeshData
+{
+	std::vector<Vertex> Vertices;
+	std::vector<unsigned int> Indices;
+	// path and type of every texture
+	std::vector<std::string> TexturePaths;
+	std::vector<std::string> TextureTypes;
+	AABB Bounds;
+};
+
+// Binary cache of an imported model: header, mesh table, texture table, the vertex and index blobs of both formats,
+// the source table and the strings. The file is written on the first import and memory mapped on later runs, the blobs are
+// uploaded straight from the mapping. It belongs to the content of the files Assimp read, once one of them changes
+// Open() fails so the model is imported again
+class CookedModel
+{
+public:
+	static const uint32_t MAGIC = 0x444D4353;	// "SCMD"
+	// 2: meshes are optimized on import, 3: identical vertices are joined,
+	// 4: large meshes are split, 5: every file Assimp read is hashed,
+	// 6: the compact layout and the welded position indices are cooked too
+	static const uint32_t VERSION = 6;
+
+	// point into the mapping, valid while the model is open
+	const CookedModelHeader* Header;
+	const CookedMesh* Meshes;
+	const CookedTexture* Textures;
+	const Vertex* Vertices;
+	const unsigned int* Indices;
+	const CompactVertex* CompactVertices;
+	const uint16_t* ShortIndices;
+	const CompactPosition* Positions;
+	const uint16_t* PositionIndices;
+	const CookedSource* Sources;
+
+	CookedModel();
+
+	// false if the file is missing, broken, of another version or one of its sources changed.
+	// The file has to sit next to the model, the sources are looked up relative to it
+	bool Open( const char* path );
+	void Close();
+
+	std::string GetTexturePath( const CookedTexture& texture ) const;
+	std::string GetTextureType( const CookedTexture& texture ) const;
+	std::string GetSourcePath( const CookedSource& source ) const;
+	AABB GetBounds() const;
+	AABB GetBounds( const CookedMesh& mesh ) const;
+	// of the compact vertices and positions
+	AABB GetPositionBounds() const;
+
+	// writes to a temporary file first, so a crash never leaves a half written model behind.
+	// Fails if a mesh has more than MAX_COMPACT_VERTICES vertices
+	static bool Write( const char* path, uint64_t sourceHash, const std::vector<std::string>& sourcePaths,
+		const std::vector<CookedMeshData>& meshes );
+
+private:
+	MappedFile file;
+	const char* strings;
+
+	bool validate() const;
+};
\ No newline at end of file
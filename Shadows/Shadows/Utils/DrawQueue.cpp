@@ -0,0 +1,198 @@
+#include "DrawQueue.hpp"
+#include "RenderState.hpp"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+
+const unsigned int DrawQueue::NO_MATERIAL;
+
+DrawItem::DrawItem( Shader* program, unsigned int material, unsigned int vao, float depth,
+	const GeometryRange& geometry, unsigned int baseInstance, unsigned int instanceCount )
+	: Program( program ), Material( material ), VAO( vao ), Depth( depth ),
+	Geometry( geometry ), BaseInstance( baseInstance ), InstanceCount( instanceCount ),
+	Culler( nullptr ), CullPass(), Group( 0 ), FirstMesh( 0 ), MeshCount( 0 )
+{
+}
+
+DrawItem::DrawItem( Shader* program, unsigned int material, unsigned int vao, float depth,
+	const GpuCuller& culler, const GpuCullPass& cullPass, unsigned int group, unsigned int firstMesh, unsigned int meshCount )
+	: Program( program ), Material( material ), VAO( vao ), Depth( depth ),
+	Geometry(), BaseInstance( 0 ), InstanceCount( 0 ),
+	Culler( &culler ), CullPass( cullPass ), Group( group ), FirstMesh( firstMesh ), MeshCount( meshCount )
+{
+}
+
+DrawQueue::DrawQueue( GeometryPool& geometryPool, float maxDepth )
+	: ItemCount( 0 ), BatchCount( 0 ), ProgramSwitches( 0 ), MaterialSwitches( 0 ), VertexArraySwitches( 0 ),
+	geometryPool( geometryPool ), maxDepth( maxDepth )
+{
+}
+
+unsigned int DrawQueue::AddMaterial( const Mesh& mesh )
+{
+	for ( unsigned int i = 0; i < materials.size(); i++ ) {
+		if ( materials[ i ].MeshTextures && materials[ i ].MeshTextures->HasSameTextures( mesh ) )
+			return i + 1;
+	}
+
+	DrawMaterial material;
+	material.MeshTextures = &mesh;
+	material.Texture = 0;
+	materials.push_back( material );
+
+	return ( unsigned int )materials.size();
+}
+
+unsigned int DrawQueue::AddMaterial( unsigned int texture )
+{
+	for ( unsigned int i = 0; i < materials.size(); i++ ) {
+		if ( !materials[ i ].MeshTextures && materials[ i ].Texture == texture )
+			return i + 1;
+	}
+
+	DrawMaterial material;
+	material.MeshTextures = nullptr;
+	material.Texture = texture;
+	materials.push_back( material );
+
+	return ( unsigned int )materials.size();
+}
+
+void DrawQueue::Submit( DrawPass pass, const DrawItem& item )
+{
+	items[ pass ].push_back( item );
+}
+
+void DrawQueue::Execute( DrawPass pass )
+{
+	std::vector<DrawItem>& passItems = items[ pass ];
+	if ( passItems.empty() )
+		return;
+
+	ItemCount += ( unsigned int )passItems.size();
+
+	sortEntries.resize( passItems.size() );
+	for ( unsigned int i = 0; i < passItems.size(); i++ ) {
+		sortEntries[ i ].Key = makeKey( pass, passItems[ i ] );
+		sortEntries[ i ].Item = i;
+	}
+	sortEntriesByKey();
+
+	// whatever is still queued was meant for the state bound before
+	geometryPool.Submit();
+
+	// the keys only hold the low bits of the state, so the switches compare the real values
+	Shader* program = nullptr;
+	unsigned int material = NO_MATERIAL;
+	unsigned int vao = 0;
+	for ( unsigned int i = 0; i < sortEntries.size(); i++ ) {
+		const DrawItem& item = passItems[ sortEntries[ i ].Item ];
+
+		bool programChanges = i == 0 || item.Program != program;
+		// the sampler uniforms of a material belong to the program
+		bool materialChanges = item.Material != NO_MATERIAL && ( programChanges || item.Material != material );
+		bool vaoChanges = i == 0 || item.VAO != vao;
+
+		if ( programChanges || materialChanges || vaoChanges )
+			flushPool( vao );
+
+		if ( programChanges ) {
+			program = item.Program;
+			program->use();
+			ProgramSwitches++;
+		}
+		if ( materialChanges ) {
+			bindMaterial( *program, item.Material );
+			MaterialSwitches++;
+		}
+		material = item.Material;
+		if ( vaoChanges ) {
+			vao = item.VAO;
+			RenderState::BindVertexArray( vao );
+			VertexArraySwitches++;
+		}
+
+		if ( item.Culler ) {
+			flushPool( vao );
+			item.Culler->Draw( item.CullPass, item.Group, item.FirstMesh, item.MeshCount, vao );
+			BatchCount++;
+		}
+		else
+			geometryPool.AddDraw( item.Geometry, item.BaseInstance, item.InstanceCount );
+	}
+	flushPool( vao );
+
+	passItems.clear();
+}
+
+void DrawQueue::ResetStats()
+{
+	ItemCount = 0;
+	BatchCount = 0;
+	ProgramSwitches = 0;
+	MaterialSwitches = 0;
+	VertexArraySwitches = 0;
+}
+
+unsigned long long DrawQueue::makeKey( DrawPass pass, const DrawItem& item ) const
+{
+	unsigned long long key = ( unsigned long long )( pass & 0xF ) << 60;
+	key |= ( unsigned long long )( item.Program->ID & 0xFFF ) << 48;
+	key |= ( unsigned long long )( item.Material & 0xFFFF ) << 32;
+	key |= ( unsigned long long )( item.VAO & 0xFF ) << 24;
+
+	// front to back, depth passes only care about the state
+	if ( pass == DRAW_PASS_OPAQUE ) {
+		float depth = std::min( std::max( item.Depth / maxDepth, 0.f ), 1.f );
+		key |= ( unsigned long long )( depth * 0xFFFFFF );
+	}
+
+	return key;
+}
+
+void DrawQueue::sortEntriesByKey()
+{
+	unsigned int count = ( unsigned int )sortEntries.size();
+	sortScratch.resize( count );
+
+	for ( unsigned int shift = 0; shift < 64; shift += 8 ) {
+		unsigned int offsets[ 256 ] = {};
+		for ( unsigned int i = 0; i < count; i++ )
+			offsets[ ( sortEntries[ i ].Key >> shift ) & 0xFF ]++;
+
+		// nothing to reorder when all keys share the digit, which is the case for most of the high ones
+		if ( offsets[ ( sortEntries[ 0 ].Key >> shift ) & 0xFF ] == count )
+			continue;
+
+		unsigned int total = 0;
+		for ( unsigned int digit = 0; digit < 256; digit++ ) {
+			unsigned int digitCount = offsets[ digit ];
+			offsets[ digit ] = total;
+			total += digitCount;
+		}
+
+		for ( unsigned int i = 0; i < count; i++ )
+			sortScratch[ offsets[ ( sortEntries[ i ].Key >> shift ) & 0xFF ]++ ] = sortEntries[ i ];
+
+		sortEntries.swap( sortScratch );
+	}
+}
+
+void DrawQueue::bindMaterial( Shader& shader, unsigned int material ) const
+{
+	const DrawMaterial& textures = materials[ material - 1 ];
+	if ( textures.MeshTextures )
+		textures.MeshTextures->BindTextures( shader );
+	else
+		RenderState::BindTexture( 0, GL_TEXTURE_2D, textures.Texture );
+}
+
+void DrawQueue::flushPool( unsigned int vao )
+{
+	if ( geometryPool.GetPendingDraws() == 0 )
+		return;
+
+	geometryPool.Submit( vao );
+	BatchCount++;
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Shader.hpp"
+#include "Mesh.hpp"
+#include "GeometryPool.hpp"
+#include "GpuCuller.hpp"
+
+#include <vector>
+
+// Passes of the queue, every pass is sorted and executed on its own
+enum DrawPass
+{
+	DRAW_PASS_DEPTH,	// sorted by state only, the order doesn't matter for depth
+	DRAW_PASS_OPAQUE,	// sorted by state, then front to back within the same state
+	DRAW_PASS_COUNT,
+};
+
+// Textures bound together for a draw, either the textures of a mesh or a single texture on unit 0
+struct DrawMaterial
+{
+	const Mesh* MeshTextures;
+	unsigned int Texture;
+};
+
+// One queued draw, either instances in the GeometryPool or meshes of a draw group the GpuCuller filled
+struct DrawItem
+{
+	Shader* Program;
+	// returned by DrawQueue::AddMaterial(), NO_MATERIAL keeps whatever textures are bound
+	unsigned int Material;
+	// VAO or DepthVAO of the GeometryPool
+	unsigned int VAO;
+	// distance from the camera, only used by DRAW_PASS_OPAQUE
+	float Depth;
+
+	// GpuCuller is null: instanceCount instances of the geometry, see GeometryPool::AddDraw()
+	GeometryRange Geometry;
+	unsigned int BaseInstance;
+	unsigned int InstanceCount;
+
+	// otherwise the meshes [FirstMesh, FirstMesh + MeshCount) of the group, see GpuCuller::Draw()
+	const GpuCuller* Culler;
+	GpuCullPass CullPass;
+	unsigned int Group;
+	unsigned int FirstMesh;
+	unsigned int MeshCount;
+
+	// instances in the pool
+	DrawItem( Shader* program, unsigned int material, unsigned int vao, float depth,
+		const GeometryRange& geometry, unsigned int baseInstance, unsigned int instanceCount );
+	// meshes the culling pass left in a draw group
+	DrawItem( Shader* program, unsigned int material, unsigned int vao, float depth,
+		const GpuCuller& culler, const GpuCullPass& cullPass, unsigned int group, unsigned int firstMesh, unsigned int meshCount );
+};
+
+// Collects the draws of a pass in any order, then sorts them by a 64 bit key so that draws sharing a program,
+// material and VAO end up next to each other and every state is bound once. The key holds, from the most
+// significant bit: pass (4 bits), program (12), material (16), VAO (8) and a depth bucket (24), which is
+// left empty for DRAW_PASS_DEPTH. Consecutive pool items with the same state are merged into one multi draw
+class DrawQueue
+{
+public:
+	static const unsigned int NO_MATERIAL = 0;
+
+	// since the last ResetStats()
+	unsigned int ItemCount;
+	unsigned int BatchCount;
+	unsigned int ProgramSwitches;
+	unsigned int MaterialSwitches;
+	unsigned int VertexArraySwitches;
+
+	// depth buckets cover [0, maxDepth], everything farther ends up in the last one
+	DrawQueue( GeometryPool& geometryPool, float maxDepth );
+
+	// registers the textures once, materials with the same textures share an index
+	unsigned int AddMaterial( const Mesh& mesh );
+	unsigned int AddMaterial( unsigned int texture );
+
+	void Submit( DrawPass pass, const DrawItem& item );
+
+	// sorts the items of the pass, draws them and clears the pass. The programs have to be set up already,
+	// the items only switch between them
+	void Execute( DrawPass pass );
+
+	void ResetStats();
+
+private:
+	struct SortEntry
+	{
+		unsigned long long Key;
+		unsigned int Item;
+	};
+
+	GeometryPool& geometryPool;
+	float maxDepth;
+
+	std::vector<DrawMaterial> materials;
+	std::vector<DrawItem> items[ DRAW_PASS_COUNT ];
+	// reused by every sort
+	std::vector<SortEntry> sortEntries;
+	std::vector<SortEntry> sortScratch;
+
+	unsigned long long makeKey( DrawPass pass, const DrawItem& item ) const;
+	// stable LSD radix sort with 8 bit digits, digits that are the same in all keys are skipped
+	void sortEntriesByKey();
+	void bindMaterial( Shader& shader, unsigned int material ) const;
+	// draws the pool items merged so far, through the VAO they were queued with
+	void flushPool( unsigned int vao );
+};
\ No newline at end of file
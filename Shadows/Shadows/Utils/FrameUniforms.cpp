@@ -0,0 +1,117 @@
+#include "FrameUniforms.hpp"
+
+#include <GL/glew.h>
+
+#include <cstring>
+
+FrameUniforms::FrameUniforms( unsigned int maxViews )
+	: MaxViews( maxViews ), frameData(), lightData()
+{
+	int offsetAlignment = 256;
+	glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment );
+	alignment = offsetAlignment > 0 ? offsetAlignment : 256;
+
+	lightOffset = alignUp( sizeof( FrameData ) );
+	viewsOffset = lightOffset + alignUp( sizeof( LightData ) );
+
+	staging.resize( viewsOffset + MaxViews * alignUp( sizeof( glm::mat4 ) ) );
+
+	glGenBuffers( 1, &UBO );
+	glBindBuffer( GL_UNIFORM_BUFFER, UBO );
+	glBufferData( GL_UNIFORM_BUFFER, staging.size(), nullptr, GL_STREAM_DRAW );
+	glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+
+	views.reserve( MaxViews );
+}
+
+FrameUniforms::~FrameUniforms()
+{
+	glDeleteBuffers( 1, &UBO );
+}
+
+void FrameUniforms::BindBlocks( const Shader& shader )
+{
+	shader.setUniformBlockBinding( "FrameConstants", FRAME_UBO_BINDING );
+	shader.setUniformBlockBinding( "LightConstants", LIGHT_UBO_BINDING );
+	shader.setUniformBlockBinding( "ShadowView", SHADOW_VIEW_UBO_BINDING );
+}
+
+void FrameUniforms::SetCamera( const glm::mat4& view, const glm::mat4& projection, glm::vec3 viewPos )
+{
+	frameData.Proj = projection;
+	frameData.View = view;
+	frameData.ViewPos = glm::vec4( viewPos, 1.f );
+}
+
+void FrameUniforms::SetLight( glm::vec3 lightPos )
+{
+	lightData.LightPos = lightPos;
+}
+
+void FrameUniforms::SetCascades( const glm::mat4* lightSpaceMatrices, const float* splits, unsigned int count )
+{
+	if ( count > MAX_CASCADES ) {
+		std::cout << "ERROR::FRAME_UNIFORMS::TOO_MANY_CASCADES" << std::endl;
+		count = MAX_CASCADES;
+	}
+
+	for ( unsigned int i = 0; i < count; i++ ) {
+		lightData.LightSpaceMatrices[ i ] = lightSpaceMatrices[ i ];
+		lightData.CascadeSplits[ i ] = glm::vec4( splits[ i ], 0.f, 0.f, 0.f );
+	}
+	lightData.CascadeCount = count;
+}
+
+void FrameUniforms::SetPointShadow( const glm::mat4* faceMatrices, float farPlane )
+{
+	for ( unsigned int i = 0; i < 6; i++ )
+		lightData.PointShadowMatrices[ i ] = faceMatrices[ i ];
+	lightData.PointFarPlane = farPlane;
+}
+
+void FrameUniforms::ClearViews()
+{
+	views.clear();
+}
+
+unsigned int FrameUniforms::AddView( const glm::mat4& lightSpaceMatrix )
+{
+	if ( views.size() >= MaxViews ) {
+		std::cout << "ERROR::FRAME_UNIFORMS::TOO_MANY_VIEWS" << std::endl;
+		return MaxViews - 1;
+	}
+
+	views.push_back( lightSpaceMatrix );
+	return ( unsigned int )views.size() - 1;
+}
+
+void FrameUniforms::Upload()
+{
+	std::memcpy( &staging[ 0 ], &frameData, sizeof( FrameData ) );
+	std::memcpy( &staging[ lightOffset ], &lightData, sizeof( LightData ) );
+
+	unsigned int viewStride = alignUp( sizeof( glm::mat4 ) );
+	for ( unsigned int i = 0; i < views.size(); i++ )
+		std::memcpy( &staging[ viewsOffset + i * viewStride ], &views[ i ], sizeof( glm::mat4 ) );
+
+	unsigned int usedSize = viewsOffset + ( unsigned int )views.size() * viewStride;
+
+	glBindBuffer( GL_UNIFORM_BUFFER, UBO );
+	// orphan the old storage, the previous frame might still be reading from it
+	glBufferData( GL_UNIFORM_BUFFER, staging.size(), nullptr, GL_STREAM_DRAW );
+	glBufferSubData( GL_UNIFORM_BUFFER, 0, usedSize, staging.data() );
+	glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+
+	glBindBufferRange( GL_UNIFORM_BUFFER, FRAME_UBO_BINDING, UBO, 0, sizeof( FrameData ) );
+	glBindBufferRange( GL_UNIFORM_BUFFER, LIGHT_UBO_BINDING, UBO, lightOffset, sizeof( LightData ) );
+}
+
+void FrameUniforms::BindView( unsigned int view ) const
+{
+	glBindBufferRange( GL_UNIFORM_BUFFER, SHADOW_VIEW_UBO_BINDING, UBO, viewsOffset + view * alignUp( sizeof( glm::mat4 ) ), sizeof( glm::mat4 ) );
+}
+
+unsigned int FrameUniforms::alignUp( unsigned int size ) const
+{
+	return ( size + alignment - 1 ) / alignment * alignment;
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Shader.hpp"
+#include "CascadedShadowMap.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Uniform buffer binding points of the shared blocks, SPOT_LIGHTS_UBO_BINDING (0) is taken by the ShadowAtlas
+const unsigned int FRAME_UBO_BINDING = 1;
+const unsigned int LIGHT_UBO_BINDING = 2;
+const unsigned int SHADOW_VIEW_UBO_BINDING = 3;
+
+// The uniforms every shader program shares, kept in one uniform buffer instead of being set on each program:
+//  FrameConstants - camera projection, view and position
+//  LightConstants - the main light, its cascades and its point light shadow
+//  ShadowView     - the light space matrix of one shadow map view, one entry per cascade / atlas tile / cube pass
+// All of it is collected on the CPU and uploaded with a single glBufferSubData per frame, afterwards
+// each shadow view is selected with glBindBufferRange
+class FrameUniforms
+{
+public:
+	unsigned int UBO;
+	unsigned int MaxViews;
+
+	FrameUniforms( unsigned int maxViews );
+	~FrameUniforms();
+
+	// connects the blocks of the shader to the binding points, only has to be done once per program
+	static void BindBlocks( const Shader& shader );
+
+	void SetCamera( const glm::mat4& view, const glm::mat4& projection, glm::vec3 viewPos );
+	void SetLight( glm::vec3 lightPos );
+	// the cascades the shading shaders pick from, count is at most MAX_CASCADES
+	void SetCascades( const glm::mat4* lightSpaceMatrices, const float* splits, unsigned int count );
+	// the cube map faces pointDepthShader renders and the far plane the distances are divided by
+	void SetPointShadow( const glm::mat4* faceMatrices, float farPlane );
+
+	// shadow views are collected from scratch every frame, AddView returns the index for BindView
+	void ClearViews();
+	unsigned int AddView( const glm::mat4& lightSpaceMatrix );
+
+	// uploads everything and binds the frame and light blocks
+	void Upload();
+
+	// selects the light space matrix the depth shaders use
+	void BindView( unsigned int view ) const;
+
+private:
+	// std140 layouts, have to match the blocks in the shaders
+	struct FrameData
+	{
+		glm::mat4 Proj;
+		glm::mat4 View;
+		glm::vec4 ViewPos;
+	};
+
+	struct LightData
+	{
+		glm::vec3 LightPos;
+		float PointFarPlane;
+		glm::mat4 LightSpaceMatrices[ MAX_CASCADES ];
+		// only x is used, array elements take a vec4 each
+		glm::vec4 CascadeSplits[ MAX_CASCADES ];
+		glm::mat4 PointShadowMatrices[ 6 ];
+		int CascadeCount;
+		int Padding[ 3 ];
+	};
+
+	// ranges bound with glBindBufferRange have to start at multiples of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	unsigned int alignment;
+	unsigned int lightOffset;
+	unsigned int viewsOffset;
+
+	FrameData frameData;
+	LightData lightData;
+	std::vector<glm::mat4> views;
+
+	// CPU copy of the whole buffer
+	std::vector<unsigned char> staging;
+
+	unsigned int alignUp( unsigned int size ) const;
+};
\ No newline at end of file
@@ -0,0 +1,342 @@
+#include "GeometryPool.hpp"
+#include "RenderState.hpp"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+GeometryPool::GeometryPool( const ObjectBuffer& objectBuffer, unsigned int vertexCapacity, unsigned int indexCapacity, unsigned int commandCapacity,
+	VertexFormat format, bool positionStream )
+	: DepthVAO( 0 ), PositionVBO( 0 ), DepthEBO( 0 ),
+	VertexCapacity( vertexCapacity ), IndexCapacity( indexCapacity ), VertexCount( 0 ), IndexCount( 0 ),
+	CommandCapacity( commandCapacity ), Format( format ), PositionStream( positionStream ), objectBuffer( objectBuffer ), commandOffset( 0 )
+{
+	if ( Format == VERTEX_FORMAT_COMPACT ) {
+		VertexSize = sizeof( CompactVertex );
+		IndexSize = sizeof( unsigned short );
+		PositionSize = sizeof( CompactPosition );
+		IndexType = GL_UNSIGNED_SHORT;
+	}
+	else {
+		VertexSize = sizeof( Vertex );
+		IndexSize = sizeof( unsigned int );
+		PositionSize = sizeof( glm::vec3 );
+		IndexType = GL_UNSIGNED_INT;
+	}
+
+	glGenBuffers( 1, &VBO );
+	glBindBuffer( GL_ARRAY_BUFFER, VBO );
+	glBufferData( GL_ARRAY_BUFFER, VertexCapacity * VertexSize, nullptr, GL_STATIC_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	glGenBuffers( 1, &EBO );
+	glBindBuffer( GL_COPY_WRITE_BUFFER, EBO );
+	glBufferData( GL_COPY_WRITE_BUFFER, IndexCapacity * IndexSize, nullptr, GL_STATIC_DRAW );
+	glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+
+	glGenBuffers( 1, &IndirectBuffer );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, IndirectBuffer );
+	glBufferData( GL_DRAW_INDIRECT_BUFFER, CommandCapacity * sizeof( DrawElementsIndirectCommand ), nullptr, GL_STREAM_DRAW );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	glGenVertexArrays( 1, &VAO );
+	DepthVAO = VAO;
+
+	if ( PositionStream ) {
+		glGenBuffers( 1, &PositionVBO );
+		glBindBuffer( GL_ARRAY_BUFFER, PositionVBO );
+		glBufferData( GL_ARRAY_BUFFER, VertexCapacity * PositionSize, nullptr, GL_STATIC_DRAW );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+		glGenBuffers( 1, &DepthEBO );
+		glBindBuffer( GL_COPY_WRITE_BUFFER, DepthEBO );
+		glBufferData( GL_COPY_WRITE_BUFFER, IndexCapacity * IndexSize, nullptr, GL_STATIC_DRAW );
+		glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+
+		glGenVertexArrays( 1, &DepthVAO );
+	}
+
+	setupVertexArray();
+
+	commands.reserve( 64 );
+}
+
+GeometryPool::~GeometryPool()
+{
+	glDeleteVertexArrays( 1, &VAO );
+	if ( PositionStream ) {
+		glDeleteVertexArrays( 1, &DepthVAO );
+		glDeleteBuffers( 1, &PositionVBO );
+		glDeleteBuffers( 1, &DepthEBO );
+	}
+	RenderState::Invalidate();
+	glDeleteBuffers( 1, &VBO );
+	glDeleteBuffers( 1, &EBO );
+	glDeleteBuffers( 1, &IndirectBuffer );
+}
+
+GeometryRange GeometryPool::Add( const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const AABB& positionBounds,
+	const unsigned int* positionIndices )
+{
+	return Add( vertices.data(), ( unsigned int )vertices.size(), indices.data(), ( unsigned int )indices.size(), positionBounds, positionIndices );
+}
+
+GeometryRange GeometryPool::Add( const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount,
+	const AABB& positionBounds, const unsigned int* positionIndices )
+{
+	if ( !positionIndices )
+		positionIndices = indices;
+
+	const void* vertexData = vertices;
+	const void* indexData = indices;
+	const void* positionData = nullptr;
+	const void* positionIndexData = positionIndices;
+
+	if ( Format == VERTEX_FORMAT_COMPACT ) {
+		if ( !shortenIndices( indices, indexCount, shortIndices ) ||
+			( PositionStream && !shortenIndices( positionIndices, indexCount, shortPositionIndices ) ) ) {
+			std::cout << "ERROR::GEOMETRY_POOL::INDEX_OUT_OF_RANGE" << std::endl;
+			GeometryRange empty = {};
+			return empty;
+		}
+
+		packedVertices.resize( vertexCount );
+		for ( unsigned int i = 0; i < vertexCount; i++ )
+			packedVertices[ i ] = PackVertex( vertices[ i ], positionBounds );
+
+		vertexData = packedVertices.data();
+		indexData = shortIndices.data();
+		positionIndexData = shortPositionIndices.data();
+	}
+
+	if ( PositionStream ) {
+		// the same bits as in the interleaved stream, the depth pre-pass relies on both ending up at the same depth
+		if ( Format == VERTEX_FORMAT_COMPACT ) {
+			packedPositions.resize( vertexCount );
+			for ( unsigned int i = 0; i < vertexCount; i++ ) {
+				std::memcpy( packedPositions[ i ].Position, packedVertices[ i ].Position, sizeof( packedPositions[ i ].Position ) );
+				packedPositions[ i ].Padding = 0;
+			}
+			positionData = packedPositions.data();
+		}
+		else {
+			positions.resize( vertexCount );
+			for ( unsigned int i = 0; i < vertexCount; i++ )
+				positions[ i ] = vertices[ i ].Position;
+			positionData = positions.data();
+		}
+	}
+
+	return upload( vertexData, vertexCount, indexData, indexCount, positionData, positionIndexData, positionBounds );
+}
+
+GeometryRange GeometryPool::Add( const CompactVertex* vertices, unsigned int vertexCount, const unsigned short* indices, unsigned int indexCount,
+	const AABB& positionBounds, const CompactPosition* positions, const unsigned short* positionIndices )
+{
+	if ( Format != VERTEX_FORMAT_COMPACT ) {
+		std::cout << "ERROR::GEOMETRY_POOL::FORMAT_MISMATCH" << std::endl;
+		GeometryRange empty = {};
+		return empty;
+	}
+
+	if ( PositionStream && !positions ) {
+		packedPositions.resize( vertexCount );
+		for ( unsigned int i = 0; i < vertexCount; i++ ) {
+			std::memcpy( packedPositions[ i ].Position, vertices[ i ].Position, sizeof( packedPositions[ i ].Position ) );
+			packedPositions[ i ].Padding = 0;
+		}
+		positions = packedPositions.data();
+	}
+
+	return upload( vertices, vertexCount, indices, indexCount, positions, positionIndices ? positionIndices : indices, positionBounds );
+}
+
+GeometryRange GeometryPool::upload( const void* vertexData, unsigned int vertexCount, const void* indexData, unsigned int indexCount,
+	const void* positionData, const void* positionIndexData, const AABB& positionBounds )
+{
+	if ( VertexCount + vertexCount > VertexCapacity ) {
+		unsigned int capacity = VertexCapacity;
+		while ( VertexCount + vertexCount > capacity )
+			capacity *= 2;
+
+		grow( VBO, VertexCount * VertexSize, capacity * VertexSize );
+		if ( PositionStream )
+			grow( PositionVBO, VertexCount * PositionSize, capacity * PositionSize );
+		VertexCapacity = capacity;
+		setupVertexArray();
+	}
+
+	if ( IndexCount + indexCount > IndexCapacity ) {
+		unsigned int capacity = IndexCapacity;
+		while ( IndexCount + indexCount > capacity )
+			capacity *= 2;
+
+		grow( EBO, IndexCount * IndexSize, capacity * IndexSize );
+		if ( PositionStream )
+			grow( DepthEBO, IndexCount * IndexSize, capacity * IndexSize );
+		IndexCapacity = capacity;
+		setupVertexArray();
+	}
+
+	GeometryRange range;
+	range.FirstIndex = IndexCount;
+	range.IndexCount = indexCount;
+	range.BaseVertex = VertexCount;
+	range.PositionBounds = positionBounds;
+
+	glBindBuffer( GL_ARRAY_BUFFER, VBO );
+	glBufferSubData( GL_ARRAY_BUFFER, VertexCount * VertexSize, vertexCount * VertexSize, vertexData );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	// not through GL_ELEMENT_ARRAY_BUFFER, that binding belongs to whatever VAO is bound right now
+	glBindBuffer( GL_COPY_WRITE_BUFFER, EBO );
+	glBufferSubData( GL_COPY_WRITE_BUFFER, IndexCount * IndexSize, indexCount * IndexSize, indexData );
+	glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+
+	if ( PositionStream ) {
+		glBindBuffer( GL_ARRAY_BUFFER, PositionVBO );
+		glBufferSubData( GL_ARRAY_BUFFER, VertexCount * PositionSize, vertexCount * PositionSize, positionData );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+		glBindBuffer( GL_COPY_WRITE_BUFFER, DepthEBO );
+		glBufferSubData( GL_COPY_WRITE_BUFFER, IndexCount * IndexSize, indexCount * IndexSize, positionIndexData );
+		glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+	}
+
+	VertexCount += vertexCount;
+	IndexCount += indexCount;
+
+	return range;
+}
+
+void GeometryPool::AddDraw( const GeometryRange& geometry, unsigned int baseInstance, unsigned int instanceCount )
+{
+	DrawElementsIndirectCommand command;
+	command.Count = geometry.IndexCount;
+	command.InstanceCount = instanceCount;
+	command.FirstIndex = geometry.FirstIndex;
+	command.BaseVertex = geometry.BaseVertex;
+	command.BaseInstance = baseInstance;
+
+	commands.push_back( command );
+}
+
+void GeometryPool::Submit( unsigned int vertexArray )
+{
+	if ( commands.empty() )
+		return;
+
+	RenderState::BindVertexArray( vertexArray ? vertexArray : VAO );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, IndirectBuffer );
+
+	// more commands than the indirect buffer holds go out in several multi draws
+	unsigned int total = ( unsigned int )commands.size();
+	for ( unsigned int first = 0; first < total; first += CommandCapacity ) {
+		unsigned int count = std::min( total - first, CommandCapacity );
+
+		// same scheme as the instance stream of the ObjectBuffer: append, orphan when full
+		if ( commandOffset + count > CommandCapacity ) {
+			glBufferData( GL_DRAW_INDIRECT_BUFFER, CommandCapacity * sizeof( DrawElementsIndirectCommand ), nullptr, GL_STREAM_DRAW );
+			commandOffset = 0;
+		}
+
+		void* mapped = glMapBufferRange( GL_DRAW_INDIRECT_BUFFER, commandOffset * sizeof( DrawElementsIndirectCommand ), count * sizeof( DrawElementsIndirectCommand ),
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT );
+		if ( mapped ) {
+			std::memcpy( mapped, commands.data() + first, count * sizeof( DrawElementsIndirectCommand ) );
+			glUnmapBuffer( GL_DRAW_INDIRECT_BUFFER );
+		}
+
+		glMultiDrawElementsIndirect( GL_TRIANGLES, IndexType, ( void* )( commandOffset * sizeof( DrawElementsIndirectCommand ) ), count, 0 );
+		commandOffset += count;
+	}
+
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	commands.clear();
+}
+
+unsigned int GeometryPool::GetPendingDraws() const
+{
+	return ( unsigned int )commands.size();
+}
+
+void GeometryPool::setupVertexArray()
+{
+	RenderState::BindVertexArray( VAO );
+	glBindBuffer( GL_ARRAY_BUFFER, VBO );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, EBO );
+
+	glEnableVertexAttribArray( 0 );
+	glEnableVertexAttribArray( 1 );
+	glEnableVertexAttribArray( 2 );
+
+	if ( Format == VERTEX_FORMAT_COMPACT ) {
+		// the fixed function fetch unpacks everything, the shaders see the same floats as with VERTEX_FORMAT_FLOAT.
+		// Only the positions stay in [-1, 1], the model matrices of the ObjectBuffer scale them back
+		glVertexAttribPointer( 0, 3, GL_SHORT, GL_TRUE, sizeof( CompactVertex ), ( void* )offsetof( CompactVertex, Position ) );
+		glVertexAttribPointer( 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof( CompactVertex ), ( void* )offsetof( CompactVertex, Normal ) );
+		glVertexAttribPointer( 2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof( CompactVertex ), ( void* )offsetof( CompactVertex, TexCoords ) );
+	}
+	else {
+		// vertex position
+		glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, sizeof( Vertex ), ( void* )0 );
+		// vertex normals
+		glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, sizeof( Vertex ), ( void* )offsetof( Vertex, Normal ) );
+		// vertex texture coordinates
+		glVertexAttribPointer( 2, 2, GL_FLOAT, GL_FALSE, sizeof( Vertex ), ( void* )offsetof( Vertex, TexCoords ) );
+	}
+
+	objectBuffer.AttachInstanceStream();
+
+	if ( PositionStream ) {
+		RenderState::BindVertexArray( DepthVAO );
+		glBindBuffer( GL_ARRAY_BUFFER, PositionVBO );
+		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, DepthEBO );
+
+		// only the position, the depth shaders don't read anything else
+		glEnableVertexAttribArray( 0 );
+		if ( Format == VERTEX_FORMAT_COMPACT )
+			glVertexAttribPointer( 0, 3, GL_SHORT, GL_TRUE, sizeof( CompactPosition ), ( void* )0 );
+		else
+			glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, sizeof( glm::vec3 ), ( void* )0 );
+
+		objectBuffer.AttachInstanceStream();
+	}
+
+	RenderState::BindVertexArray( 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
+
+bool GeometryPool::shortenIndices( const unsigned int* indices, unsigned int indexCount, std::vector<unsigned short>& result ) const
+{
+	result.resize( indexCount );
+	for ( unsigned int i = 0; i < indexCount; i++ ) {
+		// 0xFFFF is the largest index and the primitive restart index, a mesh of MAX_COMPACT_VERTICES vertices stays below it
+		if ( indices[ i ] >= MAX_COMPACT_VERTICES )
+			return false;
+		result[ i ] = ( unsigned short )indices[ i ];
+	}
+
+	return true;
+}
+
+void GeometryPool::grow( unsigned int& buffer, unsigned int usedBytes, unsigned int newBytes )
+{
+	unsigned int newBuffer;
+	glGenBuffers( 1, &newBuffer );
+	glBindBuffer( GL_COPY_WRITE_BUFFER, newBuffer );
+	glBufferData( GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_STATIC_DRAW );
+
+	glBindBuffer( GL_COPY_READ_BUFFER, buffer );
+	if ( usedBytes > 0 )
+		glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes );
+
+	glBindBuffer( GL_COPY_READ_BUFFER, 0 );
+	glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+
+	glDeleteBuffers( 1, &buffer );
+	buffer = newBuffer;
+}
\ No newline at end of file
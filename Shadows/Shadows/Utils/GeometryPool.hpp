@@ -0,0 +1,118 @@
+#pragma once
+
+#include "ObjectBuffer.hpp"
+#include "Vertex.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Where a piece of geometry ended up in the GeometryPool
+struct GeometryRange
+{
+	unsigned int FirstIndex;
+	unsigned int IndexCount;
+	unsigned int BaseVertex;
+	// VERTEX_FORMAT_COMPACT stores the positions relative to these, the objects drawing the range decode them with
+	// the same bounds (see ObjectBuffer::SetPositionBounds())
+	AABB PositionBounds;
+};
+
+// Layout of glMultiDrawElementsIndirect, defined by OpenGL
+struct DrawElementsIndirectCommand
+{
+	unsigned int Count;
+	unsigned int InstanceCount;
+	unsigned int FirstIndex;
+	unsigned int BaseVertex;
+	unsigned int BaseInstance;
+};
+
+// All geometry of the scene sub-allocated from one vertex and one index buffer behind a single VAO, so switching
+// between meshes doesn't change any state. Draws are queued as indirect commands and a whole batch of them
+// is submitted with one glMultiDrawElementsIndirect. All geometry is stored in the same VertexFormat.
+// Optionally the positions are stored a second time in a stream of their own behind DepthVAO, for passes that only need depth.
+// The stream lines up with the interleaved one (same base vertex and first index), so every GeometryRange and indirect command
+// works with either VAO. Its index buffer can weld the corners that only differ in normal or texture coordinates (see WeldPositions())
+class GeometryPool
+{
+public:
+	// render data
+	unsigned int VAO;
+	unsigned int VBO;
+	unsigned int EBO;
+	unsigned int IndirectBuffer;
+	// the position stream, DepthVAO is VAO without one
+	unsigned int DepthVAO;
+	unsigned int PositionVBO;
+	unsigned int DepthEBO;
+
+	// allocated sizes, the buffers double when they run out
+	unsigned int VertexCapacity;
+	unsigned int IndexCapacity;
+	unsigned int VertexCount;
+	unsigned int IndexCount;
+
+	// commands the indirect buffer holds before it starts over in fresh storage
+	unsigned int CommandCapacity;
+
+	VertexFormat Format;
+	// in bytes
+	unsigned int VertexSize;
+	unsigned int IndexSize;
+	unsigned int PositionSize;
+	// of glDrawElements*
+	GLenum IndexType;
+	bool PositionStream;
+
+	// the ObjectBuffer has to be created with the same format
+	GeometryPool( const ObjectBuffer& objectBuffer, unsigned int vertexCapacity, unsigned int indexCapacity, unsigned int commandCapacity,
+		VertexFormat format = VERTEX_FORMAT_FLOAT, bool positionStream = false );
+	~GeometryPool();
+
+	// copies the geometry into the pool, indices are relative to the first of the vertices. VERTEX_FORMAT_COMPACT stores the positions
+	// relative to positionBounds (see CompactVertex), which have to contain all of them and end up in the returned range.
+	// positionIndices go into the index buffer of the position stream, the same as indices if null
+	GeometryRange Add( const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const AABB& positionBounds,
+		const unsigned int* positionIndices = nullptr );
+	// same from raw arrays
+	GeometryRange Add( const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount,
+		const AABB& positionBounds, const unsigned int* positionIndices = nullptr );
+	// geometry that is already in the layout of VERTEX_FORMAT_COMPACT, e.g. out of a cooked model, goes into the buffers without
+	// any conversion. Only for that format, the vertices have to be packed relative to positionBounds.
+	// positions are copied out of the vertices if null, positionIndices are the same as indices if null
+	GeometryRange Add( const CompactVertex* vertices, unsigned int vertexCount, const unsigned short* indices, unsigned int indexCount,
+		const AABB& positionBounds, const CompactPosition* positions = nullptr, const unsigned short* positionIndices = nullptr );
+
+	// queues instanceCount instances of the geometry, baseInstance is the start of their object indices (see ObjectBuffer::AddInstances())
+	void AddDraw( const GeometryRange& geometry, unsigned int baseInstance, unsigned int instanceCount );
+
+	// draws all queued commands with the current shader and textures, then clears the queue.
+	// vertexArray is VAO or DepthVAO, 0 is VAO
+	void Submit( unsigned int vertexArray = 0 );
+
+	unsigned int GetPendingDraws() const;
+
+private:
+	const ObjectBuffer& objectBuffer;
+
+	std::vector<DrawElementsIndirectCommand> commands;
+	// next free command of the indirect buffer
+	unsigned int commandOffset;
+
+	// conversion into the compact format, reused by every Add()
+	std::vector<CompactVertex> packedVertices;
+	std::vector<unsigned short> shortIndices;
+	std::vector<unsigned short> shortPositionIndices;
+	std::vector<glm::vec3> positions;
+	std::vector<CompactPosition> packedPositions;
+
+	void setupVertexArray();
+	// appends data that is in the pool's layout already, positionData and positionIndexData are only read with PositionStream
+	GeometryRange upload( const void* vertexData, unsigned int vertexCount, const void* indexData, unsigned int indexCount,
+		const void* positionData, const void* positionIndexData, const AABB& positionBounds );
+	// false if an index doesn't fit into 16 bits
+	bool shortenIndices( const unsigned int* indices, unsigned int indexCount, std::vector<unsigned short>& result ) const;
+	// replaces the buffer with a bigger one that starts out with a copy of the used part
+	void grow( unsigned int& buffer, unsigned int usedBytes, unsigned int newBytes );
+};
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include "GpuCuller.hpp"
+#include "RenderState.hpp"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstring>
+
+// hashed once, Cull() sets them for every pass
+const UniformKey UNIFORM_OBJECT_COUNT( "u_ObjectCount" );
+const UniformKey UNIFORM_COMMAND_OFFSET( "u_CommandOffset" );
+const UniformKey UNIFORM_PLANES( "u_Planes" );
+const UniformKey UNIFORM_PLANE_MASK( "u_PlaneMask" );
+const UniformKey UNIFORM_SPHERE( "u_Sphere" );
+const UniformKey UNIFORM_GROUP_MASK( "u_GroupMask" );
+const UniformKey UNIFORM_FLAGS_MASK( "u_FlagsMask" );
+const UniformKey UNIFORM_FLAGS_VALUE( "u_FlagsValue" );
+const UniformKey UNIFORM_GROUP_FIRST_COMMAND( "u_GroupFirstCommand" );
+const UniformKey UNIFORM_GROUP_COMMAND_COUNT( "u_GroupCommandCount" );
+const UniformKey UNIFORM_OCCLUSION_PHASE( "u_OcclusionPhase" );
+const UniformKey UNIFORM_HI_ZVIEW_PROJECTION( "u_HiZViewProjection" );
+
+const unsigned int GpuCuller::NO_DRAW_GROUP;
+
+OcclusionTest::OcclusionTest( OcclusionPhase phase, const HiZPyramid* pyramid, const glm::mat4& viewProjection )
+	: Phase( phase ), Pyramid( pyramid ), ViewProjection( viewProjection )
+{
+}
+
+GpuCuller::GpuCuller( const GeometryPool& geometryPool, const ObjectBuffer& objectBuffer, unsigned int commandCapacity, unsigned int instanceCapacity )
+	: CommandCapacity( commandCapacity ), InstanceCapacity( instanceCapacity ), PassCount( 0 ), ObjectsTested( 0 ),
+	cullShader( GL_COMPUTE_SHADER, "Shaders/cullInstances.cms" ), geometryPool( geometryPool ), objectBuffer( objectBuffer ),
+	groupCount( 0 ), objectCount( 0 ), commandOffset( 0 ), instanceOffset( 0 )
+{
+	for ( unsigned int i = 0; i < MAX_DRAW_GROUPS; i++ ) {
+		groupFirstCommand[ i ] = 0;
+		groupCommandCount[ i ] = 0;
+		groupFirstInstance[ i ] = 0;
+	}
+
+	glGenBuffers( 1, &CommandBuffer );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, CommandBuffer );
+	glBufferData( GL_DRAW_INDIRECT_BUFFER, CommandCapacity * sizeof( DrawElementsIndirectCommand ), nullptr, GL_DYNAMIC_DRAW );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	glGenBuffers( 1, &InstanceBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, InstanceBuffer );
+	glBufferData( GL_ARRAY_BUFFER, InstanceCapacity * sizeof( unsigned int ), nullptr, GL_DYNAMIC_COPY );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	// sized by SetObjects()
+	glGenBuffers( 1, &VisibilityBuffer );
+
+	cullShader.setInt( "u_HiZ", HIZ_TEXTURE_UNIT );
+	ObjectBuffer::BindBlock( cullShader );
+	cullShader.setStorageBlockBinding( "DrawCommands", DRAW_COMMANDS_SSBO_BINDING );
+	cullShader.setStorageBlockBinding( "Instances", INSTANCES_SSBO_BINDING );
+	cullShader.setStorageBlockBinding( "Visibility", VISIBILITY_SSBO_BINDING );
+}
+
+GpuCuller::~GpuCuller()
+{
+	glDeleteBuffers( 1, &CommandBuffer );
+	glDeleteBuffers( 1, &InstanceBuffer );
+	glDeleteBuffers( 1, &VisibilityBuffer );
+}
+
+unsigned int GpuCuller::AddDrawGroup( const std::vector<GeometryRange>& meshes )
+{
+	if ( groupCount == MAX_DRAW_GROUPS ) {
+		std::cout << "ERROR::GPU_CULLER::TOO_MANY_DRAW_GROUPS" << std::endl;
+		return NO_DRAW_GROUP;
+	}
+
+	groupFirstCommand[ groupCount ] = ( unsigned int )commands.size();
+	groupCommandCount[ groupCount ] = ( unsigned int )meshes.size();
+
+	for ( unsigned int i = 0; i < meshes.size(); i++ ) {
+		DrawElementsIndirectCommand command;
+		command.Count = meshes[ i ].IndexCount;
+		command.InstanceCount = 0;
+		command.FirstIndex = meshes[ i ].FirstIndex;
+		command.BaseVertex = meshes[ i ].BaseVertex;
+		command.BaseInstance = 0;
+		commands.push_back( command );
+	}
+
+	return groupCount++;
+}
+
+void GpuCuller::SetObjects( const std::vector<SceneObject>& objects )
+{
+	unsigned int groupObjects[ MAX_DRAW_GROUPS ] = {};
+	for ( unsigned int i = 0; i < objects.size(); i++ ) {
+		if ( ( unsigned int )objects[ i ].Type < MAX_DRAW_GROUPS )
+			groupObjects[ objects[ i ].Type ]++;
+	}
+
+	objectCount = 0;
+	for ( unsigned int group = 0; group < MAX_DRAW_GROUPS; group++ ) {
+		groupFirstInstance[ group ] = objectCount;
+		objectCount += groupObjects[ group ];
+	}
+
+	if ( objectCount > InstanceCapacity )
+		std::cout << "ERROR::GPU_CULLER::INSTANCE_CAPACITY_EXCEEDED" << std::endl;
+
+	// nothing was visible so far, the first frame draws everything in the second phase
+	std::vector<unsigned int> visibility( std::max( ( unsigned int )objects.size(), 1u ), 0 );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, VisibilityBuffer );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, visibility.size() * sizeof( unsigned int ), visibility.data(), GL_DYNAMIC_COPY );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+}
+
+GpuCullPass GpuCuller::Cull( const CullVolume& volume, unsigned int groupMask, unsigned int flagsMask, unsigned int flagsValue,
+	const OcclusionTest* occlusion )
+{
+	GpuCullPass pass;
+	pass.GroupMask = groupMask;
+
+	unsigned int count = ( unsigned int )commands.size();
+	if ( count == 0 || count > CommandCapacity || objectCount > InstanceCapacity ) {
+		pass.CommandOffset = 0;
+		pass.GroupMask = 0;
+		return pass;
+	}
+
+	// full: orphan the storage, draws of earlier passes that are still queued keep reading the old one
+	if ( commandOffset + count > CommandCapacity ) {
+		glBindBuffer( GL_DRAW_INDIRECT_BUFFER, CommandBuffer );
+		glBufferData( GL_DRAW_INDIRECT_BUFFER, CommandCapacity * sizeof( DrawElementsIndirectCommand ), nullptr, GL_DYNAMIC_DRAW );
+		commandOffset = 0;
+	}
+	if ( instanceOffset + objectCount > InstanceCapacity ) {
+		glBindBuffer( GL_ARRAY_BUFFER, InstanceBuffer );
+		glBufferData( GL_ARRAY_BUFFER, InstanceCapacity * sizeof( unsigned int ), nullptr, GL_DYNAMIC_COPY );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+		instanceOffset = 0;
+	}
+
+	// fresh commands with zero instances, every group starts at its own part of the instance range of the pass
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, CommandBuffer );
+	DrawElementsIndirectCommand* mapped = ( DrawElementsIndirectCommand* )glMapBufferRange( GL_DRAW_INDIRECT_BUFFER,
+		commandOffset * sizeof( DrawElementsIndirectCommand ), count * sizeof( DrawElementsIndirectCommand ),
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT );
+	if ( mapped ) {
+		std::memcpy( mapped, commands.data(), count * sizeof( DrawElementsIndirectCommand ) );
+		for ( unsigned int group = 0; group < groupCount; group++ ) {
+			for ( unsigned int i = 0; i < groupCommandCount[ group ]; i++ )
+				mapped[ groupFirstCommand[ group ] + i ].BaseInstance = instanceOffset + groupFirstInstance[ group ];
+		}
+		glUnmapBuffer( GL_DRAW_INDIRECT_BUFFER );
+	}
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	cullShader.use();
+	cullShader.setUInt( UNIFORM_OBJECT_COUNT, objectBuffer.GetObjectCount() );
+	cullShader.setUInt( UNIFORM_COMMAND_OFFSET, commandOffset );
+	cullShader.setVec4Array( UNIFORM_PLANES, volume.Planes.Planes, 6 );
+	cullShader.setUInt( UNIFORM_PLANE_MASK, volume.PlaneMask );
+	cullShader.setVec4( UNIFORM_SPHERE, volume.Sphere );
+	cullShader.setUInt( UNIFORM_GROUP_MASK, groupMask );
+	cullShader.setUInt( UNIFORM_FLAGS_MASK, flagsMask );
+	cullShader.setUInt( UNIFORM_FLAGS_VALUE, flagsValue );
+	cullShader.setUIntArray( UNIFORM_GROUP_FIRST_COMMAND, groupFirstCommand, MAX_DRAW_GROUPS );
+	cullShader.setUIntArray( UNIFORM_GROUP_COMMAND_COUNT, groupCommandCount, MAX_DRAW_GROUPS );
+
+	// 0 is no occlusion test, the phases follow in the order of OcclusionPhase
+	cullShader.setUInt( UNIFORM_OCCLUSION_PHASE, occlusion ? occlusion->Phase + 1 : 0 );
+	if ( occlusion && occlusion->Pyramid ) {
+		occlusion->Pyramid->BindForReading();
+		cullShader.setMatrix4( UNIFORM_HI_ZVIEW_PROJECTION, occlusion->ViewProjection );
+	}
+
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, DRAW_COMMANDS_SSBO_BINDING, CommandBuffer );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, INSTANCES_SSBO_BINDING, InstanceBuffer );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, VISIBILITY_SSBO_BINDING, VisibilityBuffer );
+
+	glDispatchCompute( ( objectBuffer.GetObjectCount() + 63 ) / 64, 1, 1 );
+
+	// the draws read the counts as indirect commands and the object indices as vertex attributes,
+	// the second occlusion phase reads the visibility the first one left
+	glMemoryBarrier( GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT );
+
+	pass.CommandOffset = commandOffset;
+	commandOffset += count;
+	instanceOffset += objectCount;
+
+	PassCount++;
+	ObjectsTested += objectBuffer.GetObjectCount();
+
+	return pass;
+}
+
+void GpuCuller::Draw( const GpuCullPass& pass, unsigned int vertexArray ) const
+{
+	if ( pass.GroupMask == 0 )
+		return;
+
+	bindInstances( vertexArray );
+
+	// groups outside of the mask still have their commands in the pass, but with zero instances they draw nothing.
+	// Runs of groups in the mask go out as one multi draw
+	unsigned int group = 0;
+	while ( group < groupCount ) {
+		if ( !( pass.GroupMask & ( 1 << group ) ) ) {
+			group++;
+			continue;
+		}
+
+		unsigned int first = groupFirstCommand[ group ];
+		unsigned int count = 0;
+		while ( group < groupCount && ( pass.GroupMask & ( 1 << group ) ) )
+			count += groupCommandCount[ group++ ];
+
+		multiDraw( pass.CommandOffset + first, count );
+	}
+
+	unbindInstances();
+}
+
+void GpuCuller::Draw( const GpuCullPass& pass, unsigned int group, unsigned int firstMesh, unsigned int meshCount, unsigned int vertexArray ) const
+{
+	if ( group >= groupCount || !( pass.GroupMask & ( 1 << group ) ) || firstMesh >= groupCommandCount[ group ] )
+		return;
+
+	if ( firstMesh + meshCount > groupCommandCount[ group ] )
+		meshCount = groupCommandCount[ group ] - firstMesh;
+
+	bindInstances( vertexArray );
+	multiDraw( pass.CommandOffset + groupFirstCommand[ group ] + firstMesh, meshCount );
+	unbindInstances();
+}
+
+void GpuCuller::ResetStats()
+{
+	PassCount = 0;
+	ObjectsTested = 0;
+}
+
+void GpuCuller::bindInstances( unsigned int vertexArray ) const
+{
+	// the commands line up with both streams of the pool
+	RenderState::BindVertexArray( vertexArray ? vertexArray : geometryPool.VAO );
+	glBindBuffer( GL_ARRAY_BUFFER, InstanceBuffer );
+	glVertexAttribIPointer( OBJECT_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof( unsigned int ), ( void* )0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, CommandBuffer );
+}
+
+void GpuCuller::unbindInstances() const
+{
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	// the CPU driven draws of the pool read the instance stream of the ObjectBuffer again
+	objectBuffer.AttachInstanceStream();
+}
+
+void GpuCuller::multiDraw( unsigned int firstCommand, unsigned int count ) const
+{
+	glMultiDrawElementsIndirect( GL_TRIANGLES, geometryPool.IndexType, ( void* )( firstCommand * sizeof( DrawElementsIndirectCommand ) ), count, 0 );
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "Shader.hpp"
+#include "Bounds.hpp"
+#include "SceneObject.hpp"
+#include "ObjectBuffer.hpp"
+#include "GeometryPool.hpp"
+#include "HiZPyramid.hpp"
+
+#include <vector>
+
+// Shader storage binding points of the culling pass, next to OBJECTS_SSBO_BINDING
+const unsigned int DRAW_COMMANDS_SSBO_BINDING = 1;
+const unsigned int INSTANCES_SSBO_BINDING = 2;
+const unsigned int VISIBILITY_SSBO_BINDING = 3;
+// has to match cullInstances.cms
+const unsigned int MAX_DRAW_GROUPS = 8;
+
+// Result of GpuCuller::Cull(), only valid until the next Cull() wraps around
+struct GpuCullPass
+{
+	// first command of the pass in the command buffer
+	unsigned int CommandOffset;
+	unsigned int GroupMask;
+};
+
+// How GpuCuller::Cull() uses a Hi-Z pyramid
+enum OcclusionPhase
+{
+	OCCLUSION_SINGLE,		// everything against the pyramid, e.g. the dynamic casters against the static shadow cache
+	OCCLUSION_FIRST_PHASE,	// no test, only the objects that were visible to the camera last frame
+	OCCLUSION_SECOND_PHASE,	// all other objects against the pyramid of the first phase depth, remembers the visibility for the next frame
+};
+
+struct OcclusionTest
+{
+	OcclusionPhase Phase;
+	// not used by OCCLUSION_FIRST_PHASE
+	const HiZPyramid* Pyramid;
+	// the matrix the depth of the pyramid was rendered with
+	glm::mat4 ViewProjection;
+
+	OcclusionTest( OcclusionPhase phase, const HiZPyramid* pyramid = nullptr, const glm::mat4& viewProjection = glm::mat4( 1.f ) );
+};
+
+// Frustum and occlusion culling on the GPU. A compute pass tests the bounds of every object in the ObjectBuffer against a CullVolume,
+// appends the survivors to an instance buffer and counts them into the instance counts of the indirect commands,
+// which the draws then consume without a round trip to the CPU. The depth and the shading passes use the same data,
+// only the volume and the object filter differ.
+// Objects are drawn in draw groups (the geometry of one SceneObjectType), every mesh of a group is one command
+class GpuCuller
+{
+public:
+	// returned by AddDrawGroup() when there is no room for another group
+	static const unsigned int NO_DRAW_GROUP = 0xFFFFFFFF;
+
+	// render data
+	unsigned int CommandBuffer;
+	unsigned int InstanceBuffer;
+	// 1 for every object the camera saw in the last frame, see OcclusionPhase
+	unsigned int VisibilityBuffer;
+
+	// size of the rings, a pass that doesn't fit anymore starts over in fresh storage
+	unsigned int CommandCapacity;
+	unsigned int InstanceCapacity;
+
+	// since the last ResetStats()
+	unsigned int PassCount;
+	unsigned int ObjectsTested;
+
+	GpuCuller( const GeometryPool& geometryPool, const ObjectBuffer& objectBuffer, unsigned int commandCapacity, unsigned int instanceCapacity );
+	~GpuCuller();
+
+	// adds the geometry of the next draw group, one range per mesh. Groups are numbered in the order they are added,
+	// which has to match the DrawGroup of the objects (their SceneObjectType). A group past MAX_DRAW_GROUPS is refused,
+	// its objects are never drawn instead of being drawn with the geometry of another group
+	unsigned int AddDrawGroup( const std::vector<GeometryRange>& meshes );
+
+	// counts the objects of every group, has to be called again when objects get added or change their type
+	void SetObjects( const std::vector<SceneObject>& objects );
+
+	// tests all objects of the groups in groupMask with (flags & flagsMask) == flagsValue against the volume,
+	// and against the Hi-Z pyramid if there is an occlusion test. The ObjectBuffer has to be up to date and bound for reading
+	GpuCullPass Cull( const CullVolume& volume, unsigned int groupMask, unsigned int flagsMask = 0, unsigned int flagsValue = 0,
+		const OcclusionTest* occlusion = nullptr );
+
+	// draws all groups of the pass with one multi draw and the current shader and textures.
+	// vertexArray is the VAO or the DepthVAO of the pool, 0 is the VAO
+	void Draw( const GpuCullPass& pass, unsigned int vertexArray = 0 ) const;
+	// draws only the meshes [firstMesh, firstMesh + meshCount) of the group, for switching textures in between
+	void Draw( const GpuCullPass& pass, unsigned int group, unsigned int firstMesh, unsigned int meshCount, unsigned int vertexArray = 0 ) const;
+
+	void ResetStats();
+
+private:
+	Shader cullShader;
+	const GeometryPool& geometryPool;
+	const ObjectBuffer& objectBuffer;
+
+	// the commands of every pass, all with a zero instance count. Group after group, one command per mesh
+	std::vector<DrawElementsIndirectCommand> commands;
+	unsigned int groupFirstCommand[ MAX_DRAW_GROUPS ];
+	unsigned int groupCommandCount[ MAX_DRAW_GROUPS ];
+	unsigned int groupCount;
+
+	// every group reserves room for all of its objects in the instance buffer
+	unsigned int groupFirstInstance[ MAX_DRAW_GROUPS ];
+	unsigned int objectCount;
+
+	// next free entry of the rings
+	unsigned int commandOffset;
+	unsigned int instanceOffset;
+
+	// points the instance attribute of the pool VAO at the instance buffer and back at the ObjectBuffer
+	void bindInstances( unsigned int vertexArray ) const;
+	void unbindInstances() const;
+	void multiDraw( unsigned int firstCommand, unsigned int count ) const;
+};
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include "HiZPyramid.hpp"
+#include "RenderState.hpp"
+#include "SceneFramebuffer.hpp"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+
+// hashed once, set for every build and every level
+const UniformKey UNIFORM_LAYER( "u_Layer" );
+const UniformKey UNIFORM_SOURCE_LEVEL( "u_SourceLevel" );
+
+HiZPyramid::HiZPyramid( unsigned int width, unsigned int height )
+	: Width( width ), Height( height ), LevelCount( 1 ),
+	copyDepthShader( GL_COMPUTE_SHADER, "Shaders/hizDownsample.cms", "#define HIZ_COPY_DEPTH" ),
+	copyDepthArrayShader( GL_COMPUTE_SHADER, "Shaders/hizDownsample.cms", "#define HIZ_COPY_DEPTH_ARRAY" ),
+	downsampleShader( GL_COMPUTE_SHADER, "Shaders/hizDownsample.cms" ),
+	depthCopyFBO( 0 ), depthCopyTexture( 0 )
+{
+	createTexture();
+
+	glGenSamplers( 1, &rawSampler );
+	glSamplerParameteri( rawSampler, GL_TEXTURE_COMPARE_MODE, GL_NONE );
+	glSamplerParameteri( rawSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glSamplerParameteri( rawSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+
+	copyDepthShader.use();
+	copyDepthShader.setInt( "u_Source", HIZ_TEXTURE_UNIT );
+	copyDepthArrayShader.use();
+	copyDepthArrayShader.setInt( "u_Source", HIZ_TEXTURE_UNIT );
+	downsampleShader.use();
+	downsampleShader.setInt( "u_Source", HIZ_TEXTURE_UNIT );
+}
+
+HiZPyramid::~HiZPyramid()
+{
+	destroyTextures();
+	glDeleteSamplers( 1, &rawSampler );
+}
+
+void HiZPyramid::BuildFromFramebuffer( unsigned int framebuffer )
+{
+	if ( !depthCopyFBO )
+		createDepthCopy();
+
+	RenderState::BindFramebuffer( GL_READ_FRAMEBUFFER, framebuffer );
+	RenderState::BindFramebuffer( GL_DRAW_FRAMEBUFFER, depthCopyFBO );
+	glBlitFramebuffer( 0, 0, Width, Height, 0, 0, Width, Height, GL_DEPTH_BUFFER_BIT, GL_NEAREST );
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+	RenderState::BindTexture( HIZ_TEXTURE_UNIT, GL_TEXTURE_2D, depthCopyTexture );
+	build( copyDepthShader );
+}
+
+void HiZPyramid::BuildFromDepthLayer( unsigned int depthArray, unsigned int layer )
+{
+	RenderState::BindTexture( HIZ_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, depthArray );
+	copyDepthArrayShader.use();
+	copyDepthArrayShader.setInt( UNIFORM_LAYER, layer );
+	build( copyDepthArrayShader );
+}
+
+void HiZPyramid::BindForReading() const
+{
+	RenderState::BindTexture( HIZ_TEXTURE_UNIT, GL_TEXTURE_2D, Texture );
+}
+
+void HiZPyramid::Resize( unsigned int width, unsigned int height )
+{
+	if ( width == Width && height == Height )
+		return;
+
+	// the depth copy gets recreated at the new size on the next build
+	destroyTextures();
+	Width = width;
+	Height = height;
+	createTexture();
+}
+
+void HiZPyramid::createTexture()
+{
+	LevelCount = 1;
+	while ( ( std::max( Width, Height ) >> LevelCount ) > 0 )
+		LevelCount++;
+
+	glGenTextures( 1, &Texture );
+	RenderState::BindTexture( 0, GL_TEXTURE_2D, Texture );
+	glTexStorage2D( GL_TEXTURE_2D, LevelCount, GL_R32F, Width, Height );
+	// only read with texelFetch, but keep it complete and unfiltered
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	RenderState::BindTexture( 0, GL_TEXTURE_2D, 0 );
+}
+
+void HiZPyramid::createDepthCopy()
+{
+	// same format as the source framebuffer, a depth blit doesn't convert
+	glGenTextures( 1, &depthCopyTexture );
+	RenderState::BindTexture( 0, GL_TEXTURE_2D, depthCopyTexture );
+	glTexStorage2D( GL_TEXTURE_2D, 1, SceneFramebuffer::DEPTH_FORMAT, Width, Height );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	RenderState::BindTexture( 0, GL_TEXTURE_2D, 0 );
+
+	glGenFramebuffers( 1, &depthCopyFBO );
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, depthCopyFBO );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthCopyTexture, 0 );
+	glDrawBuffer( GL_NONE );
+	glReadBuffer( GL_NONE );
+	if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
+		std::cout << "ERROR::HIZ_PYRAMID::FRAMEBUFFER_NOT_COMPLETE" << std::endl;
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, 0 );
+}
+
+void HiZPyramid::build( Shader& copyShader )
+{
+	// level 0 is a plain copy of the depth
+	RenderState::BindSampler( HIZ_TEXTURE_UNIT, rawSampler );
+	copyShader.use();
+	glBindImageTexture( 0, Texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F );
+	glDispatchCompute( ( Width + 7 ) / 8, ( Height + 7 ) / 8, 1 );
+	RenderState::BindSampler( HIZ_TEXTURE_UNIT, 0 );
+
+	// every level reads the one above through the texture while writing its own through the image
+	RenderState::BindTexture( HIZ_TEXTURE_UNIT, GL_TEXTURE_2D, Texture );
+	downsampleShader.use();
+	for ( unsigned int level = 1; level < LevelCount; level++ ) {
+		glMemoryBarrier( GL_TEXTURE_FETCH_BARRIER_BIT );
+
+		unsigned int width = std::max( Width >> level, 1u );
+		unsigned int height = std::max( Height >> level, 1u );
+
+		downsampleShader.setInt( UNIFORM_SOURCE_LEVEL, level - 1 );
+		glBindImageTexture( 0, Texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F );
+		glDispatchCompute( ( width + 7 ) / 8, ( height + 7 ) / 8, 1 );
+	}
+
+	// the culling pass reads the last level with texelFetch
+	glMemoryBarrier( GL_TEXTURE_FETCH_BARRIER_BIT );
+}
+
+void HiZPyramid::destroyTextures()
+{
+	glDeleteTextures( 1, &Texture );
+
+	if ( depthCopyFBO ) {
+		glDeleteFramebuffers( 1, &depthCopyFBO );
+		glDeleteTextures( 1, &depthCopyTexture );
+		depthCopyFBO = 0;
+		depthCopyTexture = 0;
+	}
+
+	RenderState::Invalidate();
+}
\ No newline at end of file
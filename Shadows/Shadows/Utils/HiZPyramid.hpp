@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Shader.hpp"
+
+// Texture unit the pyramid is bound to while it gets built and while GpuCuller tests against it,
+// out of the way of the units the materials and shadow maps use
+const unsigned int HIZ_TEXTURE_UNIT = 15;
+
+// Hierarchical depth buffer for occlusion culling. A R32F texture with a full mip chain where every texel holds the
+// farthest depth of the texels below it, so a box whose nearest depth is behind the (at most 2x2) texels covering
+// its screen rectangle is hidden. Built with a chain of compute downsamples from the camera depth or a shadow map
+class HiZPyramid
+{
+public:
+	// render data
+	unsigned int Texture;
+
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int LevelCount;
+
+	HiZPyramid( unsigned int width, unsigned int height );
+	~HiZPyramid();
+
+	// copies the depth of a framebuffer and builds the pyramid from it. The framebuffer has to be as big as the pyramid
+	// and use a 24 bit depth with 8 bit stencil, e.g. a SceneFramebuffer (the default framebuffer has whatever the driver picked)
+	void BuildFromFramebuffer( unsigned int framebuffer );
+	// builds the pyramid from one layer of a depth texture array, e.g. a shadow cascade. Works with compare mode enabled
+	void BuildFromDepthLayer( unsigned int depthArray, unsigned int layer );
+
+	void BindForReading() const;
+
+	// reallocates the pyramid when the size changed, e.g. after the window got resized
+	void Resize( unsigned int width, unsigned int height );
+
+private:
+	Shader copyDepthShader;
+	Shader copyDepthArrayShader;
+	Shader downsampleShader;
+
+	// a framebuffer can't be sampled, its depth gets blitted in here first. Created on first use
+	unsigned int depthCopyFBO;
+	unsigned int depthCopyTexture;
+
+	// plain depth reads from textures that have compare mode enabled
+	unsigned int rawSampler;
+
+	void createTexture();
+	void createDepthCopy();
+	void destroyTextures();
+	// writes level 0 with the bound copy shader, then reduces it level by level
+	void build( Shader& copyShader );
+};
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+	: Data( nullptr ), Size( 0 )
+#ifdef _WIN32
+	, file( INVALID_HANDLE_VALUE ), mapping( nullptr )
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open( const char* path )
+{
+	Close();
+
+	file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+	if ( file == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER size;
+	if ( !GetFileSizeEx( file, &size ) || size.QuadPart == 0 ) {
+		Close();
+		return false;
+	}
+
+	mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if ( !mapping ) {
+		Close();
+		return false;
+	}
+
+	Data = ( const unsigned char* )MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	if ( !Data ) {
+		Close();
+		return false;
+	}
+	Size = ( size_t )size.QuadPart;
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if ( Data )
+		UnmapViewOfFile( Data );
+	if ( mapping )
+		CloseHandle( mapping );
+	if ( file != INVALID_HANDLE_VALUE )
+		CloseHandle( file );
+
+	Data = nullptr;
+	Size = 0;
+	file = INVALID_HANDLE_VALUE;
+	mapping = nullptr;
+}
+
+#else
+
+bool MappedFile::Open( const char* path )
+{
+	Close();
+
+	int file = open( path, O_RDONLY );
+	if ( file < 0 )
+		return false;
+
+	struct stat info;
+	if ( fstat( file, &info ) != 0 || info.st_size == 0 ) {
+		close( file );
+		return false;
+	}
+
+	void* data = mmap( nullptr, ( size_t )info.st_size, PROT_READ, MAP_PRIVATE, file, 0 );
+	// the mapping keeps its own reference to the file
+	close( file );
+	if ( data == MAP_FAILED )
+		return false;
+
+	Data = ( const unsigned char* )data;
+	Size = ( size_t )info.st_size;
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if ( Data )
+		munmap( ( void* )Data, Size );
+
+	Data = nullptr;
+	Size = 0;
+}
+
+#endif
+
+bool MappedFile::IsOpen() const
+{
+	return Data != nullptr;
+}
+
+void HashBytes( const void* data, size_t size, uint64_t& hash )
+{
+	const unsigned char* bytes = ( const unsigned char* )data;
+	for ( size_t i = 0; i < size; i++ ) {
+		hash ^= bytes[ i ];
+		hash *= 0x100000001B3ULL;
+	}
+}
+
+bool HashFile( const char* path, uint64_t& hash )
+{
+	MappedFile file;
+	if ( !file.Open( path ) )
+		return false;
+
+	hash = HASH_SEED;
+	HashBytes( file.Data, file.Size, hash );
+
+	return true;
+}
+
+void HashSourceFiles( const std::string& directory, const std::vector<std::string>& paths, uint64_t& hash )
+{
+	hash = HASH_SEED;
+	for ( unsigned int i = 0; i < paths.size(); i++ ) {
+		// the terminator keeps "a" + "bc" apart from "ab" + "c"
+		HashBytes( paths[ i ].c_str(), paths[ i ].size() + 1, hash );
+
+		MappedFile file;
+		if ( file.Open( ( directory + paths[ i ] ).c_str() ) )
+			HashBytes( file.Data, file.Size, hash );
+	}
+}
\ No newline at end of file
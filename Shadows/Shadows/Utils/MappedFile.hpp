@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read only view of a whole file mapped into memory. The pages are loaded by the OS on first access,
+// so nothing is copied until the data is actually read
+class MappedFile
+{
+public:
+	const unsigned char* Data;
+	size_t Size;
+
+	MappedFile();
+	~MappedFile();
+
+	// false if the file doesn't exist or can't be mapped, an empty file can't be mapped either
+	bool Open( const char* path );
+	void Close();
+
+	bool IsOpen() const;
+
+private:
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#endif
+
+	MappedFile( const MappedFile& );
+	MappedFile& operator=( const MappedFile& );
+};
+
+// starting value of a 64 bit FNV-1a hash
+const uint64_t HASH_SEED = 0xCBF29CE484222325ULL;
+
+// folds the bytes into the hash, start with HASH_SEED
+void HashBytes( const void* data, size_t size, uint64_t& hash );
+// 64 bit FNV-1a of the file content, what the cooked files are checked against
+bool HashFile( const char* path, uint64_t& hash );
+// hash of the name and the content of every file, the paths are relative to directory (empty or ending in a slash).
+// A missing file only adds its name, so one showing up later changes the hash as well
+void HashSourceFiles( const std::string& directory, const std::vector<std::string>& paths, uint64_t& hash );
\ No newline at end of file
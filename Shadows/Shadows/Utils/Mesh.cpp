@@ -1,46 +1,38 @@
 #include "Mesh.hpp"
+#include "RenderState.hpp"
+#include "MeshOptimizer.hpp"
 
 #include <GL/glew.h>
 
-Mesh::Mesh( std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures )
-	: vertices( vertices ), indices( indices ), textures( textures ),
-	VAO( 0 ), VBO( 0 ), EBO( 0 )
+Mesh::Mesh( std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, GeometryPool& geometryPool,
+	const AABB& positionBounds )
+	: vertices( vertices ), indices( indices ), textures( textures )
 {
-	setupMesh();
-}
-
-void Mesh::setupMesh()
-{
-	glGenVertexArrays( 1, &VAO );
-	glGenBuffers( 1, &VBO );
-	glGenBuffers( 1, &EBO );
-
-	glBindVertexArray( VAO );
-	glBindBuffer( GL_ARRAY_BUFFER, VBO );
-
-	glBufferData( GL_ARRAY_BUFFER, vertices.size() * sizeof( Vertex ),
-		&vertices[ 0 ], GL_STATIC_DRAW );
+	calculateBounds();
+	calculateTextureKeys();
 
-	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, EBO );
-	glBufferData( GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof( unsigned int ),
-		&indices[ 0 ], GL_STATIC_DRAW );
+	std::vector<unsigned int> positionIndices;
+	if ( geometryPool.PositionStream )
+		WeldPositions( this->vertices.data(), ( unsigned int )this->vertices.size(), this->indices.data(), ( unsigned int )this->indices.size(),
+			positionIndices );
 
-	// vertex position
-	glEnableVertexAttribArray( 0 );
-	glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, sizeof( Vertex ), ( void* ) 0 );
-
-	// vertex normals
-	glEnableVertexAttribArray( 1 );
-	glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, sizeof( Vertex ), ( void* ) offsetof( Vertex, Normal ) );
+	Geometry = geometryPool.Add( this->vertices, this->indices, positionBounds, positionIndices.empty() ? nullptr : positionIndices.data() );
+}
 
-	// vertex texture coordinates
-	glEnableVertexAttribArray( 2 );
-	glVertexAttribPointer( 2, 2, GL_FLOAT, GL_FALSE, sizeof( Vertex ), ( void* ) offsetof( Vertex, TexCoords ) );
+Mesh::Mesh( const GeometryRange& geometry, const AABB& bounds, std::vector<Texture> textures )
+	: textures( textures ), Bounds( bounds ), Geometry( geometry )
+{
+	calculateTextureKeys();
+}
 
-	glBindVertexArray( 0 );
+void Mesh::calculateBounds()
+{
+	for ( unsigned int i = 0; i < vertices.size(); i++ ) {
+		Bounds.Expand( vertices[ i ].Position );
+	}
 }
 
-void Mesh::Draw( Shader& shader )
+void Mesh::calculateTextureKeys()
 {
 	unsigned int diffuseNr = 1;
 	unsigned int specularNr = 1;
@@ -53,20 +45,30 @@ void Mesh::Draw( Shader& shader )
 		else if ( name == "texture_specular" )
 			number = std::to_string( specularNr++ );
 
-		glActiveTexture( GL_TEXTURE0 + i );
+		std::string fullName = /*"u_Material." + */name + number;
+		textureKeys.push_back( UniformKey( fullName ) );
+	}
+}
 
+void Mesh::BindTextures( Shader& shader ) const
+{
+	for ( unsigned int i = 0; i < textures.size(); i++ ) {
 		// tell the sampler2D in which texture unit to look at
-		std::string str = name + number;
-		std::string fullName = /*"u_Material." + */str;
-		shader.setInt(fullName.c_str(), i );
+		shader.setSampler( textureKeys[ i ], i );
 
-		glBindTexture( GL_TEXTURE_2D, textures[ i ].id );
+		RenderState::BindTexture( i, GL_TEXTURE_2D, textures[ i ].id );
 	}
+}
+
+bool Mesh::HasSameTextures( const Mesh& other ) const
+{
+	if ( textures.size() != other.textures.size() )
+		return false;
 
-	glActiveTexture( GL_TEXTURE0 );
+	for ( unsigned int i = 0; i < textures.size(); i++ ) {
+		if ( textures[ i ].id != other.textures[ i ].id || textures[ i ].type != other.textures[ i ].type )
+			return false;
+	}
 
-	// draw mesh
-	glBindVertexArray( VAO );
-	glDrawElements( GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0 );
-	glBindVertexArray( 0 );
+	return true;
 }
\ No newline at end of file
@@ -1,19 +1,14 @@
 #pragma once
 
 #include "Shader.hpp"
+#include "Bounds.hpp"
+#include "GeometryPool.hpp"
 
 #include <glm/glm.hpp>
 
 #include <string>
 #include <vector>
 
-struct Vertex
-{
-	glm::vec3 Position;
-	glm::vec3 Normal;
-	glm::vec2 TexCoords;
-};
-
 struct Texture
 {
 	unsigned int id;
@@ -29,13 +24,27 @@ public:
 	std::vector<unsigned int> indices;
 	std::vector<Texture> textures;
 
+	// object space bounds of all vertices, calculated once on creation
+	AABB Bounds;
+
+	// render data, the vertices and indices are copied into the pool on creation
+	GeometryRange Geometry;
+
+	// positionBounds are the bounds of the whole model, see GeometryPool::Add()
 	Mesh( std::vector<Vertex> vertices, std::vector<unsigned int> indices,
-		std::vector<Texture> textures );
-	void Draw( Shader& shader );
+		std::vector<Texture> textures, GeometryPool& geometryPool, const AABB& positionBounds );
+	// geometry that is already in the pool, e.g. uploaded from a cooked model. Keeps no copy of the vertices and indices
+	Mesh( const GeometryRange& geometry, const AABB& bounds, std::vector<Texture> textures );
+
+	// binds the textures and points the sampler uniforms of the shader at them
+	void BindTextures( Shader& shader ) const;
+	// true if both meshes can be drawn without rebinding textures in between
+	bool HasSameTextures( const Mesh& other ) const;
 
 private:
-	// render data
-	unsigned int VAO, VBO, EBO;
+	// sampler uniform of every texture, the names only have to be built once
+	std::vector<UniformKey> textureKeys;
 
-	void setupMesh();
+	void calculateBounds();
+	void calculateTextureKeys();
 };
\ No newline at end of file
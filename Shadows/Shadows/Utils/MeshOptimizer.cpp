@@ -0,0 +1,308 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// the cache Forsyth's scores are tuned for, bigger than ANALYSIS_CACHE_SIZE on purpose
+static const unsigned int FORSYTH_CACHE_SIZE = 32;
+// overdraw clusters shorter than this aren't worth a cold cache
+static const unsigned int MIN_CLUSTER_TRIANGLES = 16;
+
+static const unsigned int NO_INDEX = 0xFFFFFFFF;
+
+static float vertexScore( int cachePosition, unsigned int remainingTriangles )
+{
+	// nothing left to draw with the vertex
+	if ( remainingTriangles == 0 )
+		return -1.f;
+
+	float score = 0.f;
+	if ( cachePosition >= 0 ) {
+		// the vertices of the last triangle get a fixed score, so the order doesn't prefer going back and forth
+		if ( cachePosition < 3 )
+			score = 0.75f;
+		else
+			score = std::pow( 1.f - ( cachePosition - 3 ) / float( FORSYTH_CACHE_SIZE - 3 ), 1.5f );
+	}
+
+	// finishing vertices with few triangles left avoids lone triangles that have to be fetched again later
+	return score + 2.f * std::pow( ( float )remainingTriangles, -0.5f );
+}
+
+VertexCacheStats AnalyzeVertexCache( const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize )
+{
+	// a vertex is in the FIFO as long as fewer than cacheSize vertices were added after it
+	std::vector<unsigned int> addedAt( vertexCount, 0 );
+	std::vector<bool> referenced( vertexCount, false );
+	unsigned int time = cacheSize + 1;
+	unsigned int misses = 0;
+	unsigned int referencedCount = 0;
+
+	for ( unsigned int i = 0; i < indices.size(); i++ ) {
+		unsigned int vertex = indices[ i ];
+		if ( time - addedAt[ vertex ] > cacheSize ) {
+			addedAt[ vertex ] = time++;
+			misses++;
+		}
+		if ( !referenced[ vertex ] ) {
+			referenced[ vertex ] = true;
+			referencedCount++;
+		}
+	}
+
+	VertexCacheStats stats;
+	stats.ACMR = indices.size() >= 3 ? misses / float( indices.size() / 3 ) : 0.f;
+	stats.ATVR = referencedCount > 0 ? misses / float( referencedCount ) : 0.f;
+
+	return stats;
+}
+
+void OptimizeVertexCache( std::vector<unsigned int>& indices, unsigned int vertexCount )
+{
+	unsigned int triangleCount = ( unsigned int )indices.size() / 3;
+	if ( triangleCount == 0 )
+		return;
+
+	// triangles of every vertex, the ones not drawn yet are kept at the front of each list
+	std::vector<unsigned int> adjacencyOffsets( vertexCount + 1, 0 );
+	for ( unsigned int i = 0; i < triangleCount * 3; i++ )
+		adjacencyOffsets[ indices[ i ] + 1 ]++;
+	for ( unsigned int i = 0; i < vertexCount; i++ )
+		adjacencyOffsets[ i + 1 ] += adjacencyOffsets[ i ];
+
+	std::vector<unsigned int> remaining( vertexCount, 0 );
+	std::vector<unsigned int> adjacency( triangleCount * 3 );
+	for ( unsigned int i = 0; i < triangleCount * 3; i++ ) {
+		unsigned int vertex = indices[ i ];
+		adjacency[ adjacencyOffsets[ vertex ] + remaining[ vertex ]++ ] = i / 3;
+	}
+
+	std::vector<int> cachePositions( vertexCount, -1 );
+	std::vector<float> vertexScores( vertexCount );
+	for ( unsigned int i = 0; i < vertexCount; i++ )
+		vertexScores[ i ] = vertexScore( -1, remaining[ i ] );
+
+	std::vector<bool> emitted( triangleCount, false );
+	std::vector<unsigned int> cache;
+	std::vector<unsigned int> nextCache;
+	std::vector<unsigned int> result;
+	result.reserve( triangleCount * 3 );
+
+	unsigned int nextInput = 0;
+	int best = -1;
+	for ( unsigned int n = 0; n < triangleCount; n++ ) {
+		// nothing in the cache has triangles left, continue with the next one in input order
+		if ( best < 0 ) {
+			while ( emitted[ nextInput ] )
+				nextInput++;
+			best = ( int )nextInput;
+		}
+
+		unsigned int triangle = ( unsigned int )best;
+		const unsigned int* vertices = &indices[ triangle * 3 ];
+		emitted[ triangle ] = true;
+		result.insert( result.end(), vertices, vertices + 3 );
+
+		for ( unsigned int k = 0; k < 3; k++ ) {
+			unsigned int vertex = vertices[ k ];
+			unsigned int* triangles = &adjacency[ adjacencyOffsets[ vertex ] ];
+			for ( unsigned int i = 0; i < remaining[ vertex ]; i++ ) {
+				if ( triangles[ i ] == triangle ) {
+					std::swap( triangles[ i ], triangles[ remaining[ vertex ] - 1 ] );
+					remaining[ vertex ]--;
+					break;
+				}
+			}
+		}
+
+		// the vertices of the triangle move to the front, everything else moves back
+		nextCache.clear();
+		for ( unsigned int k = 0; k < 3; k++ ) {
+			if ( std::find( nextCache.begin(), nextCache.end(), vertices[ k ] ) == nextCache.end() )
+				nextCache.push_back( vertices[ k ] );
+		}
+		for ( unsigned int i = 0; i < cache.size(); i++ ) {
+			if ( std::find( nextCache.begin(), nextCache.end(), cache[ i ] ) == nextCache.end() )
+				nextCache.push_back( cache[ i ] );
+		}
+
+		for ( unsigned int i = 0; i < nextCache.size(); i++ ) {
+			unsigned int vertex = nextCache[ i ];
+			cachePositions[ vertex ] = i < FORSYTH_CACHE_SIZE ? ( int )i : -1;
+			vertexScores[ vertex ] = vertexScore( cachePositions[ vertex ], remaining[ vertex ] );
+		}
+
+		// only the triangles of vertices whose score changed can be the next best one
+		best = -1;
+		float bestScore = -1.f;
+		for ( unsigned int i = 0; i < nextCache.size(); i++ ) {
+			unsigned int vertex = nextCache[ i ];
+			const unsigned int* triangles = &adjacency[ adjacencyOffsets[ vertex ] ];
+			for ( unsigned int j = 0; j < remaining[ vertex ]; j++ ) {
+				unsigned int candidate = triangles[ j ];
+				float score = vertexScores[ indices[ candidate * 3 ] ] + vertexScores[ indices[ candidate * 3 + 1 ] ] +
+					vertexScores[ indices[ candidate * 3 + 2 ] ];
+				if ( score > bestScore ) {
+					bestScore = score;
+					best = ( int )candidate;
+				}
+			}
+		}
+
+		if ( nextCache.size() > FORSYTH_CACHE_SIZE )
+			nextCache.resize( FORSYTH_CACHE_SIZE );
+		cache.swap( nextCache );
+	}
+
+	indices.swap( result );
+}
+
+void OptimizeOverdraw( std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold )
+{
+	unsigned int triangleCount = ( unsigned int )indices.size() / 3;
+	if ( triangleCount < MIN_CLUSTER_TRIANGLES * 2 )
+		return;
+
+	float targetACMR = AnalyzeVertexCache( indices, ( unsigned int )vertices.size() ).ACMR * threshold;
+
+	// a cluster ends as soon as it gets within the target on its own, starting with a cold cache
+	std::vector<unsigned int> clusterStarts;
+	std::vector<unsigned int> addedAt( vertices.size(), 0 );
+	unsigned int time = ANALYSIS_CACHE_SIZE + 1;
+	unsigned int clusterMisses = 0;
+	unsigned int clusterTriangles = 0;
+	for ( unsigned int i = 0; i < triangleCount; i++ ) {
+		if ( clusterTriangles == 0 ) {
+			clusterStarts.push_back( i );
+			// everything added before is out of the cache
+			time += ANALYSIS_CACHE_SIZE + 1;
+		}
+
+		for ( unsigned int k = 0; k < 3; k++ ) {
+			unsigned int vertex = indices[ i * 3 + k ];
+			if ( time - addedAt[ vertex ] > ANALYSIS_CACHE_SIZE ) {
+				addedAt[ vertex ] = time++;
+				clusterMisses++;
+			}
+		}
+		clusterTriangles++;
+
+		if ( clusterTriangles >= MIN_CLUSTER_TRIANGLES && clusterMisses <= targetACMR * clusterTriangles ) {
+			clusterMisses = 0;
+			clusterTriangles = 0;
+		}
+	}
+	clusterStarts.push_back( triangleCount );
+
+	unsigned int clusterCount = ( unsigned int )clusterStarts.size() - 1;
+	if ( clusterCount < 2 )
+		return;
+
+	// area weighted centroid and normal of every cluster
+	std::vector<glm::vec3> clusterCentroids( clusterCount, glm::vec3( 0.f ) );
+	std::vector<glm::vec3> clusterNormals( clusterCount, glm::vec3( 0.f ) );
+	std::vector<float> clusterAreas( clusterCount, 0.f );
+	glm::vec3 meshCentroid( 0.f );
+	float meshArea = 0.f;
+	for ( unsigned int c = 0; c < clusterCount; c++ ) {
+		for ( unsigned int i = clusterStarts[ c ]; i < clusterStarts[ c + 1 ]; i++ ) {
+			glm::vec3 a = vertices[ indices[ i * 3 ] ].Position;
+			glm::vec3 b = vertices[ indices[ i * 3 + 1 ] ].Position;
+			glm::vec3 d = vertices[ indices[ i * 3 + 2 ] ].Position;
+
+			glm::vec3 normal = glm::cross( b - a, d - a );
+			float area = glm::length( normal );
+
+			clusterCentroids[ c ] += ( a + b + d ) * ( area / 3.f );
+			clusterNormals[ c ] += normal;
+			clusterAreas[ c ] += area;
+		}
+
+		meshCentroid += clusterCentroids[ c ];
+		meshArea += clusterAreas[ c ];
+	}
+	if ( meshArea > 0.f )
+		meshCentroid /= meshArea;
+
+	// how much a cluster faces away from the center, clusters on the outside are drawn first
+	std::vector<float> sortKeys( clusterCount, 0.f );
+	for ( unsigned int c = 0; c < clusterCount; c++ ) {
+		float normalLength = glm::length( clusterNormals[ c ] );
+		if ( clusterAreas[ c ] > 0.f && normalLength > 0.f )
+			sortKeys[ c ] = glm::dot( clusterCentroids[ c ] / clusterAreas[ c ] - meshCentroid, clusterNormals[ c ] / normalLength );
+	}
+
+	std::vector<unsigned int> order( clusterCount );
+	for ( unsigned int c = 0; c < clusterCount; c++ )
+		order[ c ] = c;
+	std::stable_sort( order.begin(), order.end(), [ &sortKeys ]( unsigned int a, unsigned int b ) { return sortKeys[ a ] > sortKeys[ b ]; } );
+
+	std::vector<unsigned int> result;
+	result.reserve( indices.size() );
+	for ( unsigned int c = 0; c < clusterCount; c++ ) {
+		unsigned int cluster = order[ c ];
+		result.insert( result.end(), indices.begin() + clusterStarts[ cluster ] * 3, indices.begin() + clusterStarts[ cluster + 1 ] * 3 );
+	}
+
+	indices.swap( result );
+}
+
+void OptimizeVertexFetch( std::vector<Vertex>& vertices, std::vector<unsigned int>& indices )
+{
+	std::vector<unsigned int> remap( vertices.size(), NO_INDEX );
+	std::vector<Vertex> result;
+	result.reserve( vertices.size() );
+
+	for ( unsigned int i = 0; i < indices.size(); i++ ) {
+		unsigned int& index = indices[ i ];
+		if ( remap[ index ] == NO_INDEX ) {
+			remap[ index ] = ( unsigned int )result.size();
+			result.push_back( vertices[ index ] );
+		}
+		index = remap[ index ];
+	}
+
+	vertices.swap( result );
+}
+
+MeshOptimizationStats OptimizeMesh( std::vector<Vertex>& vertices, std::vector<unsigned int>& indices )
+{
+	MeshOptimizationStats stats;
+	stats.TriangleCount = ( unsigned int )indices.size() / 3;
+	stats.Before = AnalyzeVertexCache( indices, ( unsigned int )vertices.size() );
+
+	OptimizeVertexCache( indices, ( unsigned int )vertices.size() );
+	OptimizeOverdraw( indices, vertices );
+	OptimizeVertexFetch( vertices, indices );
+
+	stats.After = AnalyzeVertexCache( indices, ( unsigned int )vertices.size() );
+
+	return stats;
+}
+
+void WeldPositions( const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount,
+	std::vector<unsigned int>& result )
+{
+	// compared bit for bit, positions that are merely close would end up at a different depth than in the interleaved stream
+	std::vector<unsigned int> order( vertexCount );
+	for ( unsigned int i = 0; i < vertexCount; i++ )
+		order[ i ] = i;
+
+	auto less = [ vertices ]( unsigned int a, unsigned int b ) {
+		int difference = std::memcmp( &vertices[ a ].Position, &vertices[ b ].Position, sizeof( glm::vec3 ) );
+		return difference != 0 ? difference < 0 : a < b;
+	};
+	std::sort( order.begin(), order.end(), less );
+
+	// the first of every run of equal positions has the lowest index
+	std::vector<unsigned int> remap( vertexCount );
+	for ( unsigned int i = 0; i < vertexCount; i++ ) {
+		bool same = i > 0 && std::memcmp( &vertices[ order[ i ] ].Position, &vertices[ order[ i - 1 ] ].Position, sizeof( glm::vec3 ) ) == 0;
+		remap[ order[ i ] ] = same ? remap[ order[ i - 1 ] ] : order[ i ];
+	}
+
+	result.reserve( result.size() + indexCount );
+	for ( unsigned int i = 0; i < indexCount; i++ )
+		result.push_back( remap[ indices[ i ] ] );
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Vertex.hpp"
+
+#include <vector>
+
+// How well an index order uses a FIFO post-transform cache.
+// ACMR = transformed vertices per triangle (0.5 at best, 3 at worst), ATVR = transformed vertices per vertex (1 at best)
+struct VertexCacheStats
+{
+	float ACMR;
+	float ATVR;
+};
+
+struct MeshOptimizationStats
+{
+	unsigned int TriangleCount;
+	VertexCacheStats Before;
+	VertexCacheStats After;
+};
+
+// size of the FIFO cache the stats are measured with, a typical value for current GPUs
+const unsigned int ANALYSIS_CACHE_SIZE = 16;
+// clusters may be this much worse than the cache optimized order before the overdraw pass stops splitting them
+const float OVERDRAW_THRESHOLD = 1.05f;
+
+VertexCacheStats AnalyzeVertexCache( const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize = ANALYSIS_CACHE_SIZE );
+
+// reorders the triangles with Tom Forsyth's "Linear-Speed Vertex Cache Optimisation": greedily takes the triangle whose vertices
+// are the most recently used and have the fewest remaining triangles
+void OptimizeVertexCache( std::vector<unsigned int>& indices, unsigned int vertexCount );
+// cuts the cache optimized order into clusters that each stay within threshold times its ACMR on their own, then draws
+// the clusters facing away from the center of the mesh first, so they occlude the ones behind them (Sander et al., "Tipsify")
+void OptimizeOverdraw( std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold = OVERDRAW_THRESHOLD );
+// orders the vertices by first use in the index buffer, so fetching them walks memory linearly. Unused vertices are dropped
+void OptimizeVertexFetch( std::vector<Vertex>& vertices, std::vector<unsigned int>& indices );
+
+// all of the above in order, for a triangle list
+MeshOptimizationStats OptimizeMesh( std::vector<Vertex>& vertices, std::vector<unsigned int>& indices );
+
+// indices that point every corner at the first of the vertices with the same position, which welds the seams where only the normal
+// or the texture coordinates differ. Only for passes that read nothing but positions. Appended to result, so the meshes of a model
+// can be welded one after the other, a vertex is never shared between them
+void WeldPositions( const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount,
+	std::vector<unsigned int>& result );
\ No newline at end of file
@@ -1,140 +1,213 @@
 #include "Model.hpp"
+#include "RenderState.hpp"
+#include "ModelImporter.hpp"
+#include "CookedImage.hpp"
 
 #include <stb_image.h>
 #include <glm/glm.hpp>
 #include <GL/glew.h>
 
-Model::Model( const char* path )
+Model::Model( const char* path, GeometryPool& geometryPool )
+	: geometryPool( geometryPool )
 {
 	loadModel( path );
 }
 
-void Model::Draw( Shader& shader )
+void Model::Draw( Shader& shader, unsigned int baseInstance, unsigned int instanceCount )
 {
 	for ( unsigned int i = 0; i < meshes.size(); i++ ) {
-		meshes[ i ].Draw( shader );
+		// whatever is still queued was meant for the textures bound before
+		if ( i == 0 || !meshes[ i ].HasSameTextures( meshes[ i - 1 ] ) ) {
+			geometryPool.Submit();
+			meshes[ i ].BindTextures( shader );
+		}
+
+		geometryPool.AddDraw( meshes[ i ].Geometry, baseInstance, instanceCount );
 	}
 }
 
-void Model::loadModel( std::string path )
+void Model::AddDraws( unsigned int baseInstance, unsigned int instanceCount )
 {
-	Assimp::Importer importer;
-	// Read all the data into the aiScene
-	const aiScene* scene = importer.ReadFile( path, aiProcess_Triangulate | aiProcess_FlipUVs );
+	for ( unsigned int i = 0; i < meshes.size(); i++ ) {
+		geometryPool.AddDraw( meshes[ i ].Geometry, baseInstance, instanceCount );
+	}
+}
 
-	if ( !scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
-		!scene->mRootNode ) {
-		std::cout << "ERROR:ASSIMP::" << importer.GetErrorString() << std::endl;
-		return;
+void Model::Draw( Shader& shader, const GpuCuller& culler, const GpuCullPass& pass, unsigned int group ) const
+{
+	// one multi draw per run of meshes with the same textures
+	unsigned int first = 0;
+	for ( unsigned int i = 1; i <= meshes.size(); i++ ) {
+		if ( i < meshes.size() && meshes[ i ].HasSameTextures( meshes[ first ] ) )
+			continue;
+
+		meshes[ first ].BindTextures( shader );
+		culler.Draw( pass, group, first, i - first );
+		first = i;
 	}
-	directory = path.substr( 0, path.find_last_of( '/' ) );
+}
 
-	processNode( scene->mRootNode, scene );
+void Model::AddMaterials( DrawQueue& queue )
+{
+	materials.clear();
+	for ( unsigned int i = 0; i < meshes.size(); i++ )
+		materials.push_back( queue.AddMaterial( meshes[ i ] ) );
 }
 
-void Model::processNode( aiNode* node, const aiScene* scene )
+void Model::Submit( DrawQueue& queue, DrawPass pass, Shader& shader, float depth, unsigned int baseInstance, unsigned int instanceCount ) const
 {
-	// process all the node's meshes (if any)
-	for ( unsigned int i = 0; i < node->mNumMeshes; i++ ) {
-		aiMesh* mesh = scene->mMeshes[ node->mMeshes[ i ] ];
-		meshes.push_back( processMesh( mesh, scene ) );
+	// the queue merges the meshes of a material into one multi draw again
+	for ( unsigned int i = 0; i < meshes.size(); i++ ) {
+		unsigned int material = pass == DRAW_PASS_DEPTH ? DrawQueue::NO_MATERIAL : materials[ i ];
+		unsigned int vao = pass == DRAW_PASS_DEPTH ? geometryPool.DepthVAO : geometryPool.VAO;
+		queue.Submit( pass, DrawItem( &shader, material, vao, depth, meshes[ i ].Geometry, baseInstance, instanceCount ) );
 	}
-	// then do the same for each of its children
-	for ( unsigned int i = 0; i < node->mNumChildren; i++ ) {
-		processNode( node->mChildren[ i ], scene );
+}
+
+void Model::Submit( DrawQueue& queue, DrawPass pass, Shader& shader, float depth, const GpuCuller& culler, const GpuCullPass& cullPass, unsigned int group ) const
+{
+	// depth passes don't need textures, all meshes can go into one item
+	if ( pass == DRAW_PASS_DEPTH ) {
+		queue.Submit( pass, DrawItem( &shader, DrawQueue::NO_MATERIAL, geometryPool.DepthVAO, depth, culler, cullPass, group, 0, ( unsigned int )meshes.size() ) );
+		return;
+	}
+
+	unsigned int first = 0;
+	for ( unsigned int i = 1; i <= meshes.size(); i++ ) {
+		if ( i < meshes.size() && materials[ i ] == materials[ first ] )
+			continue;
+
+		queue.Submit( pass, DrawItem( &shader, materials[ first ], geometryPool.VAO, depth, culler, cullPass, group, first, i - first ) );
+		first = i;
 	}
 }
 
-Mesh Model::processMesh( aiMesh* mesh, const aiScene* scene )
+AABB Model::GetPositionBounds() const
 {
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
-	std::vector<Texture> textures;
-
-	for ( unsigned int i = 0; i < mesh->mNumVertices; i++ ) {
-		Vertex vertex;
-
-		glm::vec3 vector;
-
-		// position
-		vector.x = mesh->mVertices[ i ].x;
-		vector.y = mesh->mVertices[ i ].y;
-		vector.z = mesh->mVertices[ i ].z;
-		vertex.Position = vector;
-
-		// normals
-		vector.x = mesh->mNormals[ i ].x;
-		vector.y = mesh->mNormals[ i ].y;
-		vector.z = mesh->mNormals[ i ].z;
-		vertex.Normal = vector;
-
-		// texture coordinates
-		if ( mesh->mTextureCoords[ 0 ] ) // does the mesh contain texture coordinates?
-		{
-			glm::vec2 vec;
-			vec.x = mesh->mTextureCoords[ 0 ][ i ].x;
-			vec.y = mesh->mTextureCoords[ 0 ][ i ].y;
-			vertex.TexCoords = vec;
-		}
-		else
-			vertex.TexCoords = glm::vec2( 0.f, 0.f );
+	// all meshes are added with the bounds of the whole model
+	return meshes.empty() ? Bounds : meshes[ 0 ].Geometry.PositionBounds;
+}
 
+std::vector<GeometryRange> Model::GetGeometry() const
+{
+	std::vector<GeometryRange> geometry;
+	for ( unsigned int i = 0; i < meshes.size(); i++ )
+		geometry.push_back( meshes[ i ].Geometry );
+
+	return geometry;
+}
+
+void Model::loadModel( std::string path )
+{
+	directory = path.substr( 0, path.find_last_of( '/' ) );
 
-		vertices.push_back( vertex );
+	std::string cookedPath = path + ".cooked";
+	if ( loadCooked( cookedPath ) )
+		return;
+
+	ModelImporter importer;
+	if ( !importer.Import( path ) )
+		return;
+
+	for ( unsigned int i = 0; i < importer.Meshes.size(); i++ ) {
+		const CookedMeshData& data = importer.Meshes[ i ];
+
+		std::vector<Texture> textures;
+		for ( unsigned int j = 0; j < data.TexturePaths.size(); j++ )
+			textures.push_back( loadTexture( data.TexturePaths[ j ], data.TextureTypes[ j ] ) );
+
+		meshes.push_back( Mesh( data.Vertices, data.Indices, textures, geometryPool, importer.Bounds ) );
 	}
+	Bounds = importer.Bounds;
 
-	// process indices
-	for ( unsigned int i = 0; i < mesh->mNumFaces; i++ ) {
-		aiFace face = mesh->mFaces[ i ];
-		for ( unsigned int j = 0; j < face.mNumIndices; j++ ) {
-			indices.push_back( face.mIndices[ j ] );
-		}
+	std::string report = importer.GetOptimizationReport();
+	if ( !report.empty() )
+		std::cout << path << "\n" << report << std::endl;
+
+	// not being able to cook only costs the import next time
+	CookedModel::Write( cookedPath.c_str(), importer.SourceHash, importer.SourceFiles, importer.Meshes );
+}
+
+bool Model::loadCooked( const std::string& path )
+{
+	CookedModel cooked;
+	if ( !cooked.Open( path.c_str() ) )
+		return false;
+
+	const CookedModelHeader& header = *cooked.Header;
+
+	// all meshes in one upload straight from the mapping, in the pool's own layout if it is the compact one
+	GeometryRange geometry;
+	if ( geometryPool.Format == VERTEX_FORMAT_COMPACT ) {
+		geometry = geometryPool.Add( cooked.CompactVertices, header.VertexCount, cooked.ShortIndices, header.IndexCount, cooked.GetPositionBounds(),
+			cooked.Positions, cooked.PositionIndices );
+	}
+	else {
+		// only the welded indices of the position stream are widened
+		std::vector<unsigned int> positionIndices;
+		if ( geometryPool.PositionStream )
+			positionIndices.assign( cooked.PositionIndices, cooked.PositionIndices + header.IndexCount );
+
+		geometry = geometryPool.Add( cooked.Vertices, header.VertexCount, cooked.Indices, header.IndexCount, cooked.GetPositionBounds(),
+			positionIndices.empty() ? nullptr : positionIndices.data() );
 	}
 
-	// process material
-	if ( mesh->mMaterialIndex >= 0 ) {
-		aiMaterial* material = scene->mMaterials[ mesh->mMaterialIndex ];
+	for ( unsigned int i = 0; i < header.MeshCount; i++ ) {
+		const CookedMesh& mesh = cooked.Meshes[ i ];
 
-		std::vector<Texture> diffuseMaps = loadMaterialTextures( material,
-			aiTextureType_DIFFUSE, "texture_diffuse" );
-		textures.insert( textures.end(), diffuseMaps.begin(), diffuseMaps.end() );
+		GeometryRange range = geometry;
+		range.FirstIndex = geometry.FirstIndex + mesh.FirstIndex;
+		range.IndexCount = mesh.IndexCount;
+		range.BaseVertex = geometry.BaseVertex + mesh.FirstVertex;
+
+		std::vector<Texture> textures;
+		for ( unsigned int j = 0; j < mesh.TextureCount; j++ ) {
+			const CookedTexture& texture = cooked.Textures[ mesh.FirstTexture + j ];
+			textures.push_back( loadTexture( cooked.GetTexturePath( texture ), cooked.GetTextureType( texture ) ) );
+		}
 
-		std::vector<Texture> specularMaps = loadMaterialTextures( material,
-			aiTextureType_SPECULAR, "texture_specular" );
-		textures.insert( textures.end(), specularMaps.begin(), specularMaps.end() );
+		meshes.push_back( Mesh( range, cooked.GetBounds( mesh ), textures ) );
 	}
+	Bounds = cooked.GetBounds();
 
-	return Mesh( vertices, indices, textures );
+	return true;
 }
 
-std::vector<Texture> Model::loadMaterialTextures( aiMaterial* mat, aiTextureType type, std::string typeName )
+Texture Model::loadTexture( const std::string& path, const std::string& typeName )
 {
-	std::vector<Texture> textures;
-	for ( unsigned int i = 0; i < mat->GetTextureCount( type ); i++ ) {
-		aiString str;
-		mat->GetTexture( type, i, &str );
-
-		bool skip = false;
-		for ( unsigned int j = 0; j < textures_loaded.size(); j++ ) {
-			if ( std::strcmp( textures_loaded[ j ].path.data(),
-				str.C_Str() ) == 0 ) {
-				textures.push_back( textures_loaded[ j ] );
-				skip = true;
-				break;
-			}
-		}
-		if ( !skip ) {
-			Texture texture;
+	for ( unsigned int i = 0; i < textures_loaded.size(); i++ ) {
+		if ( textures_loaded[ i ].path == path )
+			return textures_loaded[ i ];
+	}
 
-			texture.id = TextureFromFile( str.C_Str(), directory );
-			texture.type = typeName;
-			texture.path = str.C_Str();
+	Texture texture;
+	texture.id = TextureFromFile( path.c_str(), directory );
+	texture.type = typeName;
+	texture.path = path;
+	textures_loaded.push_back( texture );
 
-			textures.push_back( texture );
-			textures_loaded.push_back( texture );
-		}
+	return texture;
+}
+
+static void uploadCookedImage( const CookedImage& image, unsigned int texture )
+{
+	static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	GLenum format = formats[ image.Header->Components - 1 ];
+
+	RenderState::BindTexture( 0, GL_TEXTURE_2D, texture );
+	// the rows are tightly packed
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	for ( unsigned int i = 0; i < image.Header->LevelCount; i++ ) {
+		const CookedImageLevel& level = image.Levels[ i ];
+		glTexImage2D( GL_TEXTURE_2D, i, format, level.Width, level.Height, 0, format, GL_UNSIGNED_BYTE, image.GetLevelData( i ) );
 	}
-	return textures;
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.Header->LevelCount - 1 );
+
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
 }
 
 unsigned int TextureFromFile( const char* path, const std::string& directory, bool gamma )
@@ -145,6 +218,14 @@ unsigned int TextureFromFile( const char* path, const std::string& directory, bo
 	unsigned int textureID;
 	glGenTextures( 1, &textureID );
 
+	// decoded and mipmapped by the cooker, as long as the image didn't change since
+	uint64_t sourceHash;
+	CookedImage cooked;
+	if ( HashFile( filename.c_str(), sourceHash ) && cooked.Open( ( filename + ".cooked" ).c_str(), sourceHash ) ) {
+		uploadCookedImage( cooked, textureID );
+		return textureID;
+	}
+
 	int width, height, nrComponents;
 	unsigned char* data = stbi_load( filename.c_str(), &width, &height, &nrComponents, 0 );
 	if ( data ) {
@@ -156,7 +237,7 @@ unsigned int TextureFromFile( const char* path, const std::string& directory, bo
 		else if ( nrComponents == 4 )
 			format = GL_RGBA;
 
-		glBindTexture( GL_TEXTURE_2D, textureID );
+		RenderState::BindTexture( 0, GL_TEXTURE_2D, textureID );
 		glTexImage2D( GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data );
 		glGenerateMipmap( GL_TEXTURE_2D );
 
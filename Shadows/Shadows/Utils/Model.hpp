@@ -2,10 +2,9 @@
 
 #include "Mesh.hpp"
 #include "Shader.hpp"
-
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
+#include "GpuCuller.hpp"
+#include "DrawQueue.hpp"
+#include "CookedModel.hpp"
 
 #include <vector>
 #include <string>
@@ -15,19 +14,48 @@ unsigned int TextureFromFile( const char* path, const std::string& directory, bo
 class Model
 {
 public:
-	Model( const char* path );
-	void Draw( Shader& shader );
+	// the meshes are stored in the geometry pool, which has to outlive the model.
+	// The first import cooks the model into path + ".cooked" (or the cooker did it offline), later runs load that file as long as the source is unchanged
+	Model( const char* path, GeometryPool& geometryPool );
+
+	// draws instanceCount instances with their textures, baseInstance is the start of their object indices (see ObjectBuffer::AddInstances()).
+	// Meshes that share textures end up in the same multi draw. The last run stays queued in the pool, so draws that follow
+	// with the same textures join it, whoever binds other textures or finishes the pass has to GeometryPool::Submit() it
+	void Draw( Shader& shader, unsigned int baseInstance, unsigned int instanceCount );
+	// only queues the draws of all meshes in the geometry pool without touching textures, e.g. for depth passes
+	void AddDraws( unsigned int baseInstance, unsigned int instanceCount );
+	// draws the instances the GPU culling pass left in the draw group of the model, with their textures
+	void Draw( Shader& shader, const GpuCuller& culler, const GpuCullPass& pass, unsigned int group ) const;
+
+	// registers the textures of every mesh as a material of the queue, has to be called before the Submit()s
+	void AddMaterials( DrawQueue& queue );
+	// queues one item per run of meshes with the same textures, instead of drawing them right away.
+	// The first one takes instanceCount instances from baseInstance, the second the instances the culling pass left in the group.
+	// DRAW_PASS_DEPTH items only read positions and go through the DepthVAO of the pool
+	void Submit( DrawQueue& queue, DrawPass pass, Shader& shader, float depth, unsigned int baseInstance, unsigned int instanceCount ) const;
+	void Submit( DrawQueue& queue, DrawPass pass, Shader& shader, float depth, const GpuCuller& culler, const GpuCullPass& cullPass, unsigned int group ) const;
+
+	// the pool ranges of all meshes, in draw order, e.g. for GpuCuller::AddDrawGroup()
+	std::vector<GeometryRange> GetGeometry() const;
+	// the bounds the pool packed the positions of all meshes with, see ObjectBuffer::SetPositionBounds()
+	AABB GetPositionBounds() const;
+
+	// object space bounds of all meshes
+	AABB Bounds;
 
 private:
 	std::vector<Mesh> meshes;
+	GeometryPool& geometryPool;
+	// DrawQueue material of every mesh, see AddMaterials()
+	std::vector<unsigned int> materials;
 
 	// model data
 	std::vector<Texture> textures_loaded;
 	std::string directory;
 
 	void loadModel( std::string path );
-	void processNode( aiNode* node, const aiScene* scene );
-	Mesh processMesh( aiMesh* mesh, const aiScene* scene );
-	std::vector<Texture> loadMaterialTextures( aiMaterial* mat,
-		aiTextureType type, std::string typeName );
+	// false if there is no up to date cooked file, nothing is loaded then
+	bool loadCooked( const std::string& path );
+	// loads every texture only once per model
+	Texture loadTexture( const std::string& path, const std::string& typeName );
 };
\ No newline at end of file
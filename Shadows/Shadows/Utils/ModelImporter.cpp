@@ -0,0 +1,177 @@
+#include "ModelImporter.hpp"
+#include "MappedFile.hpp"
+
+#include <assimp/config.h>
+#include <assimp/DefaultIOSystem.h>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+const unsigned int ModelImporter::IMPORT_FLAGS;
+
+// Assimp's file access, noting down every path an importer opens or looks for. Whatever the format pulls in
+// (material libraries, buffers, external textures of embedded formats) ends up in the list without knowing the format
+class RecordingIOSystem : public Assimp::DefaultIOSystem
+{
+public:
+	RecordingIOSystem( const std::string& directory, std::vector<std::string>& paths )
+		: directory( directory ), paths( paths )
+	{
+	}
+
+	bool Exists( const char* pFile ) const override
+	{
+		record( pFile );
+		return DefaultIOSystem::Exists( pFile );
+	}
+
+	Assimp::IOStream* Open( const char* pFile, const char* pMode ) override
+	{
+		record( pFile );
+		return DefaultIOSystem::Open( pFile, pMode );
+	}
+
+private:
+	std::string directory;
+	std::vector<std::string>& paths;
+
+	void record( const char* file ) const
+	{
+		// importers build the paths from the model's, with the separator of the OS
+		std::string path( file );
+		std::replace( path.begin(), path.end(), '\\', '/' );
+		if ( path.compare( 0, directory.size(), directory ) == 0 )
+			path.erase( 0, directory.size() );
+
+		if ( std::find( paths.begin(), paths.end(), path ) == paths.end() )
+			paths.push_back( path );
+	}
+};
+
+ModelImporter::ModelImporter()
+	: SourceHash( HASH_SEED )
+{
+}
+
+bool ModelImporter::Import( const std::string& path )
+{
+	Meshes.clear();
+	Bounds = AABB();
+	Optimization.clear();
+	SourceFiles.clear();
+
+	// relative to the model, so the cooked model doesn't depend on the working directory
+	size_t slash = path.find_last_of( '/' );
+	std::string directory = slash == std::string::npos ? "" : path.substr( 0, slash + 1 );
+
+	Assimp::Importer importer;
+	importer.SetPropertyInteger( AI_CONFIG_PP_SLM_VERTEX_LIMIT, MAX_COMPACT_VERTICES );
+	// owned by the importer from here on
+	importer.SetIOHandler( new RecordingIOSystem( directory, SourceFiles ) );
+	// Read all the data into the aiScene
+	const aiScene* scene = importer.ReadFile( path, IMPORT_FLAGS );
+	HashSourceFiles( directory, SourceFiles, SourceHash );
+
+	if ( !scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
+		!scene->mRootNode ) {
+		std::cout << "ERROR:ASSIMP::" << importer.GetErrorString() << std::endl;
+		return false;
+	}
+
+	processNode( scene->mRootNode, scene );
+
+	return true;
+}
+
+std::string ModelImporter::GetOptimizationReport() const
+{
+	std::ostringstream report;
+	report.precision( 3 );
+	for ( unsigned int i = 0; i < Optimization.size(); i++ ) {
+		const MeshOptimizationStats& stats = Optimization[ i ];
+		if ( stats.TriangleCount == 0 )
+			continue;
+
+		if ( report.tellp() > 0 )
+			report << "\n";
+		report << "mesh " << i << " (" << stats.TriangleCount << " triangles): ACMR " << stats.Before.ACMR << " -> " << stats.After.ACMR
+			<< ", ATVR " << stats.Before.ATVR << " -> " << stats.After.ATVR;
+	}
+
+	return report.str();
+}
+
+void ModelImporter::processNode( aiNode* node, const aiScene* scene )
+{
+	// process all the node's meshes (if any)
+	for ( unsigned int i = 0; i < node->mNumMeshes; i++ ) {
+		aiMesh* mesh = scene->mMeshes[ node->mMeshes[ i ] ];
+		Meshes.push_back( CookedMeshData() );
+		Optimization.push_back( MeshOptimizationStats() );
+		processMesh( mesh, scene, Meshes.back(), Optimization.back() );
+		Bounds.Expand( Meshes.back().Bounds );
+	}
+	// then do the same for each of its children
+	for ( unsigned int i = 0; i < node->mNumChildren; i++ ) {
+		processNode( node->mChildren[ i ], scene );
+	}
+}
+
+void ModelImporter::processMesh( aiMesh* mesh, const aiScene* scene, CookedMeshData& data, MeshOptimizationStats& stats ) const
+{
+	data.Vertices.resize( mesh->mNumVertices );
+	for ( unsigned int i = 0; i < mesh->mNumVertices; i++ ) {
+		Vertex& vertex = data.Vertices[ i ];
+
+		vertex.Position = glm::vec3( mesh->mVertices[ i ].x, mesh->mVertices[ i ].y, mesh->mVertices[ i ].z );
+
+		if ( mesh->mNormals )
+			vertex.Normal = glm::vec3( mesh->mNormals[ i ].x, mesh->mNormals[ i ].y, mesh->mNormals[ i ].z );
+		else
+			vertex.Normal = glm::vec3( 0.f, 0.f, 0.f );
+
+		// texture coordinates
+		if ( mesh->mTextureCoords[ 0 ] ) // does the mesh contain texture coordinates?
+			vertex.TexCoords = glm::vec2( mesh->mTextureCoords[ 0 ][ i ].x, mesh->mTextureCoords[ 0 ][ i ].y );
+		else
+			vertex.TexCoords = glm::vec2( 0.f, 0.f );
+	}
+
+	// process indices, all faces are triangles after aiProcess_Triangulate except for points and lines
+	data.Indices.reserve( mesh->mNumFaces * 3 );
+	for ( unsigned int i = 0; i < mesh->mNumFaces; i++ ) {
+		const aiFace& face = mesh->mFaces[ i ];
+		for ( unsigned int j = 0; j < face.mNumIndices; j++ ) {
+			data.Indices.push_back( face.mIndices[ j ] );
+		}
+	}
+
+	// points and lines can't be reordered as triangles
+	stats = MeshOptimizationStats();
+	if ( mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE )
+		stats = OptimizeMesh( data.Vertices, data.Indices );
+
+	// after the optimization, which drops unused vertices
+	for ( unsigned int i = 0; i < data.Vertices.size(); i++ )
+		data.Bounds.Expand( data.Vertices[ i ].Position );
+
+	// process material
+	if ( mesh->mMaterialIndex >= 0 ) {
+		aiMaterial* material = scene->mMaterials[ mesh->mMaterialIndex ];
+
+		loadMaterialTextures( material, aiTextureType_DIFFUSE, "texture_diffuse", data );
+		loadMaterialTextures( material, aiTextureType_SPECULAR, "texture_specular", data );
+	}
+}
+
+void ModelImporter::loadMaterialTextures( aiMaterial* mat, aiTextureType type, const std::string& typeName, CookedMeshData& data ) const
+{
+	for ( unsigned int i = 0; i < mat->GetTextureCount( type ); i++ ) {
+		aiString str;
+		mat->GetTexture( type, i, &str );
+
+		data.TexturePaths.push_back( str.C_Str() );
+		data.TextureTypes.push_back( typeName );
+	}
+}
\ No newline at end of file
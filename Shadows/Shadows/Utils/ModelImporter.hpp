@@ -0,0 +1,50 @@
+#pragma once
+
+#include "CookedModel.hpp"
+#include "Bounds.hpp"
+#include "MeshOptimizer.hpp"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <string>
+#include <vector>
+
+// Assimp import of a model into plain vertex and index arrays, without touching GL, so Model and the offline cooker share it.
+// Triangle meshes are reordered for the vertex cache, overdraw and vertex fetch on the way (see OptimizeMesh()).
+// Textures are only referenced by path, loading them is up to the caller
+class ModelImporter
+{
+public:
+	// same for the engine and the cooker, changing them needs a new CookedModel::VERSION.
+	// Without joining, formats like OBJ give every corner of every face its own vertex and no order could reuse any.
+	// Meshes are split at MAX_COMPACT_VERTICES, so every mesh fits 16 bit indices
+	static const unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices |
+		aiProcess_SplitLargeMeshes;
+
+	// in the order of the node hierarchy
+	std::vector<CookedMeshData> Meshes;
+	// of all meshes
+	AABB Bounds;
+	// of every mesh in Meshes, TriangleCount is 0 for meshes that weren't optimized
+	std::vector<MeshOptimizationStats> Optimization;
+	// every file Assimp read or looked for while importing, relative to the model directory: the model itself,
+	// OBJ material libraries, glTF buffers, ... What the cooked model is checked against
+	std::vector<std::string> SourceFiles;
+	// of SourceFiles (see HashSourceFiles()), taken right after Assimp read them
+	uint64_t SourceHash;
+
+	ModelImporter();
+
+	// false if Assimp couldn't read the file
+	bool Import( const std::string& path );
+
+	// ACMR and ATVR of every optimized mesh before and after, one line each, empty if nothing was optimized
+	std::string GetOptimizationReport() const;
+
+private:
+	void processNode( aiNode* node, const aiScene* scene );
+	void processMesh( aiMesh* mesh, const aiScene* scene, CookedMeshData& data, MeshOptimizationStats& stats ) const;
+	void loadMaterialTextures( aiMaterial* mat, aiTextureType type, const std::string& typeName, CookedMeshData& data ) const;
+};
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include "ObjectBuffer.hpp"
+
+#include <GL/glew.h>
+
+#include <cstring>
+
+const unsigned int ObjectBuffer::MAX_UPLOAD_GAP;
+
+ObjectBuffer::ObjectBuffer( unsigned int capacity, unsigned int instanceCapacity, VertexFormat vertexFormat )
+	: Capacity( capacity ), InstanceCapacity( instanceCapacity ), vertexFormat( vertexFormat ), instanceOffset( 0 )
+{
+	glGenBuffers( 1, &SSBO );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, SSBO );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, Capacity * sizeof( ObjectData ), nullptr, GL_DYNAMIC_DRAW );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+	glGenBuffers( 1, &InstanceVBO );
+	glBindBuffer( GL_ARRAY_BUFFER, InstanceVBO );
+	glBufferData( GL_ARRAY_BUFFER, InstanceCapacity * sizeof( unsigned int ), nullptr, GL_STREAM_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
+
+ObjectBuffer::~ObjectBuffer()
+{
+	glDeleteBuffers( 1, &SSBO );
+	glDeleteBuffers( 1, &InstanceVBO );
+}
+
+void ObjectBuffer::BindBlock( const Shader& shader )
+{
+	shader.setStorageBlockBinding( "Objects", OBJECTS_SSBO_BINDING );
+}
+
+void ObjectBuffer::AttachInstanceStream() const
+{
+	glBindBuffer( GL_ARRAY_BUFFER, InstanceVBO );
+	glEnableVertexAttribArray( OBJECT_INDEX_ATTRIBUTE );
+	glVertexAttribIPointer( OBJECT_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof( unsigned int ), ( void* )0 );
+	glVertexAttribDivisor( OBJECT_INDEX_ATTRIBUTE, 1 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
+
+InstanceRange ObjectBuffer::AddInstances( const std::vector<unsigned int>& objectIndices )
+{
+	unsigned int count = ( unsigned int )objectIndices.size();
+	if ( count > InstanceCapacity ) {
+		std::cout << "ERROR::OBJECT_BUFFER::TOO_MANY_INSTANCES" << std::endl;
+		count = InstanceCapacity;
+	}
+
+	glBindBuffer( GL_ARRAY_BUFFER, InstanceVBO );
+
+	// full: orphan the storage, draws that are still queued keep reading the old one
+	if ( instanceOffset + count > InstanceCapacity ) {
+		glBufferData( GL_ARRAY_BUFFER, InstanceCapacity * sizeof( unsigned int ), nullptr, GL_STREAM_DRAW );
+		instanceOffset = 0;
+	}
+
+	// the range was never written since the last orphaning, so no draw can be reading it and there is nothing to wait for
+	void* instances = glMapBufferRange( GL_ARRAY_BUFFER, instanceOffset * sizeof( unsigned int ), count * sizeof( unsigned int ),
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT );
+	if ( instances ) {
+		std::memcpy( instances, objectIndices.data(), count * sizeof( unsigned int ) );
+		glUnmapBuffer( GL_ARRAY_BUFFER );
+	}
+	// nothing stored, nothing to draw
+	else
+		count = 0;
+
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	InstanceRange range;
+	range.BaseInstance = instanceOffset;
+	range.Count = count;
+	instanceOffset += count;
+	return range;
+}
+
+void ObjectBuffer::SetPositionBounds( unsigned int drawGroup, const AABB& bounds )
+{
+	if ( drawGroup >= positionBounds.size() )
+		positionBounds.resize( drawGroup + 1 );
+	positionBounds[ drawGroup ] = bounds;
+}
+
+void ObjectBuffer::Update( const std::vector<SceneObject>& objects )
+{
+	if ( objects.size() > Capacity ) {
+		std::cout << "ERROR::OBJECT_BUFFER::CAPACITY_EXCEEDED" << std::endl;
+		return;
+	}
+
+	// a different object count re-uploads everything, otherwise only the runs of dirty objects go up
+	bool resized = objects.size() != data.size();
+	if ( resized )
+		data.resize( objects.size() );
+
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, SSBO );
+
+	// first and last dirty object of the run that isn't uploaded yet
+	unsigned int runStart = 0;
+	unsigned int runEnd = 0;
+	bool inRun = false;
+	for ( unsigned int i = 0; i < objects.size(); i++ ) {
+		if ( !resized && !objects[ i ].IsDirty() ) {
+			// a few clean objects in between are cheaper to send along than another upload
+			if ( inRun && i - runEnd > MAX_UPLOAD_GAP ) {
+				uploadRange( runStart, runEnd + 1 );
+				inRun = false;
+			}
+			continue;
+		}
+
+		if ( !inRun )
+			runStart = i;
+		runEnd = i;
+		inRun = true;
+
+		// inverse transpose of the upper 3x3, once per change instead of once per draw
+		data[ i ].Model = objects[ i ].GetModel();
+		data[ i ].NormalMat = glm::mat4( glm::inverse( glm::transpose( glm::mat3( data[ i ].Model ) ) ) );
+		// the normals aren't quantized relative to anything, so only the positions are decoded
+		if ( vertexFormat == VERTEX_FORMAT_COMPACT ) {
+			if ( objects[ i ].Type < positionBounds.size() && !positionBounds[ objects[ i ].Type ].IsEmpty() )
+				data[ i ].Model *= GetPositionDecodeMatrix( positionBounds[ objects[ i ].Type ] );
+			else
+				std::cout << "ERROR::OBJECT_BUFFER::NO_POSITION_BOUNDS" << std::endl;
+		}
+
+		const AABB& bounds = objects[ i ].GetWorldBounds();
+		data[ i ].BoundsCenter = glm::vec4( bounds.Center(), 0.f );
+		data[ i ].BoundsExtent = glm::vec4( bounds.Size() * .5f, 0.f );
+		data[ i ].DrawGroup = objects[ i ].Type;
+		data[ i ].Flags = ( objects[ i ].IsStatic() ? OBJECT_FLAG_STATIC : 0 ) | ( objects[ i ].CastsShadow() ? OBJECT_FLAG_CASTS_SHADOW : 0 );
+	}
+
+	if ( inRun )
+		uploadRange( runStart, runEnd + 1 );
+
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+}
+
+void ObjectBuffer::uploadRange( unsigned int first, unsigned int end )
+{
+	glBufferSubData( GL_SHADER_STORAGE_BUFFER, first * sizeof( ObjectData ), ( end - first ) * sizeof( ObjectData ), data.data() + first );
+}
+
+unsigned int ObjectBuffer::GetObjectCount() const
+{
+	return ( unsigned int )data.size();
+}
+
+void ObjectBuffer::BindForReading() const
+{
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, OBJECTS_SSBO_BINDING, SSBO );
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Shader.hpp"
+#include "SceneObject.hpp"
+#include "Vertex.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Shader storage binding point of the Objects block
+const unsigned int OBJECTS_SSBO_BINDING = 0;
+// Vertex attribute location of the per instance object index
+const unsigned int OBJECT_INDEX_ATTRIBUTE = 3;
+
+// Bits of the per object flags, for filtering objects on the GPU
+const unsigned int OBJECT_FLAG_STATIC = 1;
+const unsigned int OBJECT_FLAG_CASTS_SHADOW = 2;
+
+// Where ObjectBuffer::AddInstances() stored the object indices of a batch. Count can be less than requested,
+// the draw has to use it and not the size of its own list
+struct InstanceRange
+{
+	unsigned int BaseInstance;
+	unsigned int Count;
+};
+
+// Per object data of the whole scene in one shader storage buffer, indexed like the scene object vector.
+// Uploaded once per frame and read by every pass, so an object costs the same no matter how often it is drawn.
+// Draws are instanced: the object indices of a batch are appended to an instance stream, the shaders read
+// them through a per instance attribute (a_objectIndex) and the base instance of glDraw*InstancedBaseInstance
+// points at the start of the batch. Any number of objects with the same geometry is a single draw
+class ObjectBuffer
+{
+public:
+	// render data
+	unsigned int SSBO;
+	unsigned int InstanceVBO;
+
+	unsigned int Capacity;
+	// object indices the instance stream holds before it starts over in fresh storage
+	unsigned int InstanceCapacity;
+
+	// with VERTEX_FORMAT_COMPACT the model matrices also decode the positions, see SetPositionBounds()
+	ObjectBuffer( unsigned int capacity, unsigned int instanceCapacity, VertexFormat vertexFormat = VERTEX_FORMAT_FLOAT );
+	~ObjectBuffer();
+
+	// connects the Objects block of the shader to its binding point, only has to be done once per program
+	static void BindBlock( const Shader& shader );
+
+	// adds the instance stream to the currently bound VAO
+	void AttachInstanceStream() const;
+
+	// writes the object indices into the instance stream, returns the base instance and the instance count for the draw
+	InstanceRange AddInstances( const std::vector<unsigned int>& objectIndices );
+
+	// the bounds the geometry of a draw group was packed with (GeometryRange::PositionBounds), all geometry of the group has to share them.
+	// Only used with VERTEX_FORMAT_COMPACT, has to be set before the first Update() with objects of the group
+	void SetPositionBounds( unsigned int drawGroup, const AABB& bounds );
+
+	// recalculates the normal matrices of dirty objects and uploads the runs of them, has to run before the dirty flags get cleared.
+	// Everything is uploaded when the object count changed.
+	// The draw group of an object is its SceneObjectType (see GpuCuller)
+	void Update( const std::vector<SceneObject>& objects );
+
+	unsigned int GetObjectCount() const;
+
+	void BindForReading() const;
+
+private:
+	// clean objects between two dirty ones that are uploaded along instead of starting another glBufferSubData
+	static const unsigned int MAX_UPLOAD_GAP = 8;
+
+	// std430 layout, has to match the Objects block in the shaders. The normal matrix is padded to a mat4,
+	// a mat3 would get a vec4 stride per column anyway
+	struct ObjectData
+	{
+		glm::mat4 Model;
+		glm::mat4 NormalMat;
+		// world space bounds, w unused
+		glm::vec4 BoundsCenter;
+		glm::vec4 BoundsExtent;
+		unsigned int DrawGroup;
+		unsigned int Flags;
+		unsigned int Padding[ 2 ];
+	};
+
+	std::vector<ObjectData> data;
+	VertexFormat vertexFormat;
+	// by draw group
+	std::vector<AABB> positionBounds;
+
+	// [first, end) of data into the bound SSBO
+	void uploadRange( unsigned int first, unsigned int end );
+
+	// next free entry of the instance stream, everything before it may still be read by queued draws
+	unsigned int instanceOffset;
+};
\ No newline at end of file
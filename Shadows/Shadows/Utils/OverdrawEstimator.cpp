@@ -0,0 +1,76 @@
+#include "OverdrawEstimator.hpp"
+
+#include <GL/glew.h>
+
+OverdrawEstimator::OverdrawEstimator( unsigned int pixelCount, float enableAbove, float disableBelow )
+	: Overdraw( 0.f ), PrepassEnabled( false ), frame( 0 ), active( false ),
+	pixelCount( pixelCount ), enableAbove( enableAbove ), disableBelow( disableBelow )
+{
+	for ( unsigned int i = 0; i < OVERDRAW_QUERY_LATENCY; i++ ) {
+		glGenQueries( MAX_OVERDRAW_QUERIES, queries[ i ] );
+		used[ i ] = 0;
+	}
+}
+
+OverdrawEstimator::~OverdrawEstimator()
+{
+	for ( unsigned int i = 0; i < OVERDRAW_QUERY_LATENCY; i++ )
+		glDeleteQueries( MAX_OVERDRAW_QUERIES, queries[ i ] );
+}
+
+void OverdrawEstimator::SetPixelCount( unsigned int pixelCount )
+{
+	this->pixelCount = pixelCount;
+}
+
+void OverdrawEstimator::Begin()
+{
+	// the remaining draws of the frame just aren't counted, the estimate is an average anyway
+	if ( used[ frame ] == MAX_OVERDRAW_QUERIES )
+		return;
+
+	glBeginQuery( GL_SAMPLES_PASSED, queries[ frame ][ used[ frame ] ] );
+	active = true;
+}
+
+void OverdrawEstimator::End()
+{
+	if ( !active )
+		return;
+
+	glEndQuery( GL_SAMPLES_PASSED );
+	used[ frame ]++;
+	active = false;
+}
+
+void OverdrawEstimator::EndFrame()
+{
+	// the oldest frame of the ring gets reused next
+	frame = ( frame + 1 ) % OVERDRAW_QUERY_LATENCY;
+
+	unsigned int count = used[ frame ];
+	used[ frame ] = 0;
+	if ( count == 0 )
+		return;
+
+	// the queries finish in order, so the last one being done means all of them are
+	GLuint available = 0;
+	glGetQueryObjectuiv( queries[ frame ][ count - 1 ], GL_QUERY_RESULT_AVAILABLE, &available );
+	if ( !available )
+		return;
+
+	unsigned long long samples = 0;
+	for ( unsigned int i = 0; i < count; i++ ) {
+		GLuint querySamples;
+		glGetQueryObjectuiv( queries[ frame ][ i ], GL_QUERY_RESULT, &querySamples );
+		samples += querySamples;
+	}
+
+	float frameOverdraw = samples / ( float )pixelCount;
+	Overdraw = Overdraw == 0.f ? frameOverdraw : Overdraw * 0.9f + frameOverdraw * 0.1f;
+
+	if ( !PrepassEnabled && Overdraw > enableAbove )
+		PrepassEnabled = true;
+	else if ( PrepassEnabled && Overdraw < disableBelow )
+		PrepassEnabled = false;
+}
\ No newline at end of file
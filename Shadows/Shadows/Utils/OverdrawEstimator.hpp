@@ -0,0 +1,42 @@
+#pragma once
+
+// Frames a query result may take before it is read, so reading never waits for the GPU
+const unsigned int OVERDRAW_QUERY_LATENCY = 3;
+// Begin()/End() pairs per frame
+const unsigned int MAX_OVERDRAW_QUERIES = 4;
+
+// Measures the overdraw of the camera view and decides whether a depth pre-pass pays for itself. Occlusion queries count
+// the samples that pass the depth test in the first pass that writes the camera depth (the shading pass, or the pre-pass
+// while it is on), samples per screen pixel is the overdraw. The pre-pass turns on above enableAbove and off below
+// disableBelow, the gap keeps it from flipping every frame around a single threshold
+class OverdrawEstimator
+{
+public:
+	// smoothed over the last frames, 0 until the first results are in
+	float Overdraw;
+	bool PrepassEnabled;
+
+	OverdrawEstimator( unsigned int pixelCount, float enableAbove, float disableBelow );
+	~OverdrawEstimator();
+
+	// counts the samples of the draws in between
+	void Begin();
+	void End();
+
+	// the pixels of the camera view, e.g. after the window got resized
+	void SetPixelCount( unsigned int pixelCount );
+
+	// reads the results of the oldest frame if the GPU is done with them, updates PrepassEnabled and starts the next frame
+	void EndFrame();
+
+private:
+	unsigned int queries[ OVERDRAW_QUERY_LATENCY ][ MAX_OVERDRAW_QUERIES ];
+	// queries issued in every frame of the ring
+	unsigned int used[ OVERDRAW_QUERY_LATENCY ];
+	unsigned int frame;
+	bool active;
+
+	unsigned int pixelCount;
+	float enableAbove;
+	float disableBelow;
+};
\ No newline at end of file
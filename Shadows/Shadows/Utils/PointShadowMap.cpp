@@ -0,0 +1,78 @@
+#include "PointShadowMap.hpp"
+#include "RenderState.hpp"
+
+#include <GL/glew.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <string>
+
+// hashed once, set every frame
+const UniformKey UNIFORM_POINT_SHADOW_MAP( "u_PointShadowMap" );
+
+PointShadowMap::PointShadowMap( unsigned int resolution, float nearPlane, float farPlane )
+	: FBO( 0 ), DepthCubeMap( 0 ), Resolution( resolution ), NearPlane( nearPlane ), FarPlane( farPlane ), LightPos( 0.f )
+{
+	glGenTextures( 1, &DepthCubeMap );
+	RenderState::BindTexture( 0, GL_TEXTURE_CUBE_MAP, DepthCubeMap );
+	for ( unsigned int i = 0; i < 6; i++ ) {
+		glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT32F, Resolution, Resolution,
+			0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr );
+	}
+	// hardware PCF, same as the cascades
+	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE );
+	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL );
+	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE );
+
+	glGenFramebuffers( 1, &FBO );
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, FBO );
+	// attaching the whole cube map makes the framebuffer layered, gl_Layer picks the face
+	glFramebufferTexture( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, DepthCubeMap, 0 );
+	glDrawBuffer( GL_NONE );
+	glReadBuffer( GL_NONE );
+	if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE ) {
+		std::cout << "ERROR::FRAMEBUFFER:: Point shadow map framebuffer is not complete!\n";
+	}
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+	Update( LightPos );
+}
+
+PointShadowMap::~PointShadowMap()
+{
+	glDeleteFramebuffers( 1, &FBO );
+	glDeleteTextures( 1, &DepthCubeMap );
+	RenderState::Invalidate();
+}
+
+void PointShadowMap::Update( glm::vec3 lightPos )
+{
+	LightPos = lightPos;
+
+	glm::mat4 projection = glm::perspective( glm::radians( 90.f ), 1.f, NearPlane, FarPlane );
+
+	// the cube map faces use a left handed convention, hence the flipped up vectors
+	FaceMatrices[ 0 ] = projection * glm::lookAt( lightPos, lightPos + glm::vec3( 1.f, 0.f, 0.f ), glm::vec3( 0.f, -1.f, 0.f ) );
+	FaceMatrices[ 1 ] = projection * glm::lookAt( lightPos, lightPos + glm::vec3( -1.f, 0.f, 0.f ), glm::vec3( 0.f, -1.f, 0.f ) );
+	FaceMatrices[ 2 ] = projection * glm::lookAt( lightPos, lightPos + glm::vec3( 0.f, 1.f, 0.f ), glm::vec3( 0.f, 0.f, 1.f ) );
+	FaceMatrices[ 3 ] = projection * glm::lookAt( lightPos, lightPos + glm::vec3( 0.f, -1.f, 0.f ), glm::vec3( 0.f, 0.f, -1.f ) );
+	FaceMatrices[ 4 ] = projection * glm::lookAt( lightPos, lightPos + glm::vec3( 0.f, 0.f, 1.f ), glm::vec3( 0.f, -1.f, 0.f ) );
+	FaceMatrices[ 5 ] = projection * glm::lookAt( lightPos, lightPos + glm::vec3( 0.f, 0.f, -1.f ), glm::vec3( 0.f, -1.f, 0.f ) );
+}
+
+void PointShadowMap::BindForWriting() const
+{
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, FBO );
+	RenderState::Viewport( 0, 0, Resolution, Resolution );
+}
+
+void PointShadowMap::BindForReading( Shader& shader, unsigned int textureUnit ) const
+{
+	RenderState::BindTexture( textureUnit, GL_TEXTURE_CUBE_MAP, DepthCubeMap );
+
+	shader.setSampler( UNIFORM_POINT_SHADOW_MAP, textureUnit );
+}
\ No newline at end of file
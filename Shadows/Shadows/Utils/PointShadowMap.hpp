@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Shader.hpp"
+
+#include <glm/glm.hpp>
+
+// Omnidirectional shadow map of a point light stored in a depth GL_TEXTURE_CUBE_MAP. All six faces are
+// rendered in a single pass: the whole cube map is attached as a layered target and pointDepthShader.gms
+// selects the face per triangle with gl_Layer. Sampled with a samplerCubeShadow in the shading shaders.
+class PointShadowMap
+{
+public:
+	// render data
+	unsigned int FBO;
+	unsigned int DepthCubeMap;
+
+	unsigned int Resolution;
+	float NearPlane;
+	float FarPlane;
+
+	glm::vec3 LightPos;
+	// projection * view of the faces in the GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order, recalculated by Update().
+	// pointDepthShader reads them and FarPlane from the LightConstants block (see FrameUniforms::SetPointShadow())
+	glm::mat4 FaceMatrices[ 6 ];
+
+	PointShadowMap( unsigned int resolution, float nearPlane, float farPlane );
+	~PointShadowMap();
+
+	void Update( glm::vec3 lightPos );
+
+	// binds the FBO with the whole cube map attached and sets the viewport to the face resolution
+	void BindForWriting() const;
+
+	void BindForReading( Shader& shader, unsigned int textureUnit ) const;
+};
\ No newline at end of file
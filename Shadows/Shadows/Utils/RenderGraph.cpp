@@ -0,0 +1,353 @@
+#include "RenderGraph.hpp"
+#include "RenderState.hpp"
+
+#include <iostream>
+
+const RenderResource RenderGraph::NO_RESOURCE;
+
+RenderTextureDesc::RenderTextureDesc( unsigned int width, unsigned int height, GLenum internalFormat )
+	: Width( width ), Height( height ), InternalFormat( internalFormat )
+{
+}
+
+RenderGraph::RenderGraph()
+	: PassCount( 0 ), CulledPassCount( 0 ), TransientBytes( 0 ), AllocatedBytes( 0 )
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+	for ( unsigned int i = 0; i < pool.size(); i++ ) {
+		glDeleteFramebuffers( 1, &pool[ i ].FBO );
+		glDeleteTextures( 1, &pool[ i ].ID );
+	}
+	RenderState::Invalidate();
+}
+
+void RenderGraph::Reset()
+{
+	textures.clear();
+	versions.clear();
+	passes.clear();
+	outputs.clear();
+}
+
+RenderResource RenderGraph::Import( const char* name, unsigned int texture )
+{
+	return addTexture( name, TEXTURE_IMPORTED, RenderTextureDesc( 0, 0, GL_NONE ), texture );
+}
+
+RenderResource RenderGraph::ImportBackbuffer( unsigned int width, unsigned int height )
+{
+	return ImportFramebuffer( "Backbuffer", 0, width, height );
+}
+
+RenderResource RenderGraph::ImportFramebuffer( const char* name, unsigned int framebuffer, unsigned int width, unsigned int height )
+{
+	return addTexture( name, TEXTURE_FRAMEBUFFER, RenderTextureDesc( width, height, GL_NONE ), framebuffer );
+}
+
+RenderResource RenderGraph::CreateTexture( const char* name, const RenderTextureDesc& desc )
+{
+	return addTexture( name, TEXTURE_TRANSIENT, desc, 0 );
+}
+
+unsigned int RenderGraph::AddPass( const char* name, std::function<void()> execute )
+{
+	Pass pass;
+	pass.Name = name;
+	pass.Execute = execute;
+	pass.Target = NO_RESOURCE;
+	pass.HasViewport = false;
+	pass.Live = false;
+	passes.push_back( pass );
+
+	return ( unsigned int )passes.size() - 1;
+}
+
+void RenderGraph::Read( unsigned int pass, RenderResource resource )
+{
+	passes[ pass ].Reads.push_back( resource );
+}
+
+RenderResource RenderGraph::Write( unsigned int pass, RenderResource resource )
+{
+	// the parts the pass doesn't touch keep the content of the old version
+	passes[ pass ].Reads.push_back( resource );
+
+	Version version;
+	version.Texture = versions[ resource ].Texture;
+	version.Writer = pass;
+	version.Needed = false;
+	versions.push_back( version );
+
+	RenderResource written = ( RenderResource )versions.size() - 1;
+	passes[ pass ].Writes.push_back( written );
+
+	return written;
+}
+
+RenderResource RenderGraph::SetTarget( unsigned int pass, RenderResource resource )
+{
+	if ( textures[ versions[ resource ].Texture ].Kind == TEXTURE_IMPORTED ) {
+		std::cout << "ERROR::RENDER_GRAPH::IMPORTED_TARGET " << textures[ versions[ resource ].Texture ].Name
+			<< " has to be bound by the pass " << passes[ pass ].Name << std::endl;
+		return Write( pass, resource );
+	}
+
+	RenderResource written = Write( pass, resource );
+	passes[ pass ].Target = written;
+
+	return written;
+}
+
+void RenderGraph::SetViewport( unsigned int pass, int x, int y, int width, int height )
+{
+	Pass& target = passes[ pass ];
+	target.Viewport[ 0 ] = x;
+	target.Viewport[ 1 ] = y;
+	target.Viewport[ 2 ] = width;
+	target.Viewport[ 3 ] = height;
+	target.HasViewport = true;
+}
+
+void RenderGraph::SetOutput( RenderResource resource )
+{
+	outputs.push_back( resource );
+}
+
+void RenderGraph::Execute()
+{
+	cullPasses();
+	calculateLifetimes();
+
+	for ( unsigned int i = 0; i < pool.size(); i++ )
+		pool[ i ].InUse = false;
+
+	PassCount = 0;
+	CulledPassCount = 0;
+	TransientBytes = 0;
+	for ( unsigned int i = 0; i < textures.size(); i++ ) {
+		if ( textures[ i ].Kind == TEXTURE_TRANSIENT && textures[ i ].FirstPass >= 0 )
+			TransientBytes += getTextureBytes( textures[ i ].Desc );
+	}
+
+	for ( int p = 0; p < ( int )passes.size(); p++ ) {
+		Pass& pass = passes[ p ];
+		if ( !pass.Live ) {
+			CulledPassCount++;
+			continue;
+		}
+		PassCount++;
+
+		for ( unsigned int i = 0; i < textures.size(); i++ ) {
+			if ( textures[ i ].Kind == TEXTURE_TRANSIENT && textures[ i ].FirstPass == p )
+				acquire( textures[ i ] );
+		}
+
+		bindTarget( pass );
+		pass.Execute();
+
+		for ( unsigned int i = 0; i < pass.Writes.size(); i++ )
+			textures[ versions[ pass.Writes[ i ] ].Texture ].Written = true;
+
+		// the storage is free for the textures that start later
+		for ( unsigned int i = 0; i < textures.size(); i++ ) {
+			if ( textures[ i ].Kind == TEXTURE_TRANSIENT && textures[ i ].LastPass == p )
+				release( textures[ i ] );
+		}
+	}
+
+	AllocatedBytes = 0;
+	for ( unsigned int i = 0; i < pool.size(); i++ )
+		AllocatedBytes += getTextureBytes( pool[ i ].Desc );
+}
+
+unsigned int RenderGraph::GetTexture( RenderResource resource ) const
+{
+	return textures[ versions[ resource ].Texture ].ID;
+}
+
+RenderResource RenderGraph::addTexture( const std::string& name, TextureKind kind, const RenderTextureDesc& desc, unsigned int id )
+{
+	GraphTexture texture = { name, kind, desc, id, -1, -1, kind == TEXTURE_IMPORTED };
+	textures.push_back( texture );
+
+	Version version;
+	version.Texture = ( unsigned int )textures.size() - 1;
+	version.Writer = -1;
+	version.Needed = false;
+	versions.push_back( version );
+
+	return ( RenderResource )versions.size() - 1;
+}
+
+void RenderGraph::cullPasses()
+{
+	for ( unsigned int i = 0; i < outputs.size(); i++ )
+		versions[ outputs[ i ] ].Needed = true;
+
+	// readers come after the writers, so walking backwards sees every use of a version before its writer
+	for ( int p = ( int )passes.size() - 1; p >= 0; p-- ) {
+		Pass& pass = passes[ p ];
+
+		// without any declared writes the pass can't be tracked, it is always kept
+		pass.Live = pass.Writes.empty();
+		for ( unsigned int i = 0; i < pass.Writes.size() && !pass.Live; i++ )
+			pass.Live = versions[ pass.Writes[ i ] ].Needed;
+
+		if ( !pass.Live )
+			continue;
+
+		for ( unsigned int i = 0; i < pass.Reads.size(); i++ )
+			versions[ pass.Reads[ i ] ].Needed = true;
+	}
+}
+
+void RenderGraph::calculateLifetimes()
+{
+	for ( int p = 0; p < ( int )passes.size(); p++ ) {
+		if ( !passes[ p ].Live )
+			continue;
+
+		for ( unsigned int r = 0; r < passes[ p ].Reads.size() + passes[ p ].Writes.size(); r++ ) {
+			RenderResource resource = r < passes[ p ].Reads.size() ? passes[ p ].Reads[ r ] : passes[ p ].Writes[ r - passes[ p ].Reads.size() ];
+			GraphTexture& texture = textures[ versions[ resource ].Texture ];
+			if ( texture.FirstPass < 0 )
+				texture.FirstPass = p;
+			texture.LastPass = p;
+		}
+	}
+}
+
+void RenderGraph::acquire( GraphTexture& texture )
+{
+	for ( unsigned int i = 0; i < pool.size(); i++ ) {
+		const RenderTextureDesc& desc = pool[ i ].Desc;
+		if ( pool[ i ].InUse || desc.Width != texture.Desc.Width || desc.Height != texture.Desc.Height || desc.InternalFormat != texture.Desc.InternalFormat )
+			continue;
+
+		pool[ i ].InUse = true;
+		texture.ID = pool[ i ].ID;
+		return;
+	}
+
+	PooledTexture pooled = { texture.Desc, 0, 0, true };
+
+	glGenTextures( 1, &pooled.ID );
+	RenderState::BindTexture( 0, GL_TEXTURE_2D, pooled.ID );
+	glTexStorage2D( GL_TEXTURE_2D, 1, texture.Desc.InternalFormat, texture.Desc.Width, texture.Desc.Height );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+	glGenFramebuffers( 1, &pooled.FBO );
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, pooled.FBO );
+	if ( isDepthFormat( texture.Desc.InternalFormat ) ) {
+		glFramebufferTexture2D( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, pooled.ID, 0 );
+		glDrawBuffer( GL_NONE );
+		glReadBuffer( GL_NONE );
+	}
+	else
+		glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pooled.ID, 0 );
+	if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE ) {
+		std::cout << "ERROR::FRAMEBUFFER:: Render graph framebuffer of " << texture.Name << " is not complete!\n";
+	}
+
+	pool.push_back( pooled );
+	texture.ID = pooled.ID;
+}
+
+void RenderGraph::release( const GraphTexture& texture )
+{
+	for ( unsigned int i = 0; i < pool.size(); i++ ) {
+		if ( pool[ i ].ID == texture.ID )
+			pool[ i ].InUse = false;
+	}
+}
+
+void RenderGraph::bindTarget( Pass& pass )
+{
+	if ( pass.Target == NO_RESOURCE )
+		return;
+
+	GraphTexture& texture = textures[ versions[ pass.Target ].Texture ];
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, texture.Kind == TEXTURE_FRAMEBUFFER ? texture.ID : getFramebuffer( texture.ID ) );
+
+	if ( pass.HasViewport )
+		RenderState::Viewport( pass.Viewport[ 0 ], pass.Viewport[ 1 ], pass.Viewport[ 2 ], pass.Viewport[ 3 ] );
+	else
+		RenderState::Viewport( 0, 0, texture.Desc.Width, texture.Desc.Height );
+
+	// the content of an aliased texture is whatever its last user left, a framebuffer holds the last frame
+	if ( texture.Written )
+		return;
+
+	GLbitfield mask = GL_COLOR_BUFFER_BIT;
+	if ( texture.Kind == TEXTURE_FRAMEBUFFER )
+		mask = GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT;
+	else if ( isDepthFormat( texture.Desc.InternalFormat ) )
+		mask = GL_DEPTH_BUFFER_BIT;
+
+	// glClear respects the write masks and the scissor
+	if ( mask & GL_COLOR_BUFFER_BIT )
+		RenderState::ColorMask( true );
+	if ( mask & GL_DEPTH_BUFFER_BIT )
+		RenderState::DepthMask( true );
+	RenderState::SetEnabled( GL_SCISSOR_TEST, false );
+	glClear( mask );
+}
+
+unsigned int RenderGraph::getFramebuffer( unsigned int texture ) const
+{
+	for ( unsigned int i = 0; i < pool.size(); i++ ) {
+		if ( pool[ i ].ID == texture )
+			return pool[ i ].FBO;
+	}
+
+	return 0;
+}
+
+bool RenderGraph::isDepthFormat( GLenum internalFormat )
+{
+	switch ( internalFormat ) {
+	case GL_DEPTH_COMPONENT16:
+	case GL_DEPTH_COMPONENT24:
+	case GL_DEPTH_COMPONENT32:
+	case GL_DEPTH_COMPONENT32F:
+	case GL_DEPTH24_STENCIL8:
+	case GL_DEPTH32F_STENCIL8:
+		return true;
+	default:
+		return false;
+	}
+}
+
+size_t RenderGraph::getTextureBytes( const RenderTextureDesc& desc )
+{
+	size_t texelBytes;
+	switch ( desc.InternalFormat ) {
+	case GL_RGBA32F:
+		texelBytes = 16;
+		break;
+	case GL_RG32F:
+	case GL_RGBA16F:
+	case GL_DEPTH32F_STENCIL8:
+		texelBytes = 8;
+		break;
+	case GL_R8:
+		texelBytes = 1;
+		break;
+	case GL_RG8:
+	case GL_R16F:
+	case GL_DEPTH_COMPONENT16:
+		texelBytes = 2;
+		break;
+	default:
+		texelBytes = 4;
+		break;
+	}
+
+	return texelBytes * desc.Width * desc.Height;
+}
\ No newline at end of file
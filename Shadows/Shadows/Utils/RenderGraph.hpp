@@ -0,0 +1,142 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Size and format of a texture the render graph allocates
+struct RenderTextureDesc
+{
+	unsigned int Width;
+	unsigned int Height;
+	GLenum InternalFormat;
+
+	RenderTextureDesc( unsigned int width, unsigned int height, GLenum internalFormat );
+};
+
+// One version of a resource of the graph, every write creates a new one
+typedef unsigned int RenderResource;
+
+// Frame graph: passes declare the resources they read and write instead of binding and clearing by hand. On Execute() the graph
+// - culls the passes whose results don't lead to an output (SetOutput()),
+// - allocates the transient textures for their lifetime only, so textures with the same description share storage
+//   as long as their lifetimes don't overlap,
+// - binds the render target and viewport of every pass and clears a target only when its content is undefined
+//   (the first write of the frame to a framebuffer or a transient texture).
+// Passes run in the order they were added. The graph is set up again every frame, the allocated textures are kept
+class RenderGraph
+{
+public:
+	static const RenderResource NO_RESOURCE = 0xFFFFFFFF;
+
+	// of the last Execute()
+	unsigned int PassCount;
+	unsigned int CulledPassCount;
+	// what the transient textures would take each on their own, and what the aliased storage actually takes
+	size_t TransientBytes;
+	size_t AllocatedBytes;
+
+	RenderGraph();
+	~RenderGraph();
+
+	// forgets the passes and resources of the last frame
+	void Reset();
+
+	// a texture that outlives the frame, e.g. a shadow map. Keeps its content, passes that render into it bind it themselves
+	RenderResource Import( const char* name, unsigned int texture );
+	// the default framebuffer with its depth buffer
+	RenderResource ImportBackbuffer( unsigned int width, unsigned int height );
+	// a framebuffer with color and depth that outlives the frame, bound and cleared by the graph like the backbuffer
+	RenderResource ImportFramebuffer( const char* name, unsigned int framebuffer, unsigned int width, unsigned int height );
+	// only lives from the first to the last pass that uses it
+	RenderResource CreateTexture( const char* name, const RenderTextureDesc& desc );
+
+	unsigned int AddPass( const char* name, std::function<void()> execute );
+	void Read( unsigned int pass, RenderResource resource );
+	// the pass modifies the resource, the returned version is what later passes have to read
+	RenderResource Write( unsigned int pass, RenderResource resource );
+	// like Write(), and the graph binds the framebuffer or the transient texture as render target of the pass
+	RenderResource SetTarget( unsigned int pass, RenderResource resource );
+	// only part of the target, by default the viewport covers all of it
+	void SetViewport( unsigned int pass, int x, int y, int width, int height );
+
+	// keeps the passes that lead to this version, can be called for more than one resource
+	void SetOutput( RenderResource resource );
+
+	void Execute();
+
+	// the texture behind a resource, transient ones only exist while their passes run
+	unsigned int GetTexture( RenderResource resource ) const;
+
+private:
+	enum TextureKind
+	{
+		TEXTURE_IMPORTED,
+		// the backbuffer or an imported framebuffer, ID is the framebuffer
+		TEXTURE_FRAMEBUFFER,
+		TEXTURE_TRANSIENT,
+	};
+
+	struct GraphTexture
+	{
+		std::string Name;
+		TextureKind Kind;
+		RenderTextureDesc Desc;
+		unsigned int ID;
+		// live passes that use it, set by Execute()
+		int FirstPass;
+		int LastPass;
+		// the content is defined once a pass wrote it
+		bool Written;
+	};
+
+	struct Version
+	{
+		unsigned int Texture;
+		// pass that created the version, -1 for the initial one
+		int Writer;
+		bool Needed;
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		std::function<void()> Execute;
+		std::vector<RenderResource> Reads;
+		std::vector<RenderResource> Writes;
+		RenderResource Target;
+		int Viewport[ 4 ];
+		bool HasViewport;
+		bool Live;
+	};
+
+	// allocated storage of the transient textures, kept across frames
+	struct PooledTexture
+	{
+		RenderTextureDesc Desc;
+		unsigned int ID;
+		unsigned int FBO;
+		bool InUse;
+	};
+
+	std::vector<GraphTexture> textures;
+	std::vector<Version> versions;
+	std::vector<Pass> passes;
+	std::vector<RenderResource> outputs;
+	std::vector<PooledTexture> pool;
+
+	RenderResource addTexture( const std::string& name, TextureKind kind, const RenderTextureDesc& desc, unsigned int id );
+	void cullPasses();
+	void calculateLifetimes();
+	// takes a free pooled texture with the same description, or creates one
+	void acquire( GraphTexture& texture );
+	void release( const GraphTexture& texture );
+	void bindTarget( Pass& pass );
+	unsigned int getFramebuffer( unsigned int texture ) const;
+
+	static bool isDepthFormat( GLenum internalFormat );
+	static size_t getTextureBytes( const RenderTextureDesc& desc );
+};
\ No newline at end of file
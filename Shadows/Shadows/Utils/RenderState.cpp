@@ -0,0 +1,253 @@
+#include "RenderState.hpp"
+
+unsigned int RenderState::IssuedCount = 0;
+unsigned int RenderState::ElidedCount = 0;
+
+unsigned int RenderState::program = RenderState::UNKNOWN;
+unsigned int RenderState::vao = RenderState::UNKNOWN;
+unsigned int RenderState::readFramebuffer = RenderState::UNKNOWN;
+unsigned int RenderState::drawFramebuffer = RenderState::UNKNOWN;
+unsigned int RenderState::activeUnit = RenderState::UNKNOWN;
+unsigned int RenderState::textures[ MAX_TRACKED_TEXTURE_UNITS ][ TRACKED_TARGET_COUNT ];
+unsigned int RenderState::samplers[ MAX_TRACKED_TEXTURE_UNITS ];
+int RenderState::viewport[ 4 ] = { -1, -1, -1, -1 };
+int RenderState::scissor[ 4 ] = { -1, -1, -1, -1 };
+unsigned int RenderState::capabilities[ TRACKED_CAPABILITY_COUNT ];
+unsigned int RenderState::cullFace = RenderState::UNKNOWN;
+unsigned int RenderState::depthFunc = RenderState::UNKNOWN;
+unsigned int RenderState::depthMask = RenderState::UNKNOWN;
+unsigned int RenderState::colorMask = RenderState::UNKNOWN;
+unsigned int RenderState::blendSource = RenderState::UNKNOWN;
+unsigned int RenderState::blendDestination = RenderState::UNKNOWN;
+
+void RenderState::UseProgram( unsigned int program )
+{
+	if ( changes( RenderState::program, program ) )
+		glUseProgram( program );
+}
+
+void RenderState::BindVertexArray( unsigned int vao )
+{
+	if ( changes( RenderState::vao, vao ) )
+		glBindVertexArray( vao );
+}
+
+void RenderState::BindFramebuffer( GLenum target, unsigned int fbo )
+{
+	switch ( target ) {
+	case GL_READ_FRAMEBUFFER:
+		if ( changes( readFramebuffer, fbo ) )
+			glBindFramebuffer( GL_READ_FRAMEBUFFER, fbo );
+		break;
+	case GL_DRAW_FRAMEBUFFER:
+		if ( changes( drawFramebuffer, fbo ) )
+			glBindFramebuffer( GL_DRAW_FRAMEBUFFER, fbo );
+		break;
+	default:
+		if ( readFramebuffer == fbo && drawFramebuffer == fbo ) {
+			ElidedCount++;
+			break;
+		}
+		IssuedCount++;
+		readFramebuffer = fbo;
+		drawFramebuffer = fbo;
+		glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+		break;
+	}
+}
+
+void RenderState::BindTexture( unsigned int unit, GLenum target, unsigned int texture )
+{
+	int tracked = trackedTarget( target );
+	if ( unit >= MAX_TRACKED_TEXTURE_UNITS || tracked < 0 ) {
+		IssuedCount++;
+		activateUnit( unit );
+		glBindTexture( target, texture );
+		return;
+	}
+
+	if ( changes( textures[ unit ][ tracked ], texture ) ) {
+		activateUnit( unit );
+		glBindTexture( target, texture );
+	}
+}
+
+void RenderState::BindSampler( unsigned int unit, unsigned int sampler )
+{
+	if ( unit >= MAX_TRACKED_TEXTURE_UNITS ) {
+		IssuedCount++;
+		glBindSampler( unit, sampler );
+		return;
+	}
+
+	if ( changes( samplers[ unit ], sampler ) )
+		glBindSampler( unit, sampler );
+}
+
+void RenderState::Viewport( int x, int y, int width, int height )
+{
+	if ( changes( viewport, x, y, width, height ) )
+		glViewport( x, y, width, height );
+}
+
+void RenderState::Scissor( int x, int y, int width, int height )
+{
+	if ( changes( scissor, x, y, width, height ) )
+		glScissor( x, y, width, height );
+}
+
+void RenderState::SetEnabled( GLenum capability, bool enabled )
+{
+	int tracked = trackedCapability( capability );
+	if ( tracked >= 0 && !changes( capabilities[ tracked ], enabled ? 1 : 0 ) )
+		return;
+
+	if ( tracked < 0 )
+		IssuedCount++;
+
+	if ( enabled )
+		glEnable( capability );
+	else
+		glDisable( capability );
+}
+
+void RenderState::CullFace( GLenum face )
+{
+	if ( changes( cullFace, face ) )
+		glCullFace( face );
+}
+
+void RenderState::DepthFunc( GLenum func )
+{
+	if ( changes( depthFunc, func ) )
+		glDepthFunc( func );
+}
+
+void RenderState::DepthMask( bool write )
+{
+	if ( changes( depthMask, write ? 1 : 0 ) )
+		glDepthMask( write ? GL_TRUE : GL_FALSE );
+}
+
+void RenderState::ColorMask( bool write )
+{
+	if ( changes( colorMask, write ? 1 : 0 ) )
+		glColorMask( write ? GL_TRUE : GL_FALSE, write ? GL_TRUE : GL_FALSE, write ? GL_TRUE : GL_FALSE, write ? GL_TRUE : GL_FALSE );
+}
+
+void RenderState::BlendFunc( GLenum source, GLenum destination )
+{
+	if ( blendSource == source && blendDestination == destination ) {
+		ElidedCount++;
+		return;
+	}
+
+	IssuedCount++;
+	blendSource = source;
+	blendDestination = destination;
+	glBlendFunc( source, destination );
+}
+
+void RenderState::Invalidate()
+{
+	program = UNKNOWN;
+	vao = UNKNOWN;
+	readFramebuffer = UNKNOWN;
+	drawFramebuffer = UNKNOWN;
+	activeUnit = UNKNOWN;
+
+	for ( unsigned int unit = 0; unit < MAX_TRACKED_TEXTURE_UNITS; unit++ ) {
+		for ( unsigned int target = 0; target < TRACKED_TARGET_COUNT; target++ )
+			textures[ unit ][ target ] = UNKNOWN;
+		samplers[ unit ] = UNKNOWN;
+	}
+
+	for ( unsigned int i = 0; i < 4; i++ ) {
+		viewport[ i ] = -1;
+		scissor[ i ] = -1;
+	}
+
+	for ( unsigned int i = 0; i < TRACKED_CAPABILITY_COUNT; i++ )
+		capabilities[ i ] = UNKNOWN;
+
+	cullFace = UNKNOWN;
+	depthFunc = UNKNOWN;
+	depthMask = UNKNOWN;
+	colorMask = UNKNOWN;
+	blendSource = UNKNOWN;
+	blendDestination = UNKNOWN;
+}
+
+void RenderState::ResetStats()
+{
+	IssuedCount = 0;
+	ElidedCount = 0;
+}
+
+int RenderState::trackedTarget( GLenum target )
+{
+	switch ( target ) {
+	case GL_TEXTURE_2D:
+		return TARGET_2D;
+	case GL_TEXTURE_2D_ARRAY:
+		return TARGET_2D_ARRAY;
+	case GL_TEXTURE_CUBE_MAP:
+		return TARGET_CUBE_MAP;
+	default:
+		return -1;
+	}
+}
+
+int RenderState::trackedCapability( GLenum capability )
+{
+	switch ( capability ) {
+	case GL_DEPTH_TEST:
+		return CAPABILITY_DEPTH_TEST;
+	case GL_CULL_FACE:
+		return CAPABILITY_CULL_FACE;
+	case GL_DEPTH_CLAMP:
+		return CAPABILITY_DEPTH_CLAMP;
+	case GL_SCISSOR_TEST:
+		return CAPABILITY_SCISSOR_TEST;
+	case GL_BLEND:
+		return CAPABILITY_BLEND;
+	default:
+		return -1;
+	}
+}
+
+void RenderState::activateUnit( unsigned int unit )
+{
+	// not counted on its own, it is part of the texture bind
+	if ( activeUnit != unit ) {
+		activeUnit = unit;
+		glActiveTexture( GL_TEXTURE0 + unit );
+	}
+}
+
+bool RenderState::changes( unsigned int& current, unsigned int value )
+{
+	if ( current == value ) {
+		ElidedCount++;
+		return false;
+	}
+
+	IssuedCount++;
+	current = value;
+	return true;
+}
+
+bool RenderState::changes( int current[ 4 ], int x, int y, int width, int height )
+{
+	if ( current[ 0 ] == x && current[ 1 ] == y && current[ 2 ] == width && current[ 3 ] == height ) {
+		ElidedCount++;
+		return false;
+	}
+
+	IssuedCount++;
+	current[ 0 ] = x;
+	current[ 1 ] = y;
+	current[ 2 ] = width;
+	current[ 3 ] = height;
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// Texture units RenderState keeps track of, higher units are passed through without caching
+const unsigned int MAX_TRACKED_TEXTURE_UNITS = 16;
+
+// Shadow copy of the GL state the renderer changes all the time. Every setter compares against the last value it
+// issued and skips the GL call when nothing would change, which saves the driver the validation of redundant calls.
+// Only works as long as all changes of the tracked state go through here: code that changes it directly,
+// or deletes a bound object (GL silently falls back to 0 then), has to call Invalidate() afterwards
+class RenderState
+{
+public:
+	// GL calls since the last ResetStats()
+	static unsigned int IssuedCount;
+	static unsigned int ElidedCount;
+
+	static void UseProgram( unsigned int program );
+	static void BindVertexArray( unsigned int vao );
+	// GL_FRAMEBUFFER binds both the read and the draw framebuffer
+	static void BindFramebuffer( GLenum target, unsigned int fbo );
+
+	// GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY and GL_TEXTURE_CUBE_MAP are tracked per unit, other targets are always issued
+	static void BindTexture( unsigned int unit, GLenum target, unsigned int texture );
+	static void BindSampler( unsigned int unit, unsigned int sampler );
+
+	static void Viewport( int x, int y, int width, int height );
+	static void Scissor( int x, int y, int width, int height );
+
+	// GL_DEPTH_TEST, GL_CULL_FACE, GL_DEPTH_CLAMP, GL_SCISSOR_TEST and GL_BLEND are tracked, other capabilities are always issued
+	static void SetEnabled( GLenum capability, bool enabled );
+	static void CullFace( GLenum face );
+	static void DepthFunc( GLenum func );
+	static void DepthMask( bool write );
+	// all four channels at once
+	static void ColorMask( bool write );
+	static void BlendFunc( GLenum source, GLenum destination );
+
+	// forgets everything, the next call of every setter is issued. Has to be called once the context is created
+	static void Invalidate();
+	static void ResetStats();
+
+private:
+	enum TrackedTarget
+	{
+		TARGET_2D,
+		TARGET_2D_ARRAY,
+		TARGET_CUBE_MAP,
+		TRACKED_TARGET_COUNT,
+	};
+
+	enum TrackedCapability
+	{
+		CAPABILITY_DEPTH_TEST,
+		CAPABILITY_CULL_FACE,
+		CAPABILITY_DEPTH_CLAMP,
+		CAPABILITY_SCISSOR_TEST,
+		CAPABILITY_BLEND,
+		TRACKED_CAPABILITY_COUNT,
+	};
+
+	// UNKNOWN never matches a real value, so the first call after Invalidate() is always issued
+	static const unsigned int UNKNOWN = 0xFFFFFFFF;
+
+	static unsigned int program;
+	static unsigned int vao;
+	static unsigned int readFramebuffer;
+	static unsigned int drawFramebuffer;
+	static unsigned int activeUnit;
+	static unsigned int textures[ MAX_TRACKED_TEXTURE_UNITS ][ TRACKED_TARGET_COUNT ];
+	static unsigned int samplers[ MAX_TRACKED_TEXTURE_UNITS ];
+	static int viewport[ 4 ];
+	static int scissor[ 4 ];
+	static unsigned int capabilities[ TRACKED_CAPABILITY_COUNT ];
+	static unsigned int cullFace;
+	static unsigned int depthFunc;
+	static unsigned int depthMask;
+	static unsigned int colorMask;
+	static unsigned int blendSource;
+	static unsigned int blendDestination;
+
+	static int trackedTarget( GLenum target );
+	static int trackedCapability( GLenum capability );
+	static void activateUnit( unsigned int unit );
+	// counts the call and returns true if it has to be issued, remembering the new value
+	static bool changes( unsigned int& current, unsigned int value );
+	static bool changes( int current[ 4 ], int x, int y, int width, int height );
+};
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "SceneBVH.hpp"
+
+#include <algorithm>
+
+// Objects per leaf, small enough that a leaf isn't mostly culled, big enough to keep the tree shallow
+const unsigned int BVH_LEAF_SIZE = 4;
+
+SceneBVH::SceneBVH()
+	: Stats()
+{
+}
+
+void SceneBVH::Build( const std::vector<SceneObject>& objects )
+{
+	unsigned int count = ( unsigned int )objects.size();
+
+	Nodes.clear();
+	slotObjects.resize( count );
+	objectSlots.resize( count );
+	objectLeaves.assign( count, -1 );
+	centerX.resize( count ); centerY.resize( count ); centerZ.resize( count );
+	extentX.resize( count ); extentY.resize( count ); extentZ.resize( count );
+	slotVisible.resize( count );
+
+	for ( unsigned int i = 0; i < count; i++ )
+		slotObjects[ i ] = i;
+
+	if ( count > 0 )
+		buildNode( 0, count, -1, objects );
+
+	for ( unsigned int slot = 0; slot < count; slot++ ) {
+		objectSlots[ slotObjects[ slot ] ] = slot;
+		setSlotBounds( slot, objects[ slotObjects[ slot ] ].GetWorldBounds() );
+	}
+
+	for ( unsigned int node = 0; node < Nodes.size(); node++ ) {
+		if ( Nodes[ node ].Left >= 0 )
+			continue;
+
+		for ( unsigned int slot = Nodes[ node ].FirstSlot; slot < Nodes[ node ].FirstSlot + Nodes[ node ].SlotCount; slot++ )
+			objectLeaves[ slotObjects[ slot ] ] = node;
+	}
+}
+
+void SceneBVH::Refit( const std::vector<SceneObject>& objects )
+{
+	if ( objects.size() != objectSlots.size() ) {
+		Build( objects );
+		return;
+	}
+
+	std::vector<int> dirtyLeaves;
+	for ( unsigned int i = 0; i < objects.size(); i++ ) {
+		if ( !objects[ i ].IsDirty() )
+			continue;
+
+		setSlotBounds( objectSlots[ i ], objects[ i ].GetWorldBounds() );
+		dirtyLeaves.push_back( objectLeaves[ i ] );
+	}
+
+	for ( int leaf : dirtyLeaves ) {
+		Nodes[ leaf ].Bounds = calculateLeafBounds( Nodes[ leaf ] );
+
+		// the parents only have to be recalculated from their two children, not from all of their objects
+		for ( int node = Nodes[ leaf ].Parent; node >= 0; node = Nodes[ node ].Parent ) {
+			AABB bounds = Nodes[ Nodes[ node ].Left ].Bounds;
+			bounds.Expand( Nodes[ Nodes[ node ].Right ].Bounds );
+			Nodes[ node ].Bounds = bounds;
+		}
+	}
+}
+
+void SceneBVH::Cull( const Frustum& frustum, std::vector<unsigned int>& visibleObjects )
+{
+	visibleObjects.clear();
+	Stats = CullStats();
+
+	if ( !Nodes.empty() )
+		cullNode( 0, frustum, visibleObjects );
+
+	Stats.ObjectsVisible = ( unsigned int )visibleObjects.size();
+	Stats.ObjectsCulled = ( unsigned int )slotObjects.size() - Stats.ObjectsVisible;
+}
+
+int SceneBVH::buildNode( unsigned int firstSlot, unsigned int slotCount, int parent, const std::vector<SceneObject>& objects )
+{
+	int index = ( int )Nodes.size();
+	Nodes.push_back( Node() );
+
+	Node node;
+	node.Parent = parent;
+	node.Left = -1;
+	node.Right = -1;
+	node.FirstSlot = firstSlot;
+	node.SlotCount = slotCount;
+
+	AABB centers;
+	for ( unsigned int slot = firstSlot; slot < firstSlot + slotCount; slot++ ) {
+		const AABB& bounds = objects[ slotObjects[ slot ] ].GetWorldBounds();
+		node.Bounds.Expand( bounds );
+		centers.Expand( bounds.Center() );
+	}
+
+	if ( slotCount > BVH_LEAF_SIZE ) {
+		// median split along the longest axis of the object centers, keeps the tree balanced
+		glm::vec3 size = centers.Size();
+		int axis = size.x > size.y ? ( size.x > size.z ? 0 : 2 ) : ( size.y > size.z ? 1 : 2 );
+
+		unsigned int half = slotCount / 2;
+		std::vector<unsigned int>::iterator first = slotObjects.begin() + firstSlot;
+		std::nth_element( first, first + half, first + slotCount, [ &objects, axis ]( unsigned int a, unsigned int b ) {
+			return objects[ a ].GetWorldBounds().Center()[ axis ] < objects[ b ].GetWorldBounds().Center()[ axis ];
+		} );
+
+		node.Left = buildNode( firstSlot, half, index, objects );
+		node.Right = buildNode( firstSlot + half, slotCount - half, index, objects );
+	}
+
+	Nodes[ index ] = node;
+	return index;
+}
+
+void SceneBVH::setSlotBounds( unsigned int slot, const AABB& bounds )
+{
+	glm::vec3 center = bounds.Center();
+	glm::vec3 extent = bounds.Size() * .5f;
+
+	centerX[ slot ] = center.x; centerY[ slot ] = center.y; centerZ[ slot ] = center.z;
+	extentX[ slot ] = extent.x; extentY[ slot ] = extent.y; extentZ[ slot ] = extent.z;
+}
+
+AABB SceneBVH::calculateLeafBounds( const Node& leaf ) const
+{
+	AABB bounds;
+	for ( unsigned int slot = leaf.FirstSlot; slot < leaf.FirstSlot + leaf.SlotCount; slot++ ) {
+		glm::vec3 center( centerX[ slot ], centerY[ slot ], centerZ[ slot ] );
+		glm::vec3 extent( extentX[ slot ], extentY[ slot ], extentZ[ slot ] );
+		bounds.Expand( AABB( center - extent, center + extent ) );
+	}
+
+	return bounds;
+}
+
+void SceneBVH::cullNode( int index, const Frustum& frustum, std::vector<unsigned int>& visibleObjects )
+{
+	const Node& node = Nodes[ index ];
+	Stats.NodesTested++;
+
+	FrustumTest test = frustum.Classify( node.Bounds );
+	if ( test == FRUSTUM_OUTSIDE )
+		return;
+
+	// everything below is visible as well, no need to test it
+	if ( test == FRUSTUM_INSIDE ) {
+		for ( unsigned int slot = node.FirstSlot; slot < node.FirstSlot + node.SlotCount; slot++ )
+			visibleObjects.push_back( slotObjects[ slot ] );
+		return;
+	}
+
+	if ( node.Left < 0 ) {
+		cullLeaf( node, frustum, visibleObjects );
+		return;
+	}
+
+	cullNode( node.Left, frustum, visibleObjects );
+	cullNode( node.Right, frustum, visibleObjects );
+}
+
+void SceneBVH::cullLeaf( const Node& leaf, const Frustum& frustum, std::vector<unsigned int>& visibleObjects )
+{
+	unsigned int first = leaf.FirstSlot;
+	unsigned int last = leaf.FirstSlot + leaf.SlotCount;
+
+	for ( unsigned int slot = first; slot < last; slot++ )
+		slotVisible[ slot ] = 1;
+
+	// plane by plane over all boxes without branches, the inner loop maps directly to SIMD lanes
+	for ( int i = 0; i < 6; i++ ) {
+		const glm::vec4& plane = frustum.Planes[ i ];
+		float absX = glm::abs( plane.x ), absY = glm::abs( plane.y ), absZ = glm::abs( plane.z );
+
+		for ( unsigned int slot = first; slot < last; slot++ ) {
+			float distance = plane.x * centerX[ slot ] + plane.y * centerY[ slot ] + plane.z * centerZ[ slot ] + plane.w;
+			float radius = absX * extentX[ slot ] + absY * extentY[ slot ] + absZ * extentZ[ slot ];
+			slotVisible[ slot ] &= ( unsigned char )( distance + radius >= 0.f );
+		}
+	}
+
+	Stats.ObjectsTested += leaf.SlotCount;
+	for ( unsigned int slot = first; slot < last; slot++ ) {
+		if ( slotVisible[ slot ] )
+			visibleObjects.push_back( slotObjects[ slot ] );
+	}
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Bounds.hpp"
+#include "SceneObject.hpp"
+
+#include <vector>
+
+// Bounding volume hierarchy over the scene objects for the camera culling, whole groups of objects get rejected
+// (or accepted) with a single frustum test. It is built once and afterwards only refit: moved objects update the
+// bounds of their leaf and of all nodes above it, the tree structure itself stays the same
+class SceneBVH
+{
+public:
+	// all objects of a node are stored contiguously starting at FirstSlot, children cover sub ranges of their parent
+	struct Node
+	{
+		AABB Bounds;
+		int Parent;
+		// -1 for leaves
+		int Left;
+		int Right;
+		unsigned int FirstSlot;
+		unsigned int SlotCount;
+	};
+
+	// results of the last Cull()
+	struct CullStats
+	{
+		unsigned int NodesTested;
+		unsigned int ObjectsTested;
+		unsigned int ObjectsVisible;
+		unsigned int ObjectsCulled;
+	};
+
+	std::vector<Node> Nodes;
+	CullStats Stats;
+
+	SceneBVH();
+
+	void Build( const std::vector<SceneObject>& objects );
+
+	// updates the nodes above every dirty object, so it has to run before the dirty flags get cleared.
+	// Rebuilds the whole tree if objects were added or removed
+	void Refit( const std::vector<SceneObject>& objects );
+
+	// fills visibleObjects with the indices of all objects that intersect the frustum
+	void Cull( const Frustum& frustum, std::vector<unsigned int>& visibleObjects );
+
+private:
+	// slot (position in the tree order) -> object index
+	std::vector<unsigned int> slotObjects;
+	// object index -> slot and leaf
+	std::vector<unsigned int> objectSlots;
+	std::vector<int> objectLeaves;
+
+	// world bounds per slot as center and half extent, stored as separate arrays so the leaf tests
+	// run over plain float streams that the compiler can vectorize
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	// per slot result of the leaf test
+	std::vector<unsigned char> slotVisible;
+
+	int buildNode( unsigned int firstSlot, unsigned int slotCount, int parent, const std::vector<SceneObject>& objects );
+	void setSlotBounds( unsigned int slot, const AABB& bounds );
+	AABB calculateLeafBounds( const Node& leaf ) const;
+	void cullNode( int node, const Frustum& frustum, std::vector<unsigned int>& visibleObjects );
+	void cullLeaf( const Node& leaf, const Frustum& frustum, std::vector<unsigned int>& visibleObjects );
+};
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "SceneFramebuffer.hpp"
+#include "RenderState.hpp"
+
+#include <iostream>
+
+const GLenum SceneFramebuffer::DEPTH_FORMAT;
+
+SceneFramebuffer::SceneFramebuffer( unsigned int width, unsigned int height )
+	: FBO( 0 ), ColorTexture( 0 ), DepthTexture( 0 ), Width( width ), Height( height )
+{
+	create();
+}
+
+SceneFramebuffer::~SceneFramebuffer()
+{
+	destroy();
+}
+
+void SceneFramebuffer::Resize( unsigned int width, unsigned int height )
+{
+	if ( width == Width && height == Height )
+		return;
+
+	destroy();
+	Width = width;
+	Height = height;
+	create();
+}
+
+void SceneFramebuffer::Present() const
+{
+	RenderState::BindFramebuffer( GL_READ_FRAMEBUFFER, FBO );
+	RenderState::BindFramebuffer( GL_DRAW_FRAMEBUFFER, 0 );
+	glBlitFramebuffer( 0, 0, Width, Height, 0, 0, Width, Height, GL_COLOR_BUFFER_BIT, GL_NEAREST );
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, 0 );
+}
+
+void SceneFramebuffer::create()
+{
+	glGenTextures( 1, &ColorTexture );
+	RenderState::BindTexture( 0, GL_TEXTURE_2D, ColorTexture );
+	glTexStorage2D( GL_TEXTURE_2D, 1, GL_RGBA8, Width, Height );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+
+	glGenTextures( 1, &DepthTexture );
+	RenderState::BindTexture( 0, GL_TEXTURE_2D, DepthTexture );
+	glTexStorage2D( GL_TEXTURE_2D, 1, DEPTH_FORMAT, Width, Height );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	RenderState::BindTexture( 0, GL_TEXTURE_2D, 0 );
+
+	glGenFramebuffers( 1, &FBO );
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, FBO );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ColorTexture, 0 );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, DepthTexture, 0 );
+	if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
+		std::cout << "ERROR::SCENE_FRAMEBUFFER::FRAMEBUFFER_NOT_COMPLETE" << std::endl;
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, 0 );
+}
+
+void SceneFramebuffer::destroy()
+{
+	glDeleteFramebuffers( 1, &FBO );
+	glDeleteTextures( 1, &ColorTexture );
+	glDeleteTextures( 1, &DepthTexture );
+	RenderState::Invalidate();
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// Color and depth target of the camera view that the application owns, so the depth format doesn't depend on what the window
+// got from the driver. The Hi-Z pyramid copies its depth with a blit, which only works between identical formats.
+// Present() copies the color to the default framebuffer at the end of the frame
+class SceneFramebuffer
+{
+public:
+	// GL_DEPTH24_STENCIL8, the format HiZPyramid::BuildFromFramebuffer() expects
+	static const GLenum DEPTH_FORMAT = GL_DEPTH24_STENCIL8;
+
+	// render data
+	unsigned int FBO;
+	unsigned int ColorTexture;
+	unsigned int DepthTexture;
+
+	unsigned int Width;
+	unsigned int Height;
+
+	SceneFramebuffer( unsigned int width, unsigned int height );
+	~SceneFramebuffer();
+
+	// reallocates the attachments when the size changed, the content is lost
+	void Resize( unsigned int width, unsigned int height );
+
+	// blits the color to the default framebuffer of the same size
+	void Present() const;
+
+private:
+	void create();
+	void destroy();
+};
\ No newline at end of file
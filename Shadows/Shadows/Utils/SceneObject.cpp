@@ -0,0 +1,78 @@
+#include "SceneObject.hpp"
+
+SceneObject::SceneObject( SceneObjectType type, const AABB& localBounds, const glm::mat4& model, bool castsShadow, bool isStatic )
+	: Type( type ), model( model ), localBounds( localBounds ), castsShadow( castsShadow ), isStatic( isStatic ), wasStatic( isStatic ), dirty( true )
+{
+	worldBounds = localBounds.Transformed( model );
+}
+
+const glm::mat4& SceneObject::GetModel() const
+{
+	return model;
+}
+
+void SceneObject::SetModel( const glm::mat4& model )
+{
+	this->model = model;
+	worldBounds = localBounds.Transformed( model );
+	dirty = true;
+}
+
+bool SceneObject::CastsShadow() const
+{
+	return castsShadow;
+}
+
+void SceneObject::SetCastsShadow( bool castsShadow )
+{
+	if ( this->castsShadow == castsShadow )
+		return;
+
+	this->castsShadow = castsShadow;
+	dirty = true;
+}
+
+bool SceneObject::IsStatic() const
+{
+	return isStatic;
+}
+
+void SceneObject::SetStatic( bool isStatic )
+{
+	if ( this->isStatic == isStatic )
+		return;
+
+	this->isStatic = isStatic;
+	dirty = true;
+}
+
+bool SceneObject::WasStatic() const
+{
+	return wasStatic;
+}
+
+void SceneObject::MarkDirty()
+{
+	dirty = true;
+}
+
+bool SceneObject::IsDirty() const
+{
+	return dirty;
+}
+
+void SceneObject::ClearDirty()
+{
+	dirty = false;
+	wasStatic = isStatic;
+}
+
+const AABB& SceneObject::GetLocalBounds() const
+{
+	return localBounds;
+}
+
+const AABB& SceneObject::GetWorldBounds() const
+{
+	return worldBounds;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Bounds.hpp"
+
+#include <glm/glm.hpp>
+
+// What geometry a scene object is drawn with
+enum SceneObjectType
+{
+	OBJECT_FLOOR,
+	OBJECT_CUBE,
+	OBJECT_BACKPACK,
+};
+
+// A placed instance of some geometry in the scene. Keeps the model matrix and its world space bounds in sync
+// and remembers if anything changed since the last time the renderer looked at it
+class SceneObject
+{
+public:
+	SceneObjectType Type;
+
+	SceneObject( SceneObjectType type, const AABB& localBounds, const glm::mat4& model = glm::mat4( 1.f ),
+		bool castsShadow = true, bool isStatic = true );
+
+	const glm::mat4& GetModel() const;
+	// also marks the object as dirty
+	void SetModel( const glm::mat4& model );
+
+	// the setters mark the object as dirty, the GPU culling reads both from the ObjectBuffer
+	bool CastsShadow() const;
+	void SetCastsShadow( bool castsShadow );
+	// static objects are expected to (almost) never move, their shadows get cached
+	bool IsStatic() const;
+	void SetStatic( bool isStatic );
+	// IsStatic() at the last ClearDirty(), an object that stopped being static still has to leave the shadow cache
+	bool WasStatic() const;
+
+	// dirty tracking, for changes the object can't see itself
+	void MarkDirty();
+	bool IsDirty() const;
+	void ClearDirty();
+
+	const AABB& GetLocalBounds() const;
+	const AABB& GetWorldBounds() const;
+
+private:
+	glm::mat4 model;
+	AABB localBounds;
+	AABB worldBounds;
+	bool castsShadow;
+	bool isStatic;
+	bool wasStatic;
+	bool dirty;
+};
\ No newline at end of file
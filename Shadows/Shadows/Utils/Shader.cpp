@@ -1,20 +1,44 @@
 #include "Shader.hpp"
+#include "RenderState.hpp"
 
 #include <fstream>
 #include <sstream>
 
 #include <GL/glew.h>
 
-Shader::Shader( const char* vertexPath, const char* fragmentPath, const char* geometryPath )
+UniformKey::UniformKey( const char* name )
+	: Hash( HashName( name ) ), Name( name )
+{
+}
+
+UniformKey::UniformKey( const std::string& name )
+	: Hash( HashName( name.c_str() ) ), Name( name )
+{
+}
+
+unsigned int UniformKey::HashName( const char* name )
+{
+	unsigned int hash = 2166136261u;
+	for ( ; *name; name++ ) {
+		hash ^= ( unsigned char )*name;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+Shader::Shader( const char* vertexPath, const char* fragmentPath, const char* geometryPath, const char* defines )
 {
 	// 1. read code from file
 
 	std::string vertexCode;
 	readCodeFromFile( vertexPath, vertexCode );
+	insertDefines( vertexCode, defines );
 	const char* vShaderCode = vertexCode.c_str();
 
 	std::string fragmentCode;
 	readCodeFromFile( fragmentPath, fragmentCode );
+	insertDefines( fragmentCode, defines );
 	const char* fShaderCode = fragmentCode.c_str();
 
 	// 2. create and compile shaders
@@ -34,6 +58,7 @@ Shader::Shader( const char* vertexPath, const char* fragmentPath, const char* ge
 	if ( geometryPath ) {
 		std::string geometryCode;
 		readCodeFromFile( geometryPath, geometryCode );
+		insertDefines( geometryCode, defines );
 		const char* gShaderCode = geometryCode.c_str();
 
 		unsigned int geometry;
@@ -44,6 +69,37 @@ Shader::Shader( const char* vertexPath, const char* fragmentPath, const char* ge
 		glDeleteShader( geometry );
 	}
 
+	linkProgram();
+
+	this->use();
+
+
+	// 4. delete shaders
+	glDeleteShader( vertex );
+	glDeleteShader( fragment );
+}
+
+Shader::Shader( GLenum stage, const char* path, const char* defines )
+{
+	std::string code;
+	readCodeFromFile( path, code );
+	insertDefines( code, defines );
+
+	unsigned int shader;
+	createCompileShader( stage, shader, code.c_str() );
+
+	this->ID = glCreateProgram();
+	glAttachShader( this->ID, shader );
+
+	linkProgram();
+
+	this->use();
+
+	glDeleteShader( shader );
+}
+
+void Shader::linkProgram()
+{
 	glLinkProgram( this->ID );
 
 	// print linking errors if any
@@ -54,12 +110,7 @@ Shader::Shader( const char* vertexPath, const char* fragmentPath, const char* ge
 			infoLog << std::endl;
 	}
 
-	this->use();
-
-
-	// 4. delete shaders
-	glDeleteShader( vertex );
-	glDeleteShader( fragment );
+	reflectUniforms();
 }
 
 void Shader::readCodeFromFile( const char* path, std::string& shaderCode )
@@ -85,6 +136,21 @@ void Shader::readCodeFromFile( const char* path, std::string& shaderCode )
 	}
 }
 
+void Shader::insertDefines( std::string& shaderCode, const char* defines )
+{
+	if ( !defines )
+		return;
+
+	// #version has to stay the first statement
+	size_t insertAt = 0;
+	if ( shaderCode.compare( 0, 8, "#version" ) == 0 ) {
+		insertAt = shaderCode.find( '\n' );
+		insertAt = insertAt == std::string::npos ? shaderCode.size() : insertAt + 1;
+	}
+
+	shaderCode.insert( insertAt, std::string( defines ) + "\n" );
+}
+
 void Shader::createCompileShader( GLenum SHADER_TYPE, unsigned int& shaderID, const char* shaderCode )
 {
 	switch ( SHADER_TYPE ) {
@@ -97,6 +163,9 @@ void Shader::createCompileShader( GLenum SHADER_TYPE, unsigned int& shaderID, co
 	case GL_GEOMETRY_SHADER:
 		shaderID = glCreateShader( GL_GEOMETRY_SHADER );
 		break;
+	case GL_COMPUTE_SHADER:
+		shaderID = glCreateShader( GL_COMPUTE_SHADER );
+		break;
 	default:
 		std::cout << "ERROR::SHADER::CREATE::INCORRECT_SHADER_TYPE" << std::endl;
 		return;
@@ -113,57 +182,216 @@ void Shader::createCompileShader( GLenum SHADER_TYPE, unsigned int& shaderID, co
 	}
 }
 
+void Shader::reflectUniforms()
+{
+	int uniformCount = 0;
+	glGetProgramiv( this->ID, GL_ACTIVE_UNIFORMS, &uniformCount );
+
+	int maxNameLength = 0;
+	glGetProgramiv( this->ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength );
+	std::string name( maxNameLength, '\0' );
+
+	for ( int i = 0; i < uniformCount; i++ ) {
+		int length = 0, size = 0;
+		GLenum type;
+		glGetActiveUniform( this->ID, i, maxNameLength, &length, &size, &type, &name[ 0 ] );
+
+		std::string uniformName = name.substr( 0, length );
+		int location = glGetUniformLocation( this->ID, uniformName.c_str() );
+		// members of uniform blocks don't have a location
+		if ( location < 0 )
+			continue;
+
+		// arrays are reported as "name[0]", the locations of the other elements are queried separately
+		// because they aren't guaranteed to be consecutive
+		size_t bracket = uniformName.rfind( "[0]" );
+		if ( bracket == std::string::npos || bracket + 3 != uniformName.size() ) {
+			addUniformLocation( uniformName, location );
+			continue;
+		}
+
+		std::string arrayName = uniformName.substr( 0, bracket );
+		addUniformLocation( arrayName, location );
+		addUniformLocation( uniformName, location );
+		for ( int element = 1; element < size; element++ ) {
+			std::string elementName = arrayName + "[" + std::to_string( element ) + "]";
+			addUniformLocation( elementName, glGetUniformLocation( this->ID, elementName.c_str() ) );
+		}
+	}
+}
+
+void Shader::addUniformLocation( const std::string& name, int location )
+{
+	UniformLocation entry = { name, location };
+	std::pair<std::unordered_map<unsigned int, UniformLocation>::iterator, bool> result =
+		uniformLocations.insert( { UniformKey::HashName( name.c_str() ), entry } );
+	// the lookup compares the names, the second uniform would never be found
+	if ( !result.second && result.first->second.Name != name )
+		std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION\n" << result.first->second.Name << " " << name << std::endl;
+}
+
 Shader::~Shader()
 {
 	glDeleteProgram( this->ID );
+	RenderState::Invalidate();
 }
 
 void Shader::use()
 {
-	glUseProgram( this->ID );
+	RenderState::UseProgram( this->ID );
+}
+
+int Shader::GetUniformLocation( const UniformKey& key ) const
+{
+	// a different name with the same hash, e.g. of a uniform the compiler removed, isn't active
+	std::unordered_map<unsigned int, UniformLocation>::const_iterator it = uniformLocations.find( key.Hash );
+	if ( it == uniformLocations.end() || it->second.Name != key.Name )
+		return -1;
+	return it->second.Location;
+}
+
+void Shader::setBool( const UniformKey& key, bool value ) const
+{
+	setBool( GetUniformLocation( key ), value );
+}
+
+void Shader::setInt( const UniformKey& key, int value ) const
+{
+	setInt( GetUniformLocation( key ), value );
+}
+
+void Shader::setSampler( const UniformKey& key, int unit ) const
+{
+	int location = GetUniformLocation( key );
+	if ( location < 0 )
+		return;
+
+	std::unordered_map<int, int>::iterator it = samplerUnits.find( location );
+	if ( it != samplerUnits.end() && it->second == unit ) {
+		RenderState::ElidedCount++;
+		return;
+	}
+
+	RenderState::IssuedCount++;
+	samplerUnits[ location ] = unit;
+	glUniform1i( location, unit );
+}
+
+void Shader::setUInt( const UniformKey& key, unsigned int value ) const
+{
+	setUInt( GetUniformLocation( key ), value );
+}
+
+void Shader::setFloat( const UniformKey& key, float value ) const
+{
+	setFloat( GetUniformLocation( key ), value );
+}
+
+void Shader::setVec2( const UniformKey& key, glm::vec2 vec ) const
+{
+	setVec2( GetUniformLocation( key ), vec );
+}
+
+void Shader::setVec3( const UniformKey& key, glm::vec3 vec ) const
+{
+	setVec3( GetUniformLocation( key ), vec );
+}
+
+void Shader::setVec3( const UniformKey& key, float x, float y, float z ) const
+{
+	glUniform3f( GetUniformLocation( key ), x, y, z );
+}
+
+void Shader::setVec4( const UniformKey& key, glm::vec4 vec ) const
+{
+	setVec4( GetUniformLocation( key ), vec );
+}
+
+void Shader::setMatrix4( const UniformKey& key, const glm::mat4& matrix ) const
+{
+	setMatrix4( GetUniformLocation( key ), matrix );
+}
+
+void Shader::setMatrix3( const UniformKey& key, const glm::mat3& matrix ) const
+{
+	setMatrix3( GetUniformLocation( key ), matrix );
+}
+
+void Shader::setFloatArray( const UniformKey& key, const float* values, unsigned int count ) const
+{
+	glUniform1fv( GetUniformLocation( key ), count, values );
+}
+
+void Shader::setMatrix4Array( const UniformKey& key, const glm::mat4* matrices, unsigned int count ) const
+{
+	glUniformMatrix4fv( GetUniformLocation( key ), count, GL_FALSE, glm::value_ptr( matrices[ 0 ] ) );
+}
+
+void Shader::setUIntArray( const UniformKey& key, const unsigned int* values, unsigned int count ) const
+{
+	glUniform1uiv( GetUniformLocation( key ), count, values );
+}
+
+void Shader::setVec4Array( const UniformKey& key, const glm::vec4* vecs, unsigned int count ) const
+{
+	glUniform4fv( GetUniformLocation( key ), count, glm::value_ptr( vecs[ 0 ] ) );
+}
+
+void Shader::setBool( int location, bool value ) const
+{
+	glUniform1i( location, ( int ) value );
+}
+
+void Shader::setInt( int location, int value ) const
+{
+	glUniform1i( location, value );
 }
 
-void Shader::setBool( const std::string& name, bool value ) const
+void Shader::setUInt( int location, unsigned int value ) const
 {
-	glUniform1i( glGetUniformLocation( this->ID, name.c_str() ), ( int ) value );
+	glUniform1ui( location, value );
 }
 
-void Shader::setInt( const std::string& name, int value ) const
+void Shader::setFloat( int location, float value ) const
 {
-	glUniform1i( glGetUniformLocation( this->ID, name.c_str() ), value );
+	glUniform1f( location, value );
 }
 
-void Shader::setFloat( const std::string& name, float value ) const
+void Shader::setVec2( int location, glm::vec2 vec ) const
 {
-	glUniform1f( glGetUniformLocation( this->ID, name.c_str() ), value );
+	glUniform2fv( location, 1, glm::value_ptr( vec ) );
 }
 
-void Shader::setVec2( const std::string& name, glm::vec2 vec ) const
+void Shader::setVec3( int location, glm::vec3 vec ) const
 {
-	glUniform2fv( glGetUniformLocation( this->ID, name.c_str() ), 1, glm::value_ptr( vec ) );
+	glUniform3fv( location, 1, glm::value_ptr( vec ) );
 }
 
-void Shader::setVec3( const std::string& name, glm::vec3 vec ) const
+void Shader::setVec4( int location, glm::vec4 vec ) const
 {
-	glUniform3fv( glGetUniformLocation( this->ID, name.c_str() ), 1, glm::value_ptr( vec ) );
+	glUniform4fv( location, 1, glm::value_ptr( vec ) );
 }
 
-void Shader::setVec3( const std::string& name, float x, float y, float z ) const
+void Shader::setMatrix4( int location, const glm::mat4& matrix ) const
 {
-	glUniform3f( glGetUniformLocation( this->ID, name.c_str() ), x, y, z );
+	glUniformMatrix4fv( location, 1, GL_FALSE, glm::value_ptr( matrix ) );
 }
 
-void Shader::setVec4( const std::string& name, glm::vec4 vec ) const
+void Shader::setMatrix3( int location, const glm::mat3& matrix ) const
 {
-	glUniform4fv( glGetUniformLocation( this->ID, name.c_str() ), 1, glm::value_ptr( vec ) );
+	glUniformMatrix3fv( location, 1, GL_FALSE, glm::value_ptr( matrix ) );
 }
 
-void Shader::setMatrix4( const std::string& name, glm::mat4 matrix ) const
+void Shader::setUniformBlockBinding( const std::string& name, unsigned int binding ) const
 {
-	glUniformMatrix4fv( glGetUniformLocation( this->ID, name.c_str() ), 1, GL_FALSE, glm::value_ptr( matrix ) );
+	unsigned int index = glGetUniformBlockIndex( this->ID, name.c_str() );
+	if ( index != GL_INVALID_INDEX )
+		glUniformBlockBinding( this->ID, index, binding );
 }
 
-void Shader::setMatrix3( const std::string& name, glm::mat3 matrix ) const
+void Shader::setStorageBlockBinding( const std::string& name, unsigned int binding ) const
 {
-	glUniformMatrix3fv( glGetUniformLocation( this->ID, name.c_str() ), 1, GL_FALSE, glm::value_ptr( matrix ) );
+	unsigned int index = glGetProgramResourceIndex( this->ID, GL_SHADER_STORAGE_BLOCK, name.c_str() );
+	if ( index != GL_INVALID_INDEX )
+		glShaderStorageBlockBinding( this->ID, index, binding );
 }
\ No newline at end of file
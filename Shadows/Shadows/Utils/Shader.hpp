@@ -8,6 +8,21 @@
 
 #include <iostream>
 #include <string>
+#include <unordered_map>
+
+// Hashed uniform name (FNV-1a), used to look up the location in the table the Shader builds at link time.
+// The name is kept, so a hash that happens to match another uniform can't set the wrong one.
+// Converts implicitly from strings, but a key stored once (e.g. as a static const) saves hashing and copying the name on every call
+struct UniformKey
+{
+	unsigned int Hash;
+	std::string Name;
+
+	UniformKey( const char* name );
+	UniformKey( const std::string& name );
+
+	static unsigned int HashName( const char* name );
+};
 
 class Shader
 {
@@ -15,28 +30,81 @@ public:
 	// program ID
 	unsigned int ID;
 
-	Shader( const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr );
+	// defines: optional lines of "#define ..." that get inserted right after the #version line of every stage
+	Shader( const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const char* defines = nullptr );
+	// single stage program, stage has to be GL_COMPUTE_SHADER
+	Shader( GLenum stage, const char* path, const char* defines = nullptr );
 private:
 	// for debugging
 	int success;
 	char infoLog[ 512 ];
 
 	void readCodeFromFile( const char* path, std::string& shaderCode );
+	void insertDefines( std::string& shaderCode, const char* defines );
 	void createCompileShader( GLenum SHADER_TYPE, unsigned int& shaderID, const char* shaderCode );
+	void linkProgram();
+
+	struct UniformLocation
+	{
+		std::string Name;
+		int Location;
+	};
+
+	// name hash -> location of every active uniform, arrays are registered both as "name" and per element as "name[i]".
+	// Two active uniforms with the same hash are reported when the table is built
+	std::unordered_map<unsigned int, UniformLocation> uniformLocations;
+
+	void reflectUniforms();
+	void addUniformLocation( const std::string& name, int location );
+
+	// location -> texture unit of the sampler uniforms set through setSampler()
+	mutable std::unordered_map<int, int> samplerUnits;
 
 public:
 	~Shader();
 
 	void use();
 
-	void setBool( const std::string& name, bool value ) const;
-	void setInt( const std::string& name, int value ) const;
-	void setFloat( const std::string& name, float value ) const;
+	// returns the location from the table built at link time, -1 if the uniform isn't active (setting -1 is a no-op).
+	// The location stays valid for the lifetime of the shader, so it can be fetched once and used as a handle
+	int GetUniformLocation( const UniformKey& key ) const;
+
+	// setters by key only cost a table lookup and a name compare, no GL query. Keys made from a string on the spot also hash it
+	void setBool( const UniformKey& key, bool value ) const;
+	void setInt( const UniformKey& key, int value ) const;
+	void setUInt( const UniformKey& key, unsigned int value ) const;
+	void setFloat( const UniformKey& key, float value ) const;
+
+	void setVec2( const UniformKey& key, glm::vec2 vec ) const;
+	void setVec3( const UniformKey& key, glm::vec3 vec ) const;
+	void setVec3( const UniformKey& key, float x, float y, float z ) const;
+	void setVec4( const UniformKey& key, glm::vec4 vec ) const;
+	void setMatrix4( const UniformKey& key, const glm::mat4& matrix ) const;
+	void setMatrix3( const UniformKey& key, const glm::mat3& matrix ) const;
+
+	// like setInt, but skips the call if the sampler already points at the unit. Has to be used while the shader is in use
+	void setSampler( const UniformKey& key, int unit ) const;
+
+	// whole arrays in one call, key is the name of the array without an index
+	void setFloatArray( const UniformKey& key, const float* values, unsigned int count ) const;
+	void setMatrix4Array( const UniformKey& key, const glm::mat4* matrices, unsigned int count ) const;
+	void setUIntArray( const UniformKey& key, const unsigned int* values, unsigned int count ) const;
+	void setVec4Array( const UniformKey& key, const glm::vec4* vecs, unsigned int count ) const;
+
+	// setters by handle from GetUniformLocation()
+	void setBool( int location, bool value ) const;
+	void setInt( int location, int value ) const;
+	void setUInt( int location, unsigned int value ) const;
+	void setFloat( int location, float value ) const;
+
+	void setVec2( int location, glm::vec2 vec ) const;
+	void setVec3( int location, glm::vec3 vec ) const;
+	void setVec4( int location, glm::vec4 vec ) const;
+	void setMatrix4( int location, const glm::mat4& matrix ) const;
+	void setMatrix3( int location, const glm::mat3& matrix ) const;
 
-	void setVec2( const std::string& name, glm::vec2 vec ) const;
-	void setVec3( const std::string& name, glm::vec3 vec ) const;
-	void setVec3( const std::string& name, float x, float y, float z ) const;
-	void setVec4( const std::string& name, glm::vec4 vec ) const;
-	void setMatrix4( const std::string& name, glm::mat4 matrix ) const;
-	void setMatrix3( const std::string& name, glm::mat3 matrix ) const;
+	// connects the uniform block with the given name to a uniform buffer binding point (no-op if the block is unused)
+	void setUniformBlockBinding( const std::string& name, unsigned int binding ) const;
+	// same for shader storage blocks
+	void setStorageBlockBinding( const std::string& name, unsigned int binding ) const;
 };
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include "ShadowAtlas.hpp"
+#include "RenderState.hpp"
+
+#include <GL/glew.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// hashed once, set every frame
+const UniformKey UNIFORM_SHADOW_ATLAS( "u_ShadowAtlas" );
+
+ShadowAtlas::ShadowAtlas( size_t memoryBudgetBytes, unsigned int minTileSize, unsigned int maxTileSize )
+	: FBO( 0 ), DepthMap( 0 ), LightsUBO( 0 ), Size( minTileSize ), MinTileSize( minTileSize ), MaxTileSize( maxTileSize )
+{
+	// 32 bit depth, grow while the next power of two still fits the budget
+	const size_t bytesPerTexel = 4;
+	while ( Size < 8192 && ( size_t ) Size * 2 * Size * 2 * bytesPerTexel <= memoryBudgetBytes )
+		Size *= 2;
+	MaxTileSize = std::min( MaxTileSize, Size );
+
+	glGenTextures( 1, &DepthMap );
+	RenderState::BindTexture( 0, GL_TEXTURE_2D, DepthMap );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, Size, Size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr );
+	// hardware PCF, the shaders clamp the taps to the tile so neighbours don't bleed in
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+	glGenFramebuffers( 1, &FBO );
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, FBO );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, DepthMap, 0 );
+	glDrawBuffer( GL_NONE );
+	glReadBuffer( GL_NONE );
+	if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE ) {
+		std::cout << "ERROR::FRAMEBUFFER:: Shadow atlas framebuffer is not complete!\n";
+	}
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+	// light array followed by the light count
+	glGenBuffers( 1, &LightsUBO );
+	glBindBuffer( GL_UNIFORM_BUFFER, LightsUBO );
+	glBufferData( GL_UNIFORM_BUFFER, MAX_SPOT_LIGHTS * sizeof( SpotLightData ) + sizeof( int ), nullptr, GL_DYNAMIC_DRAW );
+	glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+	glDeleteFramebuffers( 1, &FBO );
+	glDeleteTextures( 1, &DepthMap );
+	glDeleteBuffers( 1, &LightsUBO );
+	RenderState::Invalidate();
+}
+
+void ShadowAtlas::Update( const std::vector<SpotLight>& lights, const Camera& camera )
+{
+	unsigned int count = std::min( ( unsigned int ) lights.size(), MAX_SPOT_LIGHTS );
+
+	Tiles.assign( count, Tile{ 0, 0, 0, glm::mat4( 1.f ) } );
+	std::vector<unsigned int> sizes( count, 0 );
+	std::vector<float> priorities( count, 0.f );
+
+	for ( unsigned int i = 0; i < count; i++ ) {
+		const SpotLight& light = lights[ i ];
+
+		glm::vec3 up = std::abs( light.Direction.y ) > 0.99f ? glm::vec3( 0.f, 0.f, 1.f ) : glm::vec3( 0.f, 1.f, 0.f );
+		glm::mat4 projection = glm::perspective( glm::radians( 2.f * light.OuterCone ), 1.f, 0.1f, light.Range );
+		Tiles[ i ].LightSpaceMatrix = projection * glm::lookAt( light.Position, light.Position + light.Direction, up );
+
+		priorities[ i ] = screenCoverage( light, camera ) * light.Importance;
+		if ( priorities[ i ] <= 0.f )
+			continue;
+
+		// smallest power of two that covers the wanted resolution
+		float wanted = MaxTileSize * std::min( priorities[ i ], 1.f );
+		sizes[ i ] = MinTileSize;
+		while ( sizes[ i ] < wanted && sizes[ i ] < MaxTileSize )
+			sizes[ i ] *= 2;
+	}
+
+	fitBudget( sizes, priorities );
+	pack( sizes );
+	uploadLights( lights );
+}
+
+float ShadowAtlas::screenCoverage( const SpotLight& light, const Camera& camera ) const
+{
+	// treats the lit volume as a sphere of the light range, returns the fraction of the screen height it covers
+	glm::vec3 toLight = light.Position - camera.Position;
+
+	// completely behind the camera
+	if ( glm::dot( toLight, camera.Front ) < -light.Range )
+		return 0.f;
+
+	float distance = std::max( glm::length( toLight ) - light.Range, 0.1f );
+	float projectedRadius = light.Range / ( distance * std::tan( glm::radians( camera.Zoom ) * 0.5f ) );
+
+	return std::min( projectedRadius, 1.f );
+}
+
+void ShadowAtlas::fitBudget( std::vector<unsigned int>& sizes, const std::vector<float>& priorities ) const
+{
+	size_t capacity = ( size_t ) Size * Size;
+
+	while ( true ) {
+		size_t used = 0;
+		for ( unsigned int i = 0; i < sizes.size(); i++ )
+			used += ( size_t ) sizes[ i ] * sizes[ i ];
+
+		if ( used <= capacity )
+			return;
+
+		// shrink the least important tile that can still shrink, drop the least important one when all are minimal
+		int shrink = -1;
+		int drop = -1;
+		for ( unsigned int i = 0; i < sizes.size(); i++ ) {
+			if ( sizes[ i ] == 0 )
+				continue;
+			if ( sizes[ i ] > MinTileSize && ( shrink < 0 || priorities[ i ] < priorities[ shrink ] ) )
+				shrink = i;
+			if ( drop < 0 || priorities[ i ] < priorities[ drop ] )
+				drop = i;
+		}
+
+		if ( shrink >= 0 )
+			sizes[ shrink ] /= 2;
+		else
+			sizes[ drop ] = 0;
+	}
+}
+
+void ShadowAtlas::pack( const std::vector<unsigned int>& sizes )
+{
+	std::vector<unsigned int> order( sizes.size() );
+	for ( unsigned int i = 0; i < order.size(); i++ )
+		order[ i ] = i;
+	std::stable_sort( order.begin(), order.end(), [ &sizes ]( unsigned int a, unsigned int b ) { return sizes[ a ] > sizes[ b ]; } );
+
+	// position along the Z-order curve in MinTileSize cells. Every tile is at most as big as the one before it,
+	// so the position is always a multiple of its cell count and the tile lands on an aligned quadtree node
+	unsigned int cell = 0;
+	for ( unsigned int i = 0; i < order.size(); i++ ) {
+		Tile& tile = Tiles[ order[ i ] ];
+		tile.Size = sizes[ order[ i ] ];
+		if ( tile.Size == 0 )
+			continue;
+
+		// de-interleave the bits of the curve position into x and y
+		unsigned int x = 0, y = 0;
+		for ( unsigned int bit = 0; bit < 16; bit++ ) {
+			x |= ( ( cell >> ( 2 * bit ) ) & 1u ) << bit;
+			y |= ( ( cell >> ( 2 * bit + 1 ) ) & 1u ) << bit;
+		}
+		tile.X = x * MinTileSize;
+		tile.Y = y * MinTileSize;
+
+		unsigned int cellsPerSide = tile.Size / MinTileSize;
+		cell += cellsPerSide * cellsPerSide;
+	}
+}
+
+void ShadowAtlas::uploadLights( const std::vector<SpotLight>& lights ) const
+{
+	std::vector<SpotLightData> data( Tiles.size() );
+	for ( unsigned int i = 0; i < Tiles.size(); i++ ) {
+		const SpotLight& light = lights[ i ];
+		const Tile& tile = Tiles[ i ];
+
+		data[ i ].LightSpaceMatrix = tile.LightSpaceMatrix;
+		data[ i ].AtlasRect = glm::vec4( tile.X, tile.Y, tile.Size, tile.Size ) / ( float ) Size;
+		data[ i ].PositionRange = glm::vec4( light.Position, light.Range );
+		data[ i ].DirectionCone = glm::vec4( glm::normalize( light.Direction ), std::cos( glm::radians( light.OuterCone ) ) );
+		data[ i ].Color = glm::vec4( light.Color, 1.f );
+	}
+	int count = ( int ) Tiles.size();
+
+	glBindBuffer( GL_UNIFORM_BUFFER, LightsUBO );
+	if ( !data.empty() )
+		glBufferSubData( GL_UNIFORM_BUFFER, 0, data.size() * sizeof( SpotLightData ), data.data() );
+	glBufferSubData( GL_UNIFORM_BUFFER, MAX_SPOT_LIGHTS * sizeof( SpotLightData ), sizeof( int ), &count );
+	glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+}
+
+void ShadowAtlas::BindTileForWriting( unsigned int light ) const
+{
+	const Tile& tile = Tiles[ light ];
+
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, FBO );
+	RenderState::Viewport( tile.X, tile.Y, tile.Size, tile.Size );
+	RenderState::Scissor( tile.X, tile.Y, tile.Size, tile.Size );
+	RenderState::SetEnabled( GL_SCISSOR_TEST, true );
+	glClear( GL_DEPTH_BUFFER_BIT );
+}
+
+void ShadowAtlas::FinishWriting() const
+{
+	RenderState::SetEnabled( GL_SCISSOR_TEST, false );
+}
+
+void ShadowAtlas::BindForReading( Shader& shader, unsigned int textureUnit ) const
+{
+	RenderState::BindTexture( textureUnit, GL_TEXTURE_2D, DepthMap );
+	shader.setSampler( UNIFORM_SHADOW_ATLAS, textureUnit );
+
+	glBindBufferBase( GL_UNIFORM_BUFFER, SPOT_LIGHTS_UBO_BINDING, LightsUBO );
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Camera.hpp"
+#include "Shader.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Has to match MAX_SPOT_LIGHTS in the shading shaders
+const unsigned int MAX_SPOT_LIGHTS = 32;
+// Uniform buffer binding point of the SpotLights block
+const unsigned int SPOT_LIGHTS_UBO_BINDING = 0;
+
+// A shadow casting spot light
+struct SpotLight
+{
+	glm::vec3 Position;
+	glm::vec3 Direction;
+	glm::vec3 Color;
+	float OuterCone;	// half angle in degrees
+	float Range;
+	float Importance;	// scales the requested shadow resolution, 1.0 = only screen coverage counts
+};
+
+// Shadow maps of many spot lights packed into one big depth texture, so all of them are rendered with a single
+// FBO and only a viewport/scissor change per light. Every frame each light requests a power of two tile sized
+// by its screen coverage and importance, the requests are shrunk until they fit the memory budget and packed
+// with a quadtree (tiles are placed largest first along a Z-order curve, which never fragments).
+// The per light data including the atlas rect is uploaded into the SpotLights uniform block.
+class ShadowAtlas
+{
+public:
+	// where a light ended up in the atlas, Size == 0 means it got no shadow this frame
+	struct Tile
+	{
+		unsigned int X;
+		unsigned int Y;
+		unsigned int Size;
+		glm::mat4 LightSpaceMatrix;
+	};
+
+	// render data
+	unsigned int FBO;
+	unsigned int DepthMap;
+	unsigned int LightsUBO;
+
+	// width and height of the atlas, the biggest power of two that fits the memory budget
+	unsigned int Size;
+	unsigned int MinTileSize;
+	unsigned int MaxTileSize;
+
+	// one per light passed to Update()
+	std::vector<Tile> Tiles;
+
+	ShadowAtlas( size_t memoryBudgetBytes, unsigned int minTileSize = 64, unsigned int maxTileSize = 1024 );
+	~ShadowAtlas();
+
+	// allocates the tiles for this frame and uploads the light data
+	void Update( const std::vector<SpotLight>& lights, const Camera& camera );
+
+	// binds the atlas and restricts viewport + scissor to the tile of the light, the tile gets cleared
+	void BindTileForWriting( unsigned int light ) const;
+	// disables the scissor test again after all tiles are rendered
+	void FinishWriting() const;
+
+	// binds the atlas to the texture unit and the light data to SPOT_LIGHTS_UBO_BINDING
+	void BindForReading( Shader& shader, unsigned int textureUnit ) const;
+
+private:
+	// std140 layout of one element of the SpotLights block
+	struct SpotLightData
+	{
+		glm::mat4 LightSpaceMatrix;
+		glm::vec4 AtlasRect;		// xy offset, zw size in atlas uv, zw = 0 when the light has no shadow
+		glm::vec4 PositionRange;
+		glm::vec4 DirectionCone;	// w = cos of the outer cone
+		glm::vec4 Color;
+	};
+
+	float screenCoverage( const SpotLight& light, const Camera& camera ) const;
+	void fitBudget( std::vector<unsigned int>& sizes, const std::vector<float>& priorities ) const;
+	void pack( const std::vector<unsigned int>& sizes );
+	void uploadLights( const std::vector<SpotLight>& lights ) const;
+};
\ No newline at end of file
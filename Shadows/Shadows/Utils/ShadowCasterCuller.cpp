@@ -0,0 +1,107 @@
+#include "ShadowCasterCuller.hpp"
+
+ShadowCasterCuller::ShadowCasterCuller()
+	: TestedCount( 0 ), CulledCount( 0 ), mode( CULL_SPHERE ), useReceivers( false ),
+	lightSpaceMatrix( 1.f ), sphereCenter( 0.f ), sphereRadius( 0.f )
+{
+}
+
+void ShadowCasterCuller::SetVisibleReceivers( const std::vector<AABB>& receiverBounds, const Frustum& cameraFrustum )
+{
+	visibleReceivers.clear();
+	for ( unsigned int i = 0; i < receiverBounds.size(); i++ ) {
+		if ( cameraFrustum.Intersects( receiverBounds[ i ] ) )
+			visibleReceivers.push_back( receiverBounds[ i ] );
+	}
+}
+
+void ShadowCasterCuller::BeginOrthographic( const glm::mat4& lightSpaceMatrix, bool useReceivers )
+{
+	mode = CULL_ORTHOGRAPHIC;
+	this->useReceivers = useReceivers;
+	this->lightSpaceMatrix = lightSpaceMatrix;
+
+	// an orthographic light space matrix is affine, so boxes stay boxes in its clip space
+	lightReceivers.clear();
+	if ( useReceivers ) {
+		for ( unsigned int i = 0; i < visibleReceivers.size(); i++ )
+			lightReceivers.push_back( visibleReceivers[ i ].Transformed( lightSpaceMatrix ) );
+	}
+}
+
+void ShadowCasterCuller::BeginPerspective( const glm::mat4& lightSpaceMatrix )
+{
+	mode = CULL_PERSPECTIVE;
+	lightFrustum = Frustum( lightSpaceMatrix );
+}
+
+void ShadowCasterCuller::BeginSphere( glm::vec3 center, float radius )
+{
+	mode = CULL_SPHERE;
+	sphereCenter = center;
+	sphereRadius = radius;
+}
+
+bool ShadowCasterCuller::IsVisible( const AABB& casterBounds )
+{
+	TestedCount++;
+
+	bool visible = true;
+	switch ( mode ) {
+	case CULL_ORTHOGRAPHIC:
+	{
+		AABB caster = casterBounds.Transformed( lightSpaceMatrix );
+
+		// outside of the sides or behind the far plane. In front of the near plane is fine, the depth pass clamps those
+		visible = caster.Max.x >= -1.f && caster.Min.x <= 1.f && caster.Max.y >= -1.f && caster.Min.y <= 1.f && caster.Min.z <= 1.f;
+
+		// the shadow volume of the caster (extruded away from the light, towards +z) has to hit a visible receiver
+		if ( visible && useReceivers ) {
+			visible = false;
+			for ( unsigned int i = 0; i < lightReceivers.size() && !visible; i++ ) {
+				const AABB& receiver = lightReceivers[ i ];
+				visible = caster.Max.x >= receiver.Min.x && caster.Min.x <= receiver.Max.x &&
+					caster.Max.y >= receiver.Min.y && caster.Min.y <= receiver.Max.y &&
+					caster.Min.z <= receiver.Max.z;
+			}
+		}
+		break;
+	}
+	case CULL_PERSPECTIVE:
+		visible = lightFrustum.Intersects( casterBounds );
+		break;
+	case CULL_SPHERE:
+	{
+		// squared distance from the sphere center to the closest point of the box
+		glm::vec3 closest = glm::clamp( sphereCenter, casterBounds.Min, casterBounds.Max );
+		glm::vec3 delta = closest - sphereCenter;
+		visible = glm::dot( delta, delta ) <= sphereRadius * sphereRadius;
+		break;
+	}
+	}
+
+	if ( !visible )
+		CulledCount++;
+
+	return visible;
+}
+
+CullVolume ShadowCasterCuller::GetVolume() const
+{
+	switch ( mode ) {
+	case CULL_ORTHOGRAPHIC:
+		// same as IsVisible(), casters in front of the near plane get clamped
+		return CullVolume( Frustum( lightSpaceMatrix ), FRUSTUM_ALL_PLANES & ~FRUSTUM_NEAR_PLANE );
+	case CULL_PERSPECTIVE:
+		return CullVolume( lightFrustum );
+	case CULL_SPHERE:
+	default:
+		return CullVolume( sphereCenter, sphereRadius );
+	}
+}
+
+void ShadowCasterCuller::ResetStats()
+{
+	TestedCount = 0;
+	CulledCount = 0;
+}
\ No newline at end of file
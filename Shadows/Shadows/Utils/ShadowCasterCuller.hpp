@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Bounds.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Decides per shadow view which casters are worth drawing into the depth map. A caster is rejected when it is
+// outside of the light volume, and for directional lights also when it doesn't overlap the light space
+// footprint of any receiver the camera can see (its shadow would only fall on invisible geometry)
+class ShadowCasterCuller
+{
+public:
+	// since the last ResetStats()
+	unsigned int TestedCount;
+	unsigned int CulledCount;
+
+	ShadowCasterCuller();
+
+	// has to be called once per frame before the light views that use the receivers
+	void SetVisibleReceivers( const std::vector<AABB>& receiverBounds, const Frustum& cameraFrustum );
+
+	// directional light. useReceivers should be false when the result gets cached beyond the current frame,
+	// because the visible receivers change with the camera
+	void BeginOrthographic( const glm::mat4& lightSpaceMatrix, bool useReceivers );
+	// spot light
+	void BeginPerspective( const glm::mat4& lightSpaceMatrix );
+	// point light
+	void BeginSphere( glm::vec3 center, float radius );
+
+	bool IsVisible( const AABB& casterBounds );
+
+	// the light volume of the current view for GpuCuller. Doesn't include the receiver test, that one only runs on the CPU
+	CullVolume GetVolume() const;
+
+	void ResetStats();
+
+private:
+	enum CullMode
+	{
+		CULL_ORTHOGRAPHIC,
+		CULL_PERSPECTIVE,
+		CULL_SPHERE,
+	};
+
+	CullMode mode;
+	bool useReceivers;
+	glm::mat4 lightSpaceMatrix;
+	Frustum lightFrustum;
+	glm::vec3 sphereCenter;
+	float sphereRadius;
+
+	std::vector<AABB> visibleReceivers;
+	// visibleReceivers in the clip space of the current orthographic light
+	std::vector<AABB> lightReceivers;
+};
\ No newline at end of file
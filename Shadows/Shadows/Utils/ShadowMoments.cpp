@@ -0,0 +1,104 @@
+#include "ShadowMoments.hpp"
+#include "RenderState.hpp"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+
+// hashed once, set for every cascade of every frame
+const UniformKey UNIFORM_SOURCE( "u_Source" );
+const UniformKey UNIFORM_LAYER( "u_Layer" );
+const UniformKey UNIFORM_DIRECTION( "u_Direction" );
+const UniformKey UNIFORM_SHADOW_MOMENTS( "u_ShadowMoments" );
+
+ShadowMoments::ShadowMoments( const CascadedShadowMap& shadowMap, ShadowFilter technique )
+	: MomentsArray( 0 ), FBO( 0 ), DepthSampler( 0 ),
+	Resolution( shadowMap.Resolution ), CascadeCount( shadowMap.CascadeCount ), Technique( technique ),
+	// EVSM stores the positive and the negative warp, plain VSM only needs depth and depth squared
+	InternalFormat( technique == FILTER_EVSM ? GL_RGBA32F : GL_RG32F )
+{
+	GLenum format = Technique == FILTER_EVSM ? GL_RGBA : GL_RG;
+
+	glGenTextures( 1, &MomentsArray );
+	RenderState::BindTexture( 0, GL_TEXTURE_2D_ARRAY, MomentsArray );
+	glTexImage3D( GL_TEXTURE_2D_ARRAY, 0, InternalFormat, Resolution, Resolution, CascadeCount, 0, format, GL_FLOAT, nullptr );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	if ( GLEW_EXT_texture_filter_anisotropic ) {
+		float maxAnisotropy;
+		glGetFloatv( GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy );
+		glTexParameterf( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::min( maxAnisotropy, 16.f ) );
+	}
+	glGenerateMipmap( GL_TEXTURE_2D_ARRAY );
+
+	glGenSamplers( 1, &DepthSampler );
+	glSamplerParameteri( DepthSampler, GL_TEXTURE_COMPARE_MODE, GL_NONE );
+	glSamplerParameteri( DepthSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glSamplerParameteri( DepthSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glSamplerParameteri( DepthSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glSamplerParameteri( DepthSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+	glGenFramebuffers( 1, &FBO );
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, FBO );
+	glFramebufferTextureLayer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, MomentsArray, 0, 0 );
+	if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE ) {
+		std::cout << "ERROR::FRAMEBUFFER:: Shadow moments framebuffer is not complete!\n";
+	}
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, 0 );
+}
+
+ShadowMoments::~ShadowMoments()
+{
+	glDeleteFramebuffers( 1, &FBO );
+	glDeleteTextures( 1, &MomentsArray );
+	glDeleteSamplers( 1, &DepthSampler );
+	RenderState::Invalidate();
+}
+
+void ShadowMoments::BindHorizontalPass( Shader& blurShader, const CascadedShadowMap& shadowMap, unsigned int cascade, unsigned int textureUnit ) const
+{
+	RenderState::BindTexture( textureUnit, GL_TEXTURE_2D_ARRAY, shadowMap.DepthMapArray );
+	RenderState::BindSampler( textureUnit, DepthSampler );
+
+	blurShader.use();
+	blurShader.setInt( UNIFORM_SOURCE, textureUnit );
+	blurShader.setInt( UNIFORM_LAYER, cascade );
+	blurShader.setVec2( UNIFORM_DIRECTION, glm::vec2( 1.f / Resolution, 0.f ) );
+}
+
+void ShadowMoments::BindVerticalPass( Shader& blurShader, unsigned int blurTexture, unsigned int cascade, unsigned int textureUnit ) const
+{
+	RenderState::BindFramebuffer( GL_FRAMEBUFFER, FBO );
+	glFramebufferTextureLayer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, MomentsArray, 0, cascade );
+	RenderState::Viewport( 0, 0, Resolution, Resolution );
+
+	RenderState::BindTexture( textureUnit, GL_TEXTURE_2D, blurTexture );
+	RenderState::BindSampler( textureUnit, 0 );
+
+	blurShader.use();
+	blurShader.setInt( UNIFORM_SOURCE, textureUnit );
+	blurShader.setVec2( UNIFORM_DIRECTION, glm::vec2( 0.f, 1.f / Resolution ) );
+}
+
+void ShadowMoments::GenerateMipmaps() const
+{
+	RenderState::BindTexture( 0, GL_TEXTURE_2D_ARRAY, MomentsArray );
+	glGenerateMipmap( GL_TEXTURE_2D_ARRAY );
+}
+
+void ShadowMoments::BindForReading( Shader& shader, unsigned int textureUnit ) const
+{
+	RenderState::BindTexture( textureUnit, GL_TEXTURE_2D_ARRAY, MomentsArray );
+
+	shader.setSampler( UNIFORM_SHADOW_MOMENTS, textureUnit );
+}
+
+const char* ShadowMoments::GetBlurDefines( ShadowFilter technique, bool fromDepth )
+{
+	if ( technique == FILTER_EVSM )
+		return fromDepth ? "#define SHADOW_TECHNIQUE_EVSM\n#define BLUR_FROM_DEPTH" : "#define SHADOW_TECHNIQUE_EVSM";
+
+	return fromDepth ? "#define SHADOW_TECHNIQUE_VSM\n#define BLUR_FROM_DEPTH" : "#define SHADOW_TECHNIQUE_VSM";
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "CascadedShadowMap.hpp"
+#include "Shader.hpp"
+
+// Variance (VSM) or exponential variance (EVSM) shadow maps built on top of the cascaded depth map.
+// The moments are derived from the cascades after the depth pass (so the static cache still works),
+// blurred with a separable Gaussian and mipmapped, so the shading shaders get wide soft shadows from a
+// single trilinear + anisotropic lookup no matter how big the penumbra is.
+class ShadowMoments
+{
+public:
+	// render data
+	unsigned int MomentsArray;
+	unsigned int FBO;
+	// reads the depth array without the hardware comparison it is set up with
+	unsigned int DepthSampler;
+
+	unsigned int Resolution;
+	unsigned int CascadeCount;
+	ShadowFilter Technique;
+	// of the moments, and of the texture that holds the horizontally blurred moments of one cascade between the two blur passes
+	GLenum InternalFormat;
+
+	// technique has to be FILTER_VSM or FILTER_EVSM
+	ShadowMoments( const CascadedShadowMap& shadowMap, ShadowFilter technique );
+	~ShadowMoments();
+
+	// binds the cascade depth as source for the first (horizontal) blur pass, blurShader has to be built from shadowMomentsBlur.frs
+	// with BLUR_FROM_DEPTH defined. The target is a Resolution x Resolution texture of InternalFormat, bound by the caller
+	void BindHorizontalPass( Shader& blurShader, const CascadedShadowMap& shadowMap, unsigned int cascade, unsigned int textureUnit ) const;
+	// binds the moments cascade as target and the horizontally blurred texture as source for the second (vertical) blur pass
+	void BindVerticalPass( Shader& blurShader, unsigned int blurTexture, unsigned int cascade, unsigned int textureUnit ) const;
+	// has to be called after all cascades are blurred
+	void GenerateMipmaps() const;
+
+	void BindForReading( Shader& shader, unsigned int textureUnit ) const;
+
+	// returns the blur defines for the technique, combine with BLUR_FROM_DEPTH for the horizontal pass
+	static const char* GetBlurDefines( ShadowFilter technique, bool fromDepth );
+};
\ No newline at end of file
@@ -0,0 +1,34 @@
+#include "Vertex.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+CompactVertex PackVertex( const Vertex& vertex, const AABB& positionBounds )
+{
+	glm::vec3 center = positionBounds.Center();
+	glm::vec3 extent = positionBounds.Size() * .5f;
+
+	CompactVertex packed;
+	for ( unsigned int i = 0; i < 3; i++ ) {
+		// flat bounds, e.g. the floor, only have the center
+		float position = extent[ i ] > 0.f ? ( vertex.Position[ i ] - center[ i ] ) / extent[ i ] : 0.f;
+		packed.Position[ i ] = ( int16_t )std::round( std::min( std::max( position, -1.f ), 1.f ) * 32767.f );
+	}
+	packed.Padding = 0;
+
+	float length = glm::length( vertex.Normal );
+	glm::vec3 normal = length > 0.f ? vertex.Normal / length : glm::vec3( 0.f );
+	packed.Normal = glm::packSnorm3x10_1x2( glm::vec4( normal, 0.f ) );
+	packed.TexCoords = glm::packHalf2x16( vertex.TexCoords );
+
+	return packed;
+}
+
+glm::mat4 GetPositionDecodeMatrix( const AABB& positionBounds )
+{
+	glm::mat4 decode = glm::translate( glm::mat4( 1.f ), positionBounds.Center() );
+	return glm::scale( decode, positionBounds.Size() * .5f );
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Bounds.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+// Interleaved vertex of every mesh. Kept free of GL so the offline cooker can use it
+struct Vertex
+{
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::vec2 TexCoords;
+};
+
+// How the GeometryPool stores the vertices and indices of all meshes
+enum VertexFormat
+{
+	VERTEX_FORMAT_FLOAT,	// Vertex as is with 32 bit indices
+	VERTEX_FORMAT_COMPACT,	// CompactVertex with 16 bit indices, half the bandwidth and memory
+};
+
+// Quantized Vertex, 16 instead of 32 bytes:
+// - the position as 16 bit snorm relative to the bounds the geometry was added with. The ObjectBuffer folds the decoding
+//   into the model matrix, with the bounds the GeometryRange keeps,
+// - the normal as 10-10-10-2 snorm,
+// - the texture coordinates as half floats
+struct CompactVertex
+{
+	int16_t Position[ 3 ];
+	int16_t Padding;
+	uint32_t Normal;
+	uint32_t TexCoords;
+};
+
+// Only the position of a CompactVertex, for the position stream of the GeometryPool. Decodes the same way, so both streams
+// produce the same positions bit for bit
+struct CompactPosition
+{
+	int16_t Position[ 3 ];
+	int16_t Padding;
+};
+
+// most vertices a mesh can have with 16 bit indices, larger meshes are split on import
+const unsigned int MAX_COMPACT_VERTICES = 65535;
+
+CompactVertex PackVertex( const Vertex& vertex, const AABB& positionBounds );
+// maps the [-1, 1] positions of CompactVertex back into the bounds
+glm::mat4 GetPositionDecodeMatrix( const AABB& positionBounds );
\ No newline at end of file
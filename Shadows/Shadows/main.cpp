@@ -1,6 +1,24 @@
 #include "Utils/Shader.hpp"
 #include "Utils/Camera.hpp"
 #include "Utils/Model.hpp"
+#include "Utils/CascadedShadowMap.hpp"
+#include "Utils/ShadowMoments.hpp"
+#include "Utils/PointShadowMap.hpp"
+#include "Utils/ShadowAtlas.hpp"
+#include "Utils/SceneObject.hpp"
+#include "Utils/ShadowCasterCuller.hpp"
+#include "Utils/SceneBVH.hpp"
+#include "Utils/FrameUniforms.hpp"
+#include "Utils/ObjectBuffer.hpp"
+#include "Utils/GeometryPool.hpp"
+#include "Utils/MeshOptimizer.hpp"
+#include "Utils/GpuCuller.hpp"
+#include "Utils/HiZPyramid.hpp"
+#include "Utils/SceneFramebuffer.hpp"
+#include "Utils/RenderState.hpp"
+#include "Utils/DrawQueue.hpp"
+#include "Utils/RenderGraph.hpp"
+#include "Utils/OverdrawEstimator.hpp"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -9,13 +27,22 @@
 
 #include <GLM/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
 
 void scrollCallback (GLFWwindow* window, double xpos, double ypos);
 void mouseCallback (GLFWwindow* window, double xposIn, double yposIn);
 void processInput (GLFWwindow* window);
 unsigned int loadTexture (const char* path);
+// Creates the scene and runs the render loop. Everything that owns GL objects, on the heap or on the stack,
+// is destroyed when it returns, while the context still exists
+void runScene (GLFWwindow* window);
 
 const unsigned int SCREEN_WIDTH = 1920, SCREEN_HEIGHT = 1080;
 
@@ -26,18 +53,76 @@ Camera camera (glm::vec3 (0.f, 0.f, 3.f));
 bool firstMouse = true;
 float lastX = SCREEN_WIDTH / 2.f, lastY = SCREEN_HEIGHT / 2.f;
 
-void renderDepthSceneComplex (Shader& shader);
-void renderDepthSceneSimple (Shader& shader);
-
-void renderFloorShadow (Shader& shader);
-void renderBackpackShadow (Shader& shader);
-void renderCubesShadow (Shader& shader);
-
-void calculateNormalMat (glm::mat4& modelMat, Shader& shader);
+// All placed objects, their model matrices are shared between the depth and the shading pass
+std::vector<SceneObject> sceneObjects;
+void setupScene ();
+// Camera culling of sceneObjects, refit every frame
+SceneBVH sceneBVH;
+
+// The simple scene is the floor with cubes, the complex one the floor with the backpack
+bool inSimpleScene (const SceneObject& object);
+bool inComplexScene (const SceneObject& object);
+void collectSceneBounds (bool (*inScene)(const SceneObject&), std::vector<AABB>& casterBounds, std::vector<AABB>& receiverBounds);
+bool consumeStaticChanges ();
+
+// Extra shadow casting spot lights, their shadows share one atlas
+std::vector<SpotLight> spotLights;
+// A ring of 12 spot lights to stress the atlas, off by default so the scene only has the main light
+const bool SPOT_LIGHT_RING = false;
+void setupSpotLights ();
+
+// Draws either only the static or only the dynamic shadow casters of the scene that pass the culler.
+// The occlusion test is only used with GPU_CULLING
+void renderDepthSceneComplex (Shader& shader, bool staticObjects, ShadowCasterCuller& culler, const OcclusionTest* occlusion = nullptr);
+void renderDepthSceneSimple (Shader& shader, bool staticObjects, ShadowCasterCuller& culler, const OcclusionTest* occlusion = nullptr);
+
+// Depth only items of the objects the shading pass draws, for the depth pre-pass
+void queueSceneDepth (Shader& shader, const std::vector<unsigned int>& visibleObjects);
+// Only queue the objects with an index in visibleObjects, drawQueue draws them sorted by state and depth
+void queueFloorShadow (Shader& shader, const std::vector<unsigned int>& visibleObjects);
+void queueBackpackShadow (Shader& shader, const std::vector<unsigned int>& visibleObjects);
+void queueCubesShadow (Shader& shader, const std::vector<unsigned int>& visibleObjects);
+
+// Queues the objects with one instanced item per geometry, their transforms come from objectBuffer.
+// Without textures (DRAW_PASS_DEPTH) only the depth matters, then the backpack meshes don't have to be split by material
+void queueObjects (const std::vector<unsigned int>& indices, Shader& shader, DrawPass pass);
+// Front to back ordering of the opaque items, the distance of the nearest object of the batch
+float nearestDistance (const std::vector<unsigned int>& indices);
+// Same for a draw group of the GPU culling, which of its objects survive is only known on the GPU, so all of them count
+float nearestGroupDistance (SceneObjectType type);
+float cameraDistance (const AABB& bounds);
+ObjectBuffer* objectBuffer;
+GeometryPool* geometryPool;
+// Quantized vertices and 16 bit indices in the pool, half the vertex bandwidth of the float layout
+const VertexFormat VERTEX_FORMAT = VERTEX_FORMAT_COMPACT;
+// Positions a second time on their own with the UV seams welded, the shadow maps and the depth pre-pass only fetch those
+const bool DEPTH_POSITION_STREAM = true;
+// Reused every pass, so collecting the objects to draw doesn't allocate
+std::vector<unsigned int> drawList, floorInstances, cubeInstances, backpackInstances;
+// Every pass submits its draws here and executes them at once, in an order that keeps program and texture switches down
+DrawQueue* drawQueue;
+unsigned int floorMaterial;
+
+// Culls every pass in a compute shader that writes the indirect commands, instead of the BVH and the caster culler on the CPU.
+// The draw groups of gpuCuller are the SceneObjectTypes, cameraPass holds the camera culling result of the current frame
+const bool GPU_CULLING = true;
+const unsigned int SIMPLE_SCENE_GROUPS = (1 << OBJECT_FLOOR) | (1 << OBJECT_CUBE);
+const unsigned int COMPLEX_SCENE_GROUPS = (1 << OBJECT_FLOOR) | (1 << OBJECT_BACKPACK);
+GpuCuller* gpuCuller;
+GpuCullPass cameraPass;
+// Only the shadow casters, either the static or the dynamic ones
+void renderDepthSceneGpu (Shader& shader, bool staticObjects, ShadowCasterCuller& culler, unsigned int groupMask, const OcclusionTest* occlusion);
+// One item per group (per material run of the backpack), the culling result only exists on the GPU, so there is no depth to sort by
+void queueGroupsGpu (Shader& shader, DrawPass pass, const GpuCullPass& cullPass, unsigned int groupMask);
 
 // TODO: maybe make a class that represents code-defined simple objects to reduce code clutter in main
-void renderFloor ();
-void renderCube ();
+GeometryRange createFloor ();
+GeometryRange createCube ();
+// vertices: interleaved position, normal, texcoords. bounds: contain all positions, they are packed relative to them, see GeometryPool::Add ()
+GeometryRange addGeometry (const float* vertices, unsigned int vertexCount, const AABB& bounds);
+GeometryRange floorGeometry, cubeGeometry;
+const AABB FLOOR_BOUNDS (glm::vec3 (-25.f, -.5f, -25.f), glm::vec3 (25.f, -.5f, 25.f));
+const AABB CUBE_BOUNDS (glm::vec3 (-1.f), glm::vec3 (1.f));
 Model* backpack;
 
 void renderQuad ();
@@ -67,57 +152,175 @@ int main ()
 		return -1;
 	}
 
+	// Shader storage buffers and base instance draws
+	if (!GLEW_VERSION_4_3) {
+		std::cout << "OpenGL 4.3 is required!" << std::endl;
+		return -1;
+	}
+
+	// Nothing is known about the fresh context yet
+	RenderState::Invalidate ();
+
 #pragma endregion
 
+	runScene (window);
+
+	glfwTerminate ();
+	return 0;
+}
+
+void runScene (GLFWwindow* window)
+{
 #pragma region Main
 
 	stbi_set_flip_vertically_on_load (true);
 
-	backpack = new Model ("Assets/Models/Backpack/backpack.obj");
+	const unsigned int MAX_SCENE_OBJECTS = 16384;
+	// Every pass appends its batches to the instance stream, it starts over in fresh storage when full
+	objectBuffer = new ObjectBuffer (MAX_SCENE_OBJECTS, 4 * MAX_SCENE_OBJECTS, VERTEX_FORMAT);
+	// All meshes share its buffers, they grow when the initial size isn't enough
+	geometryPool = new GeometryPool (*objectBuffer, 1 << 20, 1 << 21, 4096, VERTEX_FORMAT, DEPTH_POSITION_STREAM);
 
-	unsigned int depthMapFBO;
-	glGenFramebuffers (1, &depthMapFBO);
+	floorGeometry = createFloor ();
+	cubeGeometry = createCube ();
+	backpack = new Model ("Assets/Models/Backpack/backpack.obj", *geometryPool);
 
-	const unsigned int SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
+	// The compact positions of every draw group are decoded with the bounds the pool packed them with
+	objectBuffer->SetPositionBounds (OBJECT_FLOOR, floorGeometry.PositionBounds);
+	objectBuffer->SetPositionBounds (OBJECT_CUBE, cubeGeometry.PositionBounds);
+	objectBuffer->SetPositionBounds (OBJECT_BACKPACK, backpack->GetPositionBounds ());
 
-	unsigned int depthMap;
-	glGenTextures (1, &depthMap);
-	glBindTexture (GL_TEXTURE_2D, depthMap);
-	glTexImage2D (GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-	float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-	glTexParameterfv (GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+	setupScene ();
+	sceneBVH.Build (sceneObjects);
 
-	glBindFramebuffer (GL_FRAMEBUFFER, depthMapFBO);
-	glFramebufferTexture2D (GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-	glDrawBuffer (GL_NONE);
-	glReadBuffer (GL_NONE);
-	if (glCheckFramebufferStatus (GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-		std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!\n";
-	}
-	glBindFramebuffer (GL_FRAMEBUFFER, 0);
+	// Room for the commands and instances of every pass of a few frames
+	gpuCuller = new GpuCuller (*geometryPool, *objectBuffer, 16384, 64 * MAX_SCENE_OBJECTS);
+	gpuCuller->AddDrawGroup (std::vector<GeometryRange> (1, floorGeometry));
+	gpuCuller->AddDrawGroup (std::vector<GeometryRange> (1, cubeGeometry));
+	gpuCuller->AddDrawGroup (backpack->GetGeometry ());
+	gpuCuller->SetObjects (sceneObjects);
+	setupSpotLights ();
+
+	const unsigned int SHADOW_RESOLUTION = 1024;
+	const unsigned int SHADOW_CASCADES = 4;
 
+	CascadedShadowMap shadowMap (SHADOW_RESOLUTION, SHADOW_CASCADES, SPLIT_PRACTICAL, 0.75f);
 
 	Shader depthShader ("Shaders/simpleDepthShader.vts", "Shaders/simpleDepthShader.frs");
 
-	Shader shadowShaderSimple ("Shaders/shadowShader.vts", "Shaders/shadowShaderSimple.frs");
-	shadowShaderSimple.setInt ("u_ShadowMap", 1);
+	// Shadow filtering kernel is compiled into the shading shaders
+	const ShadowFilter SHADOW_FILTER = FILTER_PCF_9;
+	// Omnidirectional shadows of lightPos treated as a point light, instead of the directional cascades
+	const bool POINT_LIGHT_SHADOWS = false;
+
+	std::string shadowDefines = GetShadowFilterDefines (SHADOW_FILTER);
+	if (POINT_LIGHT_SHADOWS)
+		shadowDefines += "\n#define SHADOW_LIGHT_POINT";
+
+	Shader shadowShaderSimple ("Shaders/shadowShader.vts", "Shaders/shadowShaderSimple.frs", nullptr, shadowDefines.c_str ());
 
 	unsigned int floorTexture = loadTexture ("Assets/Textures/wall.jpg");
 	shadowShaderSimple.setInt ("u_TexDiffuse", 0);
+	// Texture units 0 and 1 are left to the materials
+	const unsigned int SHADOW_MAP_UNIT = 2;
+
+	Shader shadowShaderComplex ("Shaders/shadowShader.vts", "Shaders/shadowShaderComplex.frs", nullptr, shadowDefines.c_str ());
+
+	// The point light renders all six cube faces in one pass, the geometry shader picks the face per triangle
+	PointShadowMap* pointShadowMap = nullptr;
+	Shader* pointDepthShader = nullptr;
+	if (POINT_LIGHT_SHADOWS) {
+		pointShadowMap = new PointShadowMap (SHADOW_RESOLUTION, .1f, 25.f);
+		pointDepthShader = new Shader ("Shaders/simpleDepthShader.vts", "Shaders/pointDepthShader.frs", "Shaders/pointDepthShader.gms");
+		FrameUniforms::BindBlocks (*pointDepthShader);
+		ObjectBuffer::BindBlock (*pointDepthShader);
+	}
+	const unsigned int POINT_SHADOW_UNIT = 4;
+
+	// Spot light shadows, the atlas resolution follows from the memory budget and tiles shrink when they don't fit
+	const size_t SHADOW_ATLAS_BUDGET = 16 * 1024 * 1024;
+	ShadowAtlas shadowAtlas (SHADOW_ATLAS_BUDGET);
+	shadowShaderSimple.setUniformBlockBinding ("SpotLights", SPOT_LIGHTS_UBO_BINDING);
+	shadowShaderComplex.setUniformBlockBinding ("SpotLights", SPOT_LIGHTS_UBO_BINDING);
+	const unsigned int SHADOW_ATLAS_UNIT = 5;
+
+	// VSM/EVSM need the moments of the cascades and the blur passes that create them
+	ShadowMoments* shadowMoments = nullptr;
+	Shader* momentsBlurHorizontal = nullptr;
+	Shader* momentsBlurVertical = nullptr;
+	if (IsMomentShadowFilter (SHADOW_FILTER) && !POINT_LIGHT_SHADOWS) {
+		shadowMoments = new ShadowMoments (shadowMap, SHADOW_FILTER);
+		momentsBlurHorizontal = new Shader ("Shaders/debugQuad.vts", "Shaders/shadowMomentsBlur.frs", nullptr, ShadowMoments::GetBlurDefines (SHADOW_FILTER, true));
+		momentsBlurVertical = new Shader ("Shaders/debugQuad.vts", "Shaders/shadowMomentsBlur.frs", nullptr, ShadowMoments::GetBlurDefines (SHADOW_FILTER, false));
+	}
+	const unsigned int SHADOW_MOMENTS_UNIT = 3;
+
+	// The window can be resized, everything sized to the screen follows the framebuffer
+	int framebufferWidth, framebufferHeight;
+	glfwGetFramebufferSize (window, &framebufferWidth, &framebufferHeight);
+
+	// Two phase occlusion culling of the camera view: first the objects that were visible last frame, then the rest
+	// against a Hi-Z pyramid of their depth. Needs the GPU culling. The camera view goes to a framebuffer of our own,
+	// the pyramid copies its depth and the default framebuffer can have any depth format
+	const bool OCCLUSION_CULLING = GPU_CULLING;
+	HiZPyramid* cameraHiZ = nullptr;
+	SceneFramebuffer* sceneFramebuffer = nullptr;
+	if (OCCLUSION_CULLING) {
+		cameraHiZ = new HiZPyramid (framebufferWidth, framebufferHeight);
+		sceneFramebuffer = new SceneFramebuffer (framebufferWidth, framebufferHeight);
+	}
+
+	// Dynamic casters hidden behind the static casters of a cascade (from the light) don't add any shadow.
+	// One pyramid per cascade, rebuilt together with the static cache
+	const bool SHADOW_OCCLUSION_CULLING = GPU_CULLING && !POINT_LIGHT_SHADOWS;
+	std::vector<HiZPyramid*> cascadeHiZ;
+	if (SHADOW_OCCLUSION_CULLING) {
+		for (unsigned int cascade = 0; cascade < shadowMap.CascadeCount; cascade++)
+			cascadeHiZ.push_back (new HiZPyramid (SHADOW_RESOLUTION, SHADOW_RESOLUTION));
+	}
 
-	Shader shadowShaderComplex ("Shaders/shadowShader.vts", "Shaders/shadowShaderComplex.frs");
-	shadowShaderComplex.setInt ("u_ShadowMap", 2);
+	// One cascade of the shadow map in the corner of the screen. The cascades are set up for hardware comparison,
+	// the sampler reads the raw depth instead
+	const bool SHOW_DEBUG_QUAD = false;
+	const int DEBUG_QUAD_CASCADE = 0;
+	const unsigned int DEBUG_QUAD_UNIT = 6;
+	const UniformKey DEBUG_QUAD_LAYER ("u_Layer");
+	Shader debugQuadShader ("Shaders/debugQuad.vts", "Shaders/debugQuad.frs");
+	debugQuadShader.use ();
+	debugQuadShader.setInt ("u_DepthMap", DEBUG_QUAD_UNIT);
+	unsigned int debugQuadSampler;
+	glGenSamplers (1, &debugQuadSampler);
+	glSamplerParameteri (debugQuadSampler, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+	glSamplerParameteri (debugQuadSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glSamplerParameteri (debugQuadSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	// Schedules the passes of every frame, keeps the transient textures between the frames
+	RenderGraph renderGraph;
+
+	// Lays down the camera depth before the shading pass, which then only shades the visible fragment of every pixel.
+	// Costs another pass over the geometry, so the estimator only turns it on while the measured overdraw is high
+	const bool DEPTH_PREPASS = true;
+	Shader prepassShader ("Shaders/simpleDepthShader.vts", "Shaders/simpleDepthShader.frs", nullptr, "#define CAMERA_DEPTH");
+	OverdrawEstimator overdrawEstimator (framebufferWidth * framebufferHeight, 1.6f, 1.3f);
+	GpuCullPass cameraPhasePasses[2] = {};
+
+	// Camera, light and shadow view matrices shared by all programs, uploaded once per frame
+	FrameUniforms frameUniforms (1 + MAX_CASCADES + MAX_SPOT_LIGHTS);
+	FrameUniforms::BindBlocks (depthShader);
+	FrameUniforms::BindBlocks (prepassShader);
+	FrameUniforms::BindBlocks (shadowShaderSimple);
+	FrameUniforms::BindBlocks (shadowShaderComplex);
+	ObjectBuffer::BindBlock (depthShader);
+	ObjectBuffer::BindBlock (prepassShader);
+	ObjectBuffer::BindBlock (shadowShaderSimple);
+	ObjectBuffer::BindBlock (shadowShaderComplex);
 
 #pragma endregion
 
 #pragma region RenderLoop
 
-	glEnable (GL_DEPTH_TEST);
-	glEnable (GL_CULL_FACE);
+	RenderState::SetEnabled (GL_DEPTH_TEST, true);
+	RenderState::SetEnabled (GL_CULL_FACE, true);
 
 	// input
 	glfwSetInputMode (window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -125,6 +328,23 @@ int main ()
 	glfwSetScrollCallback (window, scrollCallback);
 
 	glm::vec3 lightPos (-2.f, 4.f, -1.f);
+	// the light is treated as directional, pointing from its position towards the origin
+	glm::vec3 lightDir = glm::normalize (-lightPos);
+
+	const float CAMERA_NEAR = .1f, CAMERA_FAR = 100.f;
+
+	// Depth buckets of the front to back sorting span the camera range
+	drawQueue = new DrawQueue (*geometryPool, CAMERA_FAR);
+	floorMaterial = drawQueue->AddMaterial (floorTexture);
+	backpack->AddMaterials (*drawQueue);
+
+	std::vector<AABB> casterBounds, receiverBounds;
+	// Skips casters whose shadow can't end up on screen, for every cascade, atlas tile and the point light
+	ShadowCasterCuller casterCuller;
+	std::vector<unsigned int> visibleObjects;
+
+	// Culling results are shown in the window title, updated once per second
+	float lastStatsTime = 0.f;
 
 	/* Loop until the user closes the window */
 	while (!glfwWindowShouldClose (window)) {
@@ -138,38 +358,196 @@ int main ()
 		// Input
 		processInput (window);
 
-#pragma region FirstPass
-
-		glBindFramebuffer (GL_FRAMEBUFFER, depthMapFBO);
-		glViewport (0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-		glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		// Configure shaders and matrices
-		depthShader.use ();
-
-		float near_plane = 1.0f, far_plane = 7.5f;
-		glm::mat4 lightOrthoProjection = glm::ortho (-10.f, 10.f, -10.f, 10.f, near_plane, far_plane);
-
-		glm::mat4 lightView = glm::lookAt (lightPos,
-			glm::vec3 (0.f),
-			glm::vec3 (0.f, 1.f, 0.f));
-
-		glm::mat4 lightSpaceMatrix = lightOrthoProjection * lightView;
-
-		depthShader.setMatrix4 ("u_LightSpaceMatrix", lightSpaceMatrix);
+		// A minimized window has no framebuffer to draw to
+		glfwGetFramebufferSize (window, &framebufferWidth, &framebufferHeight);
+		if (framebufferWidth == 0 || framebufferHeight == 0) {
+			glfwPollEvents ();
+			continue;
+		}
+		if (cameraHiZ) {
+			cameraHiZ->Resize (framebufferWidth, framebufferHeight);
+			sceneFramebuffer->Resize (framebufferWidth, framebufferHeight);
+		}
+		overdrawEstimator.SetPixelCount (framebufferWidth * framebufferHeight);
 
-		glClear (GL_DEPTH_BUFFER_BIT);
-		glActiveTexture (GL_TEXTURE0);
-		glBindTexture (GL_TEXTURE_2D, floorTexture);
-
-		//renderDepthSceneComplex (depthShader);
+#pragma region FirstPass
 
-		glCullFace (GL_FRONT);
-		renderDepthSceneSimple (depthShader);
-		glCullFace (GL_BACK);
+		float aspect = framebufferWidth / (float)framebufferHeight;
+
+		// Fit the cascades to what is actually in the scene (use inComplexScene together with renderDepthSceneComplex)
+		collectSceneBounds (inSimpleScene, casterBounds, receiverBounds);
+
+		// Moved objects update their BVH nodes and transforms, has to happen before consumeStaticChanges () clears the dirty flags
+		sceneBVH.Refit (sceneObjects);
+		objectBuffer->Update (sceneObjects);
+		objectBuffer->BindForReading ();
+		bool staticChanged = consumeStaticChanges ();
+
+		Frustum cameraFrustum = camera.GetFrustum (aspect, CAMERA_NEAR, CAMERA_FAR);
+		if (!GPU_CULLING)
+			sceneBVH.Cull (cameraFrustum, visibleObjects);
+
+		casterCuller.SetVisibleReceivers (receiverBounds, cameraFrustum);
+		casterCuller.ResetStats ();
+		gpuCuller->ResetStats ();
+		drawQueue->ResetStats ();
+		RenderState::ResetStats ();
+
+		// All shadow views have to be known before the upload
+		if (pointShadowMap)
+			pointShadowMap->Update (lightPos);
+		else
+			shadowMap.Update (camera, aspect, CAMERA_NEAR, CAMERA_FAR, lightDir, casterBounds, receiverBounds);
+		shadowAtlas.Update (spotLights, camera);
+
+		frameUniforms.SetCamera (camera.GetViewMatrix (), camera.GetProjectionMatrix (aspect, CAMERA_NEAR, CAMERA_FAR), camera.Position);
+		frameUniforms.SetLight (lightPos);
+		// The light block holds everything the shading and the point light depth shaders need, instead of uniforms on every program
+		frameUniforms.SetCascades (shadowMap.LightSpaceMatrices.data (), shadowMap.CascadeSplits.data (), shadowMap.CascadeCount);
+		if (pointShadowMap)
+			frameUniforms.SetPointShadow (pointShadowMap->FaceMatrices, pointShadowMap->FarPlane);
+
+		frameUniforms.ClearViews ();
+		// simpleDepthShader.vts only has to output world space positions for the point light, the geometry shader projects them
+		unsigned int pointView = frameUniforms.AddView (glm::mat4 (1.f));
+		unsigned int firstCascadeView = pointView + 1;
+		for (unsigned int cascade = 0; cascade < shadowMap.CascadeCount; cascade++)
+			frameUniforms.AddView (shadowMap.LightSpaceMatrices[cascade]);
+		unsigned int firstTileView = firstCascadeView + shadowMap.CascadeCount;
+		for (unsigned int light = 0; light < shadowAtlas.Tiles.size (); light++)
+			frameUniforms.AddView (shadowAtlas.Tiles[light].LightSpaceMatrix);
+
+		frameUniforms.Upload ();
+
+		// The passes of the frame and the resources they read and write. The graph binds and clears the targets,
+		// the shadow maps are imported and bound by their own passes
+		renderGraph.Reset ();
+		RenderResource backbuffer = renderGraph.ImportBackbuffer (framebufferWidth, framebufferHeight);
+		RenderResource lightShadows = renderGraph.Import ("LightShadows", pointShadowMap ? pointShadowMap->DepthCubeMap : shadowMap.DepthMapArray);
+		RenderResource spotShadows = renderGraph.Import ("SpotShadows", shadowAtlas.DepthMap);
+
+		unsigned int lightShadowPass = renderGraph.AddPass ("LightShadows", [&] () {
+			if (pointShadowMap) {
+				// Single layered pass into all six faces
+				pointShadowMap->BindForWriting ();
+				glClear (GL_DEPTH_BUFFER_BIT);
+
+				pointDepthShader->use ();
+				frameUniforms.BindView (pointView);
+
+				casterCuller.BeginSphere (pointShadowMap->LightPos, pointShadowMap->FarPlane);
+
+				//renderDepthSceneComplex (*pointDepthShader, true, casterCuller);
+				//renderDepthSceneComplex (*pointDepthShader, false, casterCuller);
+
+				renderDepthSceneSimple (*pointDepthShader, true, casterCuller);
+				renderDepthSceneSimple (*pointDepthShader, false, casterCuller);
+			}
+			else {
+				// A static object moved, every cascade has to redraw its static casters
+				if (staticChanged)
+					shadowMap.InvalidateStaticCache ();
+
+				// Configure shaders and matrices
+				depthShader.use ();
+
+				RenderState::CullFace (GL_FRONT);
+				// Dynamic casters aren't part of the fitted bounds, clamp instead of clipping them when they are closer to the light than the near plane
+				RenderState::SetEnabled (GL_DEPTH_CLAMP, true);
+				for (unsigned int cascade = 0; cascade < shadowMap.CascadeCount; cascade++) {
+					frameUniforms.BindView (firstCascadeView + cascade);
+
+					// Only redrawn when the cascade moved or the cache got invalidated
+					if (shadowMap.BindStaticForWriting (cascade)) {
+						// The cache outlives the current camera, so only cull against the cascade itself and not the visible receivers
+						casterCuller.BeginOrthographic (shadowMap.LightSpaceMatrices[cascade], false);
+
+						//renderDepthSceneComplex (depthShader, true, casterCuller);
+
+						renderDepthSceneSimple (depthShader, true, casterCuller);
+
+						if (SHADOW_OCCLUSION_CULLING)
+							cascadeHiZ[cascade]->BuildFromDepthLayer (shadowMap.StaticDepthMapArray, cascade);
+					}
+
+					// Starts out as a copy of the static cache
+					shadowMap.BindForWriting (cascade);
+
+					casterCuller.BeginOrthographic (shadowMap.LightSpaceMatrices[cascade], true);
+
+					OcclusionTest cascadeOcclusion (OCCLUSION_SINGLE, SHADOW_OCCLUSION_CULLING ? cascadeHiZ[cascade] : nullptr, shadowMap.LightSpaceMatrices[cascade]);
+					const OcclusionTest* casterOcclusion = SHADOW_OCCLUSION_CULLING ? &cascadeOcclusion : nullptr;
+
+					//renderDepthSceneComplex (depthShader, false, casterCuller, casterOcclusion);
+
+					renderDepthSceneSimple (depthShader, false, casterCuller, casterOcclusion);
+				}
+				RenderState::SetEnabled (GL_DEPTH_CLAMP, false);
+				RenderState::CullFace (GL_BACK);
+			}
+		});
+		lightShadows = renderGraph.Write (lightShadowPass, lightShadows);
+
+		// VSM/EVSM: turn every cascade into moments with a separable blur, then mipmap them for the lookups.
+		// Every cascade has its own blur texture, the graph aliases them to one
+		RenderResource moments = RenderGraph::NO_RESOURCE;
+		if (shadowMoments) {
+			moments = renderGraph.Import ("ShadowMoments", shadowMoments->MomentsArray);
+			RenderTextureDesc blurDesc (shadowMoments->Resolution, shadowMoments->Resolution, shadowMoments->InternalFormat);
+
+			for (unsigned int cascade = 0; cascade < shadowMap.CascadeCount; cascade++) {
+				RenderResource blur = renderGraph.CreateTexture ("MomentsBlur", blurDesc);
+
+				unsigned int horizontalPass = renderGraph.AddPass ("MomentsBlurHorizontal", [&, cascade] () {
+					RenderState::SetEnabled (GL_DEPTH_TEST, false);
+					shadowMoments->BindHorizontalPass (*momentsBlurHorizontal, shadowMap, cascade, SHADOW_MOMENTS_UNIT);
+					renderQuad ();
+				});
+				renderGraph.Read (horizontalPass, lightShadows);
+				blur = renderGraph.SetTarget (horizontalPass, blur);
+
+				unsigned int verticalPass = renderGraph.AddPass ("MomentsBlurVertical", [&, cascade, blur] () {
+					shadowMoments->BindVerticalPass (*momentsBlurVertical, renderGraph.GetTexture (blur), cascade, SHADOW_MOMENTS_UNIT);
+					renderQuad ();
+					RenderState::SetEnabled (GL_DEPTH_TEST, true);
+				});
+				renderGraph.Read (verticalPass, blur);
+				moments = renderGraph.Write (verticalPass, moments);
+			}
+
+			unsigned int mipmapPass = renderGraph.AddPass ("MomentsMipmaps", [&] () {
+				shadowMoments->GenerateMipmaps ();
+			});
+			moments = renderGraph.Write (mipmapPass, moments);
+		}
+
+		unsigned int spotShadowPass = renderGraph.AddPass ("SpotShadows", [&] () {
+			// Spot lights: one FBO, every light only changes viewport and scissor
+			depthShader.use ();
+			RenderState::CullFace (GL_FRONT);
+			for (unsigned int light = 0; light < shadowAtlas.Tiles.size (); light++) {
+				if (shadowAtlas.Tiles[light].Size == 0)
+					continue;
+
+				shadowAtlas.BindTileForWriting (light);
+				frameUniforms.BindView (firstTileView + light);
+
+				casterCuller.BeginPerspective (shadowAtlas.Tiles[light].LightSpaceMatrix);
+
+				//renderDepthSceneComplex (depthShader, true, casterCuller);
+				//renderDepthSceneComplex (depthShader, false, casterCuller);
+
+				renderDepthSceneSimple (depthShader, true, casterCuller);
+				renderDepthSceneSimple (depthShader, false, casterCuller);
+			}
+			shadowAtlas.FinishWriting ();
+			RenderState::CullFace (GL_BACK);
+		});
+		spotShadows = renderGraph.Write (spotShadowPass, spotShadows);
 
 		/* If you want cubes instead of backpack
-		renderDepthSceneSimple (depthShader);
+		renderDepthSceneSimple (depthShader, true, casterCuller);
+		renderDepthSceneSimple (depthShader, false, casterCuller);
 		*/
 
 #pragma endregion
@@ -177,58 +555,167 @@ int main ()
 
 #pragma region SecondPass
 
-		glBindFramebuffer (GL_FRAMEBUFFER, 0);
-		glViewport (0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
-		glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		// Configure shader and matrices
-
-		// View matrix
-		glm::mat4 view = camera.GetViewMatrix ();
-		// Projection matrix
-		glm::mat4 projection = glm::perspective (glm::radians (camera.Zoom), SCREEN_WIDTH / (float)SCREEN_HEIGHT, .1f, 100.f);
-
-		shadowShaderSimple.use ();
-
-		glActiveTexture (GL_TEXTURE0);
-		glBindTexture (GL_TEXTURE_2D, floorTexture);
-		glActiveTexture (GL_TEXTURE1);
-		glBindTexture (GL_TEXTURE_2D, depthMap);
-
-		shadowShaderSimple.setMatrix4 ("u_LightSpaceMatrix", lightSpaceMatrix);
-		shadowShaderSimple.setVec3 ("u_LightPos", lightPos);
-
-		shadowShaderSimple.setMatrix4 ("u_Proj", projection);
-		shadowShaderSimple.setMatrix4 ("u_View", view);
-		shadowShaderSimple.setVec3 ("u_ViewPos", camera.Position);
-
-		renderFloorShadow (shadowShaderSimple);
-		
-		renderCubesShadow (shadowShaderSimple);
-
-		/* If you want cubes instead of backpack
-		renderCubesShadow (shadowShaderSimple);
-		*/
+		// With occlusion culling the scene is drawn twice: the objects visible last frame, then the ones
+		// that turn out visible against the depth of the first phase. The first pass that writes the camera depth culls
+		// and builds the Hi-Z pyramid, the shading pass after a pre-pass reuses its results
+		glm::mat4 cameraViewProjection = camera.GetProjectionMatrix (aspect, CAMERA_NEAR, CAMERA_FAR) * camera.GetViewMatrix ();
+		unsigned int shadingPhases = cameraHiZ ? 2 : 1;
+		bool depthPrepass = DEPTH_PREPASS && overdrawEstimator.PrepassEnabled;
+
+		// One culling pass for all groups, the draws pick their group out of it
+		auto cullCameraPhase = [&] (unsigned int phase) {
+			if (!GPU_CULLING)
+				return;
+
+			OcclusionTest cameraOcclusion (phase == 0 ? OCCLUSION_FIRST_PHASE : OCCLUSION_SECOND_PHASE, cameraHiZ, cameraViewProjection);
+			cameraPhasePasses[phase] = gpuCuller->Cull (CullVolume (cameraFrustum), SIMPLE_SCENE_GROUPS | COMPLEX_SCENE_GROUPS, 0, 0,
+				cameraHiZ ? &cameraOcclusion : nullptr);
+		};
 
+		// With occlusion culling the camera view is drawn into sceneFramebuffer and copied to the backbuffer at the end
+		RenderResource sceneTarget = sceneFramebuffer
+			? renderGraph.ImportFramebuffer ("Scene", sceneFramebuffer->FBO, framebufferWidth, framebufferHeight) : backbuffer;
+		RenderResource sceneDepth = sceneTarget;
+		if (depthPrepass) {
+			unsigned int prepassPass = renderGraph.AddPass ("DepthPrepass", [&] () {
+				// The depth shader has no color output
+				RenderState::ColorMask (false);
+				for (unsigned int phase = 0; phase < shadingPhases; phase++) {
+					cullCameraPhase (phase);
+					cameraPass = cameraPhasePasses[phase];
+
+					queueSceneDepth (prepassShader, visibleObjects);
+					overdrawEstimator.Begin ();
+					drawQueue->Execute (DRAW_PASS_DEPTH);
+					overdrawEstimator.End ();
+
+					if (phase == 0 && cameraHiZ)
+						cameraHiZ->BuildFromFramebuffer (sceneFramebuffer->FBO);
+				}
+				RenderState::ColorMask (true);
+			});
+			sceneDepth = renderGraph.SetTarget (prepassPass, sceneTarget);
+		}
+
+		unsigned int shadingPass = renderGraph.AddPass ("Shading", [&] () {
+			// The depth is final already, only the fragment that ends up visible gets shaded
+			if (depthPrepass) {
+				RenderState::DepthFunc (GL_EQUAL);
+				RenderState::DepthMask (false);
+			}
+
+			// Configure shaders, the camera and light matrices come from frameUniforms. Both share the shadow texture units,
+			// so the queue can switch between them without binding anything but the materials. Bound once for both phases,
+			// the culling in between doesn't touch the shadow units
+			shadowShaderSimple.use ();
+
+			shadowMap.BindForReading (shadowShaderSimple, SHADOW_MAP_UNIT);
+			if (pointShadowMap)
+				pointShadowMap->BindForReading (shadowShaderSimple, POINT_SHADOW_UNIT);
+			shadowAtlas.BindForReading (shadowShaderSimple, SHADOW_ATLAS_UNIT);
+			if (shadowMoments)
+				shadowMoments->BindForReading (shadowShaderSimple, SHADOW_MOMENTS_UNIT);
+
+			shadowShaderComplex.use ();
+
+			shadowMap.BindForReading (shadowShaderComplex, SHADOW_MAP_UNIT);
+			if (pointShadowMap)
+				pointShadowMap->BindForReading (shadowShaderComplex, POINT_SHADOW_UNIT);
+			shadowAtlas.BindForReading (shadowShaderComplex, SHADOW_ATLAS_UNIT);
+			if (shadowMoments)
+				shadowMoments->BindForReading (shadowShaderComplex, SHADOW_MOMENTS_UNIT);
+
+			for (unsigned int phase = 0; phase < shadingPhases; phase++) {
+				if (!depthPrepass)
+					cullCameraPhase (phase);
+				cameraPass = cameraPhasePasses[phase];
+
+				queueFloorShadow (shadowShaderSimple, visibleObjects);
 		
-		shadowShaderComplex.use ();
-
-		glActiveTexture (GL_TEXTURE2);
-		glBindTexture (GL_TEXTURE_2D, depthMap);
-
-		// TODO: Use UBO's
-
-		shadowShaderComplex.setMatrix4 ("u_LightSpaceMatrix", lightSpaceMatrix);
-		shadowShaderComplex.setVec3 ("u_LightPos", lightPos);
-
-		shadowShaderComplex.setMatrix4 ("u_Proj", projection);
-		shadowShaderComplex.setMatrix4 ("u_View", view);
-		shadowShaderComplex.setVec3 ("u_ViewPos", camera.Position);
-
-		//renderBackpackShadow (shadowShaderComplex);
+				queueCubesShadow (shadowShaderSimple, visibleObjects);
+
+				/* If you want cubes instead of backpack
+				queueCubesShadow (shadowShaderSimple, visibleObjects);
+				*/
+
+				//queueBackpackShadow (shadowShaderComplex, visibleObjects);
+
+				if (depthPrepass)
+					drawQueue->Execute (DRAW_PASS_OPAQUE);
+				else {
+					overdrawEstimator.Begin ();
+					drawQueue->Execute (DRAW_PASS_OPAQUE);
+					overdrawEstimator.End ();
+				}
+
+				if (phase == 0 && cameraHiZ && !depthPrepass)
+					cameraHiZ->BuildFromFramebuffer (sceneFramebuffer->FBO);
+			}
+
+			RenderState::DepthFunc (GL_LESS);
+			RenderState::DepthMask (true);
+		});
+		renderGraph.Read (shadingPass, lightShadows);
+		renderGraph.Read (shadingPass, spotShadows);
+		if (shadowMoments)
+			renderGraph.Read (shadingPass, moments);
+		RenderResource sceneColor = renderGraph.SetTarget (shadingPass, sceneDepth);
+
+		// One cascade in the corner of the screen, culled by the graph when it isn't shown
+		unsigned int debugQuadPass = renderGraph.AddPass ("DebugQuad", [&] () {
+			RenderState::SetEnabled (GL_DEPTH_TEST, false);
+			debugQuadShader.use ();
+			RenderState::BindTexture (DEBUG_QUAD_UNIT, GL_TEXTURE_2D_ARRAY, shadowMap.DepthMapArray);
+			RenderState::BindSampler (DEBUG_QUAD_UNIT, debugQuadSampler);
+			debugQuadShader.setInt (DEBUG_QUAD_LAYER, DEBUG_QUAD_CASCADE);
+			renderQuad ();
+			RenderState::SetEnabled (GL_DEPTH_TEST, true);
+		});
+		renderGraph.Read (debugQuadPass, lightShadows);
+		RenderResource debugColor = renderGraph.SetTarget (debugQuadPass, sceneColor);
+		renderGraph.SetViewport (debugQuadPass, 0, 0, framebufferWidth / 4, framebufferHeight / 4);
+
+		// The point light has no cascades to show
+		RenderResource finalColor = SHOW_DEBUG_QUAD && !pointShadowMap ? debugColor : sceneColor;
+		if (sceneFramebuffer) {
+			// Copies the color of the camera view, the pass binds both framebuffers itself
+			unsigned int presentPass = renderGraph.AddPass ("Present", [&] () {
+				sceneFramebuffer->Present ();
+			});
+			renderGraph.Read (presentPass, finalColor);
+			finalColor = renderGraph.Write (presentPass, backbuffer);
+		}
+		renderGraph.SetOutput (finalColor);
+		renderGraph.Execute ();
+		overdrawEstimator.EndFrame ();
 
 #pragma endregion
 
+		if (currentFrame - lastStatsTime >= 1.f) {
+			lastStatsTime = currentFrame;
+
+			std::string title;
+			// The GPU results stay on the GPU, reading them back would stall
+			if (GPU_CULLING)
+				title = "Shadows | GPU culling: " + std::to_string (gpuCuller->PassCount) + " passes, "
+					+ std::to_string (gpuCuller->ObjectsTested) + " objects tested"
+					+ (cameraHiZ ? " | Hi-Z occlusion culling" : "");
+			else
+				title = "Shadows | objects visible: " + std::to_string (sceneBVH.Stats.ObjectsVisible)
+					+ " culled: " + std::to_string (sceneBVH.Stats.ObjectsCulled)
+					+ " (" + std::to_string (sceneBVH.Stats.NodesTested) + " nodes, " + std::to_string (sceneBVH.Stats.ObjectsTested) + " objects tested)"
+					+ " | shadow casters culled: " + std::to_string (casterCuller.CulledCount) + "/" + std::to_string (casterCuller.TestedCount);
+			// Only the current frame so far, the counters are reset at its start
+			title += " | draw queue: " + std::to_string (drawQueue->ItemCount) + " items in " + std::to_string (drawQueue->BatchCount) + " batches, "
+				+ std::to_string (drawQueue->ProgramSwitches) + " program, " + std::to_string (drawQueue->MaterialSwitches) + " material, "
+				+ std::to_string (drawQueue->VertexArraySwitches) + " VAO switches";
+			title += " | render graph: " + std::to_string (renderGraph.PassCount) + " passes, " + std::to_string (renderGraph.CulledPassCount) + " culled, "
+				+ std::to_string (renderGraph.AllocatedBytes / 1024) + "/" + std::to_string (renderGraph.TransientBytes / 1024) + " KB transient";
+			title += " | overdraw: " + std::to_string (overdrawEstimator.Overdraw).substr (0, 4) + (depthPrepass ? " (depth pre-pass)" : "");
+			title += " | state changes: " + std::to_string (RenderState::IssuedCount) + " issued, " + std::to_string (RenderState::ElidedCount) + " elided";
+			glfwSetWindowTitle (window, title.c_str ());
+		}
+
 
 		/* Swap front and back buffers */
 		glfwSwapBuffers (window);
@@ -238,246 +725,415 @@ int main ()
 
 #pragma endregion
 
+	delete cameraHiZ;
+	delete sceneFramebuffer;
+	for (HiZPyramid* pyramid : cascadeHiZ)
+		delete pyramid;
+	glDeleteSamplers (1, &debugQuadSampler);
+	delete drawQueue;
+	delete gpuCuller;
 	delete backpack;
+	delete geometryPool;
+	delete objectBuffer;
 
-	glfwTerminate ();
-	return 0;
-}
-
-void renderDepthSceneComplex (Shader& shader)
-{
-	// floor
-	glm::mat4 model = glm::mat4 (1.f);
-	shader.setMatrix4 ("u_Model", model);
-	renderFloor ();
+	delete shadowMoments;
+	delete momentsBlurHorizontal;
+	delete momentsBlurVertical;
 
-	// backpack(s)
-	model = glm::mat4 (1.f);
-	model = glm::translate (model, glm::vec3 (0.0f, 1.f, 0.0f));
-	model = glm::scale (model, glm::vec3 (0.5f));
-	shader.setMatrix4 ("u_Model", model);
-	backpack->Draw (shader);
-
-
-	//// cubes
-	//model = glm::mat4 (1.0f);
-	//model = glm::translate (model, glm::vec3 (0.0f, 1.5f, 0.0));
-	//model = glm::scale (model, glm::vec3 (0.5f));
-	//shader.setMatrix4 ("u_Model", model);
-	//renderCube ();
-	//model = glm::mat4 (1.0f);
-	//model = glm::translate (model, glm::vec3 (2.0f, 0.0f, 1.0));
-	//model = glm::scale (model, glm::vec3 (0.5f));
-	//shader.setMatrix4 ("u_Model", model);
-	//renderCube ();
-	//model = glm::mat4 (1.0f);
-	//model = glm::translate (model, glm::vec3 (-1.0f, 0.0f, 2.0));
-	//model = glm::rotate (model, glm::radians (60.0f), glm::normalize (glm::vec3 (1.0, 0.0, 1.0)));
-	//model = glm::scale (model, glm::vec3 (0.25));
-	//shader.setMatrix4 ("u_Model", model);
-	//renderCube ();
+	delete pointShadowMap;
+	delete pointDepthShader;
 }
 
-void renderDepthSceneSimple (Shader& shader)
+void setupScene ()
 {
 	// floor
-	glm::mat4 model = glm::mat4 (1.f);
-	shader.setMatrix4 ("u_Model", model);
-	renderFloor ();
+	sceneObjects.push_back (SceneObject (OBJECT_FLOOR, FLOOR_BOUNDS));
 
 	// cubes
-	model = glm::mat4 (1.0f);
+	glm::mat4 model = glm::mat4 (1.0f);
 	model = glm::translate (model, glm::vec3 (0.0f, 1.5f, 0.0));
 	model = glm::scale (model, glm::vec3 (0.5f));
-	shader.setMatrix4 ("u_Model", model);
-	renderCube ();
+	sceneObjects.push_back (SceneObject (OBJECT_CUBE, CUBE_BOUNDS, model));
+
 	model = glm::mat4 (1.0f);
 	model = glm::translate (model, glm::vec3 (2.0f, 0.0f, 1.0));
 	model = glm::scale (model, glm::vec3 (0.5f));
-	shader.setMatrix4 ("u_Model", model);
-	renderCube ();
+	sceneObjects.push_back (SceneObject (OBJECT_CUBE, CUBE_BOUNDS, model));
+
 	model = glm::mat4 (1.0f);
 	model = glm::translate (model, glm::vec3 (-1.0f, 0.0f, 2.0));
 	model = glm::rotate (model, glm::radians (60.0f), glm::normalize (glm::vec3 (1.0, 0.0, 1.0)));
 	model = glm::scale (model, glm::vec3 (0.25));
-	shader.setMatrix4 ("u_Model", model);
-	renderCube ();
+	sceneObjects.push_back (SceneObject (OBJECT_CUBE, CUBE_BOUNDS, model));
+
+	// backpack(s)
+	model = glm::mat4 (1.f);
+	model = glm::translate (model, glm::vec3 (0.0f, 1.f, 0.0f));
+	model = glm::scale (model, glm::vec3 (0.5f));
+	sceneObjects.push_back (SceneObject (OBJECT_BACKPACK, backpack->Bounds, model));
 }
 
-void renderFloorShadow (Shader& shader)
+void setupSpotLights ()
 {
-	glm::mat4 model = glm::mat4 (1.f);
-	shader.setMatrix4 ("u_Model", model);
+	if (!SPOT_LIGHT_RING)
+		return;
+
+	// a ring of colored lights around the cubes, all pointing down at the center
+	const unsigned int LIGHT_COUNT = 12;
+	const float RING_RADIUS = 6.f, RING_HEIGHT = 3.f;
+
+	for (unsigned int i = 0; i < LIGHT_COUNT; i++) {
+		float angle = glm::two_pi<float> () * i / LIGHT_COUNT;
+
+		SpotLight light;
+		light.Position = glm::vec3 (std::cos (angle) * RING_RADIUS, RING_HEIGHT, std::sin (angle) * RING_RADIUS);
+		light.Direction = glm::normalize (glm::vec3 (0.f, -.5f, 0.f) - light.Position);
+		light.Color = .4f * glm::vec3 (.5f + .5f * std::cos (angle), .5f + .5f * std::cos (angle + 2.f), .5f + .5f * std::cos (angle + 4.f));
+		light.OuterCone = 30.f;
+		light.Range = 12.f;
+		light.Importance = 1.f;
+		spotLights.push_back (light);
+	}
+}
 
-	calculateNormalMat (model, shader);
+bool inSimpleScene (const SceneObject& object)
+{
+	return object.Type != OBJECT_BACKPACK;
+}
 
-	renderFloor ();
+bool inComplexScene (const SceneObject& object)
+{
+	return object.Type != OBJECT_CUBE;
 }
 
-void renderBackpackShadow (Shader& shader)
+void collectSceneBounds (bool (*inScene)(const SceneObject&), std::vector<AABB>& casterBounds, std::vector<AABB>& receiverBounds)
 {
-	glm::mat4 model = glm::mat4 (1.f);
-	model = glm::translate (model, glm::vec3 (0.0f, 1.f, 0.0f));
-	model = glm::scale (model, glm::vec3 (0.5f));
-	shader.setMatrix4 ("u_Model", model);
+	casterBounds.clear ();
+	receiverBounds.clear ();
 
-	calculateNormalMat (model, shader);
+	for (const SceneObject& object : sceneObjects) {
+		if (!inScene (object))
+			continue;
 
-	backpack->Draw (shader);
+		// Only static casters, so a moving object doesn't move the cascades and invalidate the static shadow cache every frame
+		if (object.CastsShadow () && object.IsStatic ())
+			casterBounds.push_back (object.GetWorldBounds ());
+		receiverBounds.push_back (object.GetWorldBounds ());
+	}
 }
 
-void renderCubesShadow (Shader& shader)
+bool consumeStaticChanges ()
 {
-	glm::mat4 model = glm::mat4 (1.0f);
-	model = glm::translate (model, glm::vec3 (0.0f, 1.5f, 0.0));
-	model = glm::scale (model, glm::vec3 (0.5f));
-	shader.setMatrix4 ("u_Model", model);
-	calculateNormalMat (model, shader);
-	renderCube ();
+	bool changed = false;
 
-	model = glm::mat4 (1.0f);
-	model = glm::translate (model, glm::vec3 (2.0f, 0.0f, 1.0));
-	model = glm::scale (model, glm::vec3 (0.5f));
-	shader.setMatrix4 ("u_Model", model);
-	calculateNormalMat (model, shader);
-	renderCube ();
+	for (SceneObject& object : sceneObjects) {
+		// A dynamic object that just became static also has to end up in the cache, one that stopped being static has to leave it
+		if (object.IsDirty () && (object.IsStatic () || object.WasStatic ()))
+			changed = true;
 
-	model = glm::mat4 (1.0f);
-	model = glm::translate (model, glm::vec3 (-1.0f, 0.0f, 2.0));
-	model = glm::rotate (model, glm::radians (60.0f), glm::normalize (glm::vec3 (1.0, 0.0, 1.0)));
-	model = glm::scale (model, glm::vec3 (0.25));
-	shader.setMatrix4 ("u_Model", model);
-	calculateNormalMat (model, shader);
-	renderCube ();
+		object.ClearDirty ();
+	}
+
+	return changed;
 }
 
-void calculateNormalMat (glm::mat4& modelMat, Shader& shader)
+void renderDepthSceneComplex (Shader& shader, bool staticObjects, ShadowCasterCuller& culler, const OcclusionTest* occlusion)
 {
-	// Calculate normal matrix once in cpp code, instead of doing it for every vertex for performance reasons
-	glm::mat3 normalMatrix = glm::mat3 (modelMat);
-	normalMatrix = glm::transpose (normalMatrix);
-	normalMatrix = glm::inverse (normalMatrix);
+	if (GPU_CULLING) {
+		renderDepthSceneGpu (shader, staticObjects, culler, COMPLEX_SCENE_GROUPS, occlusion);
+		return;
+	}
+
+	drawList.clear ();
+	for (unsigned int index = 0; index < sceneObjects.size (); index++) {
+		const SceneObject& object = sceneObjects[index];
+		if (!inComplexScene (object) || object.IsStatic () != staticObjects || !object.CastsShadow ())
+			continue;
+
+		if (!culler.IsVisible (object.GetWorldBounds ()))
+			continue;
 
-	shader.setMatrix3 ("u_NormalMat", normalMatrix);
+		drawList.push_back (index);
+	}
+
+	queueObjects (drawList, shader, DRAW_PASS_DEPTH);
+	drawQueue->Execute (DRAW_PASS_DEPTH);
 }
 
-unsigned int floorVAO = 0, floorVBO = 0;
-void renderFloor ()
+void renderDepthSceneSimple (Shader& shader, bool staticObjects, ShadowCasterCuller& culler, const OcclusionTest* occlusion)
 {
-	if (floorVAO == 0)
-	{
-		float vertices[] = {
+	if (GPU_CULLING) {
+		renderDepthSceneGpu (shader, staticObjects, culler, SIMPLE_SCENE_GROUPS, occlusion);
+		return;
+	}
 
-			// positions            // normals         // texcoords
-			-25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,   0.0f,  0.0f,
-			 25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,  25.0f,  0.0f,
-			-25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,   0.0f, 25.0f,
+	drawList.clear ();
+	for (unsigned int index = 0; index < sceneObjects.size (); index++) {
+		const SceneObject& object = sceneObjects[index];
+		if (!inSimpleScene (object) || object.IsStatic () != staticObjects || !object.CastsShadow ())
+			continue;
 
-			-25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,   0.0f, 25.0f,
-			 25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,  25.0f,  0.0f,
-			 25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,  25.0f, 25.0f
+		if (!culler.IsVisible (object.GetWorldBounds ()))
+			continue;
 
-		};
+		drawList.push_back (index);
+	}
 
-		glGenVertexArrays (1, &floorVAO);
-		glBindVertexArray (floorVAO);
+	queueObjects (drawList, shader, DRAW_PASS_DEPTH);
+	drawQueue->Execute (DRAW_PASS_DEPTH);
+}
 
-		glGenBuffers (1, &floorVBO);
-		glBindBuffer (GL_ARRAY_BUFFER, floorVBO);
+void renderDepthSceneGpu (Shader& shader, bool staticObjects, ShadowCasterCuller& culler, unsigned int groupMask, const OcclusionTest* occlusion)
+{
+	// Only the light volume, the visible receivers aren't known on the GPU
+	unsigned int flagsMask = OBJECT_FLAG_CASTS_SHADOW | OBJECT_FLAG_STATIC;
+	unsigned int flagsValue = OBJECT_FLAG_CASTS_SHADOW | (staticObjects ? OBJECT_FLAG_STATIC : 0);
+	GpuCullPass pass = gpuCuller->Cull (culler.GetVolume (), groupMask, flagsMask, flagsValue, occlusion);
+
+	// The culling pass left its compute shader bound, the queue switches back to the depth shader
+	queueGroupsGpu (shader, DRAW_PASS_DEPTH, pass, groupMask);
+	drawQueue->Execute (DRAW_PASS_DEPTH);
+}
 
-		glBufferData (GL_ARRAY_BUFFER, sizeof (vertices), vertices, GL_STATIC_DRAW);
+void queueGroupsGpu (Shader& shader, DrawPass pass, const GpuCullPass& cullPass, unsigned int groupMask)
+{
+	unsigned int material = pass == DRAW_PASS_DEPTH ? DrawQueue::NO_MATERIAL : floorMaterial;
+	unsigned int vao = pass == DRAW_PASS_DEPTH ? geometryPool->DepthVAO : geometryPool->VAO;
+	// Only the opaque items are sorted by depth
+	bool opaque = pass == DRAW_PASS_OPAQUE;
+	if (groupMask & (1 << OBJECT_FLOOR))
+		drawQueue->Submit (pass, DrawItem (&shader, material, vao, opaque ? nearestGroupDistance (OBJECT_FLOOR) : 0.f,
+			*gpuCuller, cullPass, OBJECT_FLOOR, 0, 1));
+	if (groupMask & (1 << OBJECT_CUBE))
+		drawQueue->Submit (pass, DrawItem (&shader, material, vao, opaque ? nearestGroupDistance (OBJECT_CUBE) : 0.f,
+			*gpuCuller, cullPass, OBJECT_CUBE, 0, 1));
+	if (groupMask & (1 << OBJECT_BACKPACK))
+		backpack->Submit (*drawQueue, pass, shader, opaque ? nearestGroupDistance (OBJECT_BACKPACK) : 0.f, *gpuCuller, cullPass, OBJECT_BACKPACK);
+}
 
-		glEnableVertexAttribArray (0);
-		glVertexAttribPointer (0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof (float), (void*)0);
-		glEnableVertexAttribArray (1);
-		glVertexAttribPointer (1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof (float), (void*)(3 * sizeof (float)));
-		glEnableVertexAttribArray (2);
-		glVertexAttribPointer (2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof (float), (void*)(6 * sizeof (float)));
+void queueSceneDepth (Shader& shader, const std::vector<unsigned int>& visibleObjects)
+{
+	// Has to match the queue calls of the shading pass
+	if (GPU_CULLING) {
+		queueGroupsGpu (shader, DRAW_PASS_DEPTH, cameraPass, SIMPLE_SCENE_GROUPS);
+		return;
+	}
 
-		glBindBuffer (GL_ARRAY_BUFFER, 0);
-		glBindVertexArray (0);
+	drawList.clear ();
+	for (unsigned int index : visibleObjects) {
+		if (inSimpleScene (sceneObjects[index]))
+			drawList.push_back (index);
 	}
 
-	glBindVertexArray (floorVAO);
-	glDrawArrays (GL_TRIANGLES, 0, 6);
-	glBindVertexArray (0);
+	queueObjects (drawList, shader, DRAW_PASS_DEPTH);
 }
 
-unsigned int cubeVAO = 0, cubeVBO = 0;
-void renderCube ()
+void queueFloorShadow (Shader& shader, const std::vector<unsigned int>& visibleObjects)
 {
-	// initialize (if necessary)
-	if (cubeVAO == 0)
-	{
-		float vertices[] = {
-			// back face
-			-1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-			 1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-			 1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 0.0f, // bottom-right         
-			 1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-			-1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-			-1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, // top-left
-			// front face
-			-1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-			 1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 0.0f, // bottom-right
-			 1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-			 1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-			-1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, // top-left
-			-1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-			// left face
-			-1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-			-1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-left
-			-1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-			-1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-			-1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-			-1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-			// right face
-			 1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-			 1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-			 1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-right         
-			 1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-			 1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-			 1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-left     
-			 // bottom face
-			 -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-			  1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 1.0f, // top-left
-			  1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-			  1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-			 -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-			 -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-			 // top face
-			 -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-			  1.0f,  1.0f , 1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-			  1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 1.0f, // top-right     
-			  1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-			 -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-			 -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left        
-		};
+	if (GPU_CULLING) {
+		queueGroupsGpu (shader, DRAW_PASS_OPAQUE, cameraPass, 1 << OBJECT_FLOOR);
+		return;
+	}
+
+	drawList.clear ();
+	for (unsigned int index : visibleObjects) {
+		if (sceneObjects[index].Type == OBJECT_FLOOR)
+			drawList.push_back (index);
+	}
 
-		glGenVertexArrays (1, &cubeVAO);
-		glGenBuffers (1, &cubeVBO);
+	queueObjects (drawList, shader, DRAW_PASS_OPAQUE);
+}
 
-		// fill buffer
-		glBindBuffer (GL_ARRAY_BUFFER, cubeVBO);
-		glBufferData (GL_ARRAY_BUFFER, sizeof (vertices), vertices, GL_STATIC_DRAW);
+void queueBackpackShadow (Shader& shader, const std::vector<unsigned int>& visibleObjects)
+{
+	if (GPU_CULLING) {
+		queueGroupsGpu (shader, DRAW_PASS_OPAQUE, cameraPass, 1 << OBJECT_BACKPACK);
+		return;
+	}
 
-		// link vertex attributes
-		glBindVertexArray (cubeVAO);
-		glEnableVertexAttribArray (0);
-		glVertexAttribPointer (0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof (float), (void*)0);
-		glEnableVertexAttribArray (1);
-		glVertexAttribPointer (1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof (float), (void*)(3 * sizeof (float)));
-		glEnableVertexAttribArray (2);
-		glVertexAttribPointer (2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof (float), (void*)(6 * sizeof (float)));
+	drawList.clear ();
+	for (unsigned int index : visibleObjects) {
+		if (sceneObjects[index].Type == OBJECT_BACKPACK)
+			drawList.push_back (index);
+	}
 
-		glBindBuffer (GL_ARRAY_BUFFER, 0);
-		glBindVertexArray (0);
+	queueObjects (drawList, shader, DRAW_PASS_OPAQUE);
+}
+
+void queueCubesShadow (Shader& shader, const std::vector<unsigned int>& visibleObjects)
+{
+	if (GPU_CULLING) {
+		queueGroupsGpu (shader, DRAW_PASS_OPAQUE, cameraPass, 1 << OBJECT_CUBE);
+		return;
+	}
+
+	drawList.clear ();
+	for (unsigned int index : visibleObjects) {
+		if (sceneObjects[index].Type == OBJECT_CUBE)
+			drawList.push_back (index);
+	}
+
+	queueObjects (drawList, shader, DRAW_PASS_OPAQUE);
+}
+
+void queueObjects (const std::vector<unsigned int>& indices, Shader& shader, DrawPass pass)
+{
+	floorInstances.clear ();
+	cubeInstances.clear ();
+	backpackInstances.clear ();
+
+	for (unsigned int index : indices) {
+		switch (sceneObjects[index].Type) {
+		case OBJECT_FLOOR:
+			floorInstances.push_back (index);
+			break;
+		case OBJECT_CUBE:
+			cubeInstances.push_back (index);
+			break;
+		case OBJECT_BACKPACK:
+			backpackInstances.push_back (index);
+			break;
+		}
+	}
+
+	// Depth passes are sorted by state only, the distances would be wasted
+	bool opaque = pass == DRAW_PASS_OPAQUE;
+	unsigned int material = opaque ? floorMaterial : DrawQueue::NO_MATERIAL;
+	unsigned int vao = opaque ? geometryPool->VAO : geometryPool->DepthVAO;
+
+	// Drawn with the count the instance stream actually holds, it can take less than asked for
+	if (!floorInstances.empty ()) {
+		InstanceRange instances = objectBuffer->AddInstances (floorInstances);
+		drawQueue->Submit (pass, DrawItem (&shader, material, vao, opaque ? nearestDistance (floorInstances) : 0.f,
+			floorGeometry, instances.BaseInstance, instances.Count));
 	}
+	if (!cubeInstances.empty ()) {
+		InstanceRange instances = objectBuffer->AddInstances (cubeInstances);
+		drawQueue->Submit (pass, DrawItem (&shader, material, vao, opaque ? nearestDistance (cubeInstances) : 0.f,
+			cubeGeometry, instances.BaseInstance, instances.Count));
+	}
+
+	if (!backpackInstances.empty ()) {
+		InstanceRange instances = objectBuffer->AddInstances (backpackInstances);
+		backpack->Submit (*drawQueue, pass, shader, opaque ? nearestDistance (backpackInstances) : 0.f,
+			instances.BaseInstance, instances.Count);
+	}
+}
+
+float nearestDistance (const std::vector<unsigned int>& indices)
+{
+	float nearest = std::numeric_limits<float>::max ();
+	for (unsigned int index : indices)
+		nearest = std::min (nearest, cameraDistance (sceneObjects[index].GetWorldBounds ()));
+
+	return nearest;
+}
+
+float nearestGroupDistance (SceneObjectType type)
+{
+	float nearest = std::numeric_limits<float>::max ();
+	for (const SceneObject& object : sceneObjects) {
+		if (object.Type == type)
+			nearest = std::min (nearest, cameraDistance (object.GetWorldBounds ()));
+	}
+
+	return nearest;
+}
+
+float cameraDistance (const AABB& bounds)
+{
+	// Distance to the closest point of the bounds, zero when the camera is inside
+	glm::vec3 outside = glm::max (glm::max (bounds.Min - camera.Position, camera.Position - bounds.Max), glm::vec3 (0.f));
+	return glm::length (outside);
+}
+
+GeometryRange createFloor ()
+{
+	float vertices[] = {
+
+		// positions            // normals         // texcoords
+		-25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,   0.0f,  0.0f,
+		 25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,  25.0f,  0.0f,
+		-25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,   0.0f, 25.0f,
+
+		-25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,   0.0f, 25.0f,
+		 25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,  25.0f,  0.0f,
+		 25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,  25.0f, 25.0f
+
+	};
+
+	return addGeometry (vertices, sizeof (vertices) / (8 * sizeof (float)), FLOOR_BOUNDS);
+}
+
+GeometryRange createCube ()
+{
+	float vertices[] = {
+		// back face
+		-1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
+		 1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
+		 1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 0.0f, // bottom-right         
+		 1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
+		-1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
+		-1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, // top-left
+		// front face
+		-1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
+		 1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 0.0f, // bottom-right
+		 1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
+		 1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
+		-1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, // top-left
+		-1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
+		// left face
+		-1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
+		-1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-left
+		-1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
+		-1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
+		-1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-right
+		-1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
+		// right face
+		 1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
+		 1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
+		 1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-right         
+		 1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
+		 1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
+		 1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-left     
+		 // bottom face
+		 -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
+		  1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 1.0f, // top-left
+		  1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
+		  1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
+		 -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 0.0f, // bottom-right
+		 -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
+		 // top face
+		 -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
+		  1.0f,  1.0f , 1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
+		  1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 1.0f, // top-right     
+		  1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
+		 -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
+		 -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left        
+	};
+
+	return addGeometry (vertices, sizeof (vertices) / (8 * sizeof (float)), CUBE_BOUNDS);
+}
+
+GeometryRange addGeometry (const float* vertices, unsigned int vertexCount, const AABB& bounds)
+{
+	// interleaved position, normal and texcoords, every vertex is used once
+	std::vector<Vertex> poolVertices (vertexCount);
+	std::vector<unsigned int> indices (vertexCount);
+	for (unsigned int i = 0; i < vertexCount; i++) {
+		const float* vertex = vertices + i * 8;
+		poolVertices[i].Position = glm::vec3 (vertex[0], vertex[1], vertex[2]);
+		poolVertices[i].Normal = glm::vec3 (vertex[3], vertex[4], vertex[5]);
+		poolVertices[i].TexCoords = glm::vec2 (vertex[6], vertex[7]);
+		indices[i] = i;
+	}
+
+	// The faces of the cube only share positions, welded the depth passes transform 8 instead of 36 vertices
+	std::vector<unsigned int> positionIndices;
+	if (geometryPool->PositionStream)
+		WeldPositions (poolVertices.data (), vertexCount, indices.data (), vertexCount, positionIndices);
 
-	// render Cube
-	glBindVertexArray (cubeVAO);
-	glDrawArrays (GL_TRIANGLES, 0, 36);
-	glBindVertexArray (0);
+	return geometryPool->Add (poolVertices, indices, bounds, positionIndices.empty () ? nullptr : positionIndices.data ());
 }
 
 unsigned int quadVAO = 0, quadVBO = 0;
@@ -493,7 +1149,7 @@ void renderQuad ()
 			 1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
 		};
 		glGenVertexArrays (1, &quadVAO);
-		glBindVertexArray (quadVAO);
+		RenderState::BindVertexArray (quadVAO);
 
 		glGenBuffers (1, &quadVBO);
 		glBindBuffer (GL_ARRAY_BUFFER, quadVBO);
@@ -505,12 +1161,11 @@ void renderQuad ()
 		glVertexAttribPointer (1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof (float), (void*)(3 * sizeof (float)));
 
 		glBindBuffer (GL_ARRAY_BUFFER, 0);
-		glBindVertexArray (0);
+		RenderState::BindVertexArray (0);
 	}
 
-	glBindVertexArray (quadVAO);
+	RenderState::BindVertexArray (quadVAO);
 	glDrawArrays (GL_TRIANGLE_STRIP, 0, 4);
-	glBindVertexArray (0);
 }
 
 
@@ -581,7 +1236,7 @@ unsigned int loadTexture (char const* path)
 		else if (nrComponents == 4)
 			format = GL_RGBA;
 
-		glBindTexture (GL_TEXTURE_2D, textureID);
+		RenderState::BindTexture (0, GL_TEXTURE_2D, textureID);
 		glTexImage2D (GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 		glGenerateMipmap (GL_TEXTURE_2D);
 
@@ -0,0 +1,63 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool( unsigned int threadCount )
+	: runningJobs( 0 ), stopping( false )
+{
+	for ( unsigned int i = 0; i < threadCount; i++ )
+		workers.push_back( std::thread( &ThreadPool::work, this ) );
+}
+
+ThreadPool::~ThreadPool()
+{
+	Wait();
+
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		stopping = true;
+	}
+	jobAvailable.notify_all();
+
+	for ( unsigned int i = 0; i < workers.size(); i++ )
+		workers[ i ].join();
+}
+
+void ThreadPool::Submit( std::function<void()> job )
+{
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		jobs.push_back( job );
+	}
+	jobAvailable.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock( mutex );
+	idle.wait( lock, [ this ] { return jobs.empty() && runningJobs == 0; } );
+}
+
+void ThreadPool::work()
+{
+	while ( true ) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock( mutex );
+			jobAvailable.wait( lock, [ this ] { return stopping || !jobs.empty(); } );
+			if ( jobs.empty() )
+				return;
+
+			job = jobs.front();
+			jobs.pop_front();
+			runningJobs++;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			runningJobs--;
+			if ( jobs.empty() && runningJobs == 0 )
+				idle.notify_all();
+		}
+	}
+}
\ No newline at end of file
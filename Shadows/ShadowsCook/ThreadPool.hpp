@@ -0,0 +1,33 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed number of worker threads taking jobs from one queue in submission order
+class ThreadPool
+{
+public:
+	explicit ThreadPool( unsigned int threadCount );
+	// waits for all jobs
+	~ThreadPool();
+
+	// can be called from inside a job
+	void Submit( std::function<void()> job );
+	// returns once the queue is empty and no job runs anymore, including the jobs submitted by jobs
+	void Wait();
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable idle;
+	unsigned int runningJobs;
+	bool stopping;
+
+	void work();
+};
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include "ThreadPool.hpp"
+
+#include "Utils/ModelImporter.hpp"
+#include "Utils/CookedModel.hpp"
+#include "Utils/CookedImage.hpp"
+#include "Utils/MappedFile.hpp"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// Offline cooker: shadows-cook <directory> [-j <threads>] [-f]
+// Cooks every OBJ/FBX/glTF below the directory into path + ".cooked" and the images they reference into image + ".cooked",
+// the same files the engine would write or read on startup. Outputs whose source hash still matches are skipped, -f cooks them anyway
+
+bool isModel (const std::filesystem::path& path);
+void cookModel (const std::string& path);
+void queueImage (const std::string& path);
+void cookImage (const std::string& path);
+void printLine (const std::string& line);
+
+ThreadPool* pool = nullptr;
+bool force = false;
+
+// every image is cooked once, even if several models use it
+std::mutex imagesMutex;
+std::set<std::string> queuedImages;
+std::mutex outputMutex;
+
+std::atomic<unsigned int> cookedModels (0);
+std::atomic<unsigned int> cookedImages (0);
+std::atomic<unsigned int> upToDate (0);
+std::atomic<unsigned int> failed (0);
+
+int main (int argc, char** argv)
+{
+	std::string directory;
+	unsigned int threadCount = std::max (std::thread::hardware_concurrency (), 1u);
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp (argv[i], "-j") == 0 && i + 1 < argc)
+			threadCount = std::max (std::atoi (argv[++i]), 1);
+		else if (std::strcmp (argv[i], "-f") == 0)
+			force = true;
+		else
+			directory = argv[i];
+	}
+
+	if (directory.empty ()) {
+		std::cout << "usage: shadows-cook <directory> [-j <threads>] [-f]" << std::endl;
+		return 1;
+	}
+
+	std::error_code error;
+	if (!std::filesystem::is_directory (directory, error)) {
+		std::cout << "ERROR::COOK::NOT_A_DIRECTORY: " << directory << std::endl;
+		return 1;
+	}
+
+	// the engine loads images flipped, the cooked ones have to match
+	stbi_set_flip_vertically_on_load (true);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+
+	{
+		ThreadPool threads (threadCount);
+		pool = &threads;
+
+		for (std::filesystem::recursive_directory_iterator it (directory, error), end; !error && it != end; it.increment (error)) {
+			if (!it->is_regular_file () || !isModel (it->path ()))
+				continue;
+
+			// forward slashes like the paths the engine passes to Model
+			std::string path = it->path ().generic_string ();
+			threads.Submit ([path] { cookModel (path); });
+		}
+
+		threads.Wait ();
+		pool = nullptr;
+	}
+
+	float seconds = std::chrono::duration<float> (std::chrono::steady_clock::now () - start).count ();
+	std::cout << "cooked " << cookedModels << " models and " << cookedImages << " images, " << upToDate << " up to date, "
+		<< failed << " failed in " << seconds << "s" << std::endl;
+
+	return failed == 0 ? 0 : 1;
+}
+
+bool isModel (const std::filesystem::path& path)
+{
+	std::string extension = path.extension ().string ();
+	std::transform (extension.begin (), extension.end (), extension.begin (), [] (unsigned char c) { return (char)std::tolower (c); });
+
+	return extension == ".obj" || extension == ".fbx" || extension == ".gltf" || extension == ".glb";
+}
+
+void cookModel (const std::string& path)
+{
+	std::string cookedPath = path + ".cooked";
+	std::vector<std::string> images;
+
+	// checked against every file Assimp read for the model, like the engine checks it
+	CookedModel cooked;
+	if (!force && cooked.Open (cookedPath.c_str ())) {
+		for (unsigned int i = 0; i < cooked.Header->TextureCount; i++)
+			images.push_back (cooked.GetTexturePath (cooked.Textures[i]));
+		upToDate++;
+	}
+	else {
+		ModelImporter importer;
+		if (!importer.Import (path) || !CookedModel::Write (cookedPath.c_str (), importer.SourceHash, importer.SourceFiles, importer.Meshes)) {
+			printLine ("ERROR::COOK::MODEL_NOT_COOKED: " + path);
+			failed++;
+			return;
+		}
+
+		for (unsigned int i = 0; i < importer.Meshes.size (); i++)
+			images.insert (images.end (), importer.Meshes[i].TexturePaths.begin (), importer.Meshes[i].TexturePaths.end ());
+		std::string report = importer.GetOptimizationReport ();
+		printLine ("cooked " + path + (report.empty () ? "" : "\n" + report));
+		cookedModels++;
+	}
+
+	// relative to the model, like TextureFromFile() resolves them
+	std::string directory = path.substr (0, path.find_last_of ('/'));
+	for (unsigned int i = 0; i < images.size (); i++) {
+		// embedded textures (glb, FBX) are named "*<index>" and live in the model file, there is no image to cook
+		if (images[i].empty () || images[i][0] == '*')
+			continue;
+
+		queueImage (directory + '/' + images[i]);
+	}
+}
+
+void queueImage (const std::string& path)
+{
+	{
+		std::lock_guard<std::mutex> lock (imagesMutex);
+		if (!queuedImages.insert (path).second)
+			return;
+	}
+
+	pool->Submit ([path] { cookImage (path); });
+}
+
+void cookImage (const std::string& path)
+{
+	uint64_t sourceHash;
+	if (!HashFile (path.c_str (), sourceHash)) {
+		printLine ("ERROR::COOK::SOURCE_NOT_READ: " + path);
+		failed++;
+		return;
+	}
+
+	std::string cookedPath = path + ".cooked";
+
+	CookedImage cooked;
+	if (!force && cooked.Open (cookedPath.c_str (), sourceHash)) {
+		upToDate++;
+		return;
+	}
+
+	if (!CookedImage::Cook (path.c_str (), cookedPath.c_str (), sourceHash)) {
+		printLine ("ERROR::COOK::IMAGE_NOT_COOKED: " + path);
+		failed++;
+		return;
+	}
+
+	printLine ("cooked " + path);
+	cookedImages++;
+}
+
+void printLine (const std::string& line)
+{
+	std::lock_guard<std::mutex> lock (outputMutex);
+	std::cout << line << std::endl;
+}
\ No newline at end of file